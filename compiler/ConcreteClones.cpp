@@ -0,0 +1,423 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "ConcreteClones.h"
+
+#include <cstdlib>
+#include <memory>
+#include <optional>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/MapVector.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+#if LLVM_VERSION_MAJOR < 17
+#include <llvm/ADT/Triple.h>
+#else
+#include <llvm/TargetParser/Triple.h>
+#endif
+
+using namespace llvm;
+
+namespace {
+
+/// Set this variable to 1 to disable the clones.
+constexpr char kDisableVariable[] = "SYMCC_NO_CONCRETE_CLONES";
+
+/// The attribute that marks clones, so that we don't instrument them.
+constexpr char kCloneAttribute[] = "symcc-concrete-clone";
+
+constexpr char kCloneSuffix[] = ".concrete";
+
+/// The most bytes that the entry check covers per pointer parameter.
+constexpr int64_t kMaxAccessSize = 4096;
+
+/// The bytes accessed through each pointer parameter, by argument number.
+using Ranges = SmallDenseMap<unsigned, std::pair<int64_t, int64_t>, 2>;
+
+/// A call that passes a pointer parameter of the caller on to the callee.
+struct ForwardedPointer {
+  const Function *callee;
+  unsigned calleeArgNo;
+  unsigned callerArgNo;
+  int64_t offset;
+};
+
+/// What a function that may have a clone does with its pointer parameters.
+struct Candidate {
+  Ranges ranges;
+  SmallPtrSet<const Function *, 4> callees;
+  SmallVector<ForwardedPointer, 2> forwardedPointers;
+};
+
+bool extend(Ranges &ranges, unsigned argNo, int64_t begin, int64_t end) {
+  auto [it, inserted] = ranges.try_emplace(argNo, begin, end);
+  if (inserted)
+    return true;
+
+  auto &range = it->second;
+  if (begin >= range.first && end <= range.second)
+    return false;
+  range.first = std::min(range.first, begin);
+  range.second = std::max(range.second, end);
+  return true;
+}
+
+bool isWithinLimit(const Ranges &ranges) {
+  for (auto &[argNo, range] : ranges) {
+    if (range.second - range.first > kMaxAccessSize)
+      return false;
+  }
+  return true;
+}
+
+/// Find the functions that can have clones, and the memory that they access
+/// through their pointer parameters.
+class CloneAnalysis {
+public:
+  explicit CloneAnalysis(Module &M)
+      : M(M), DL(M.getDataLayout()), TLII(Triple(M.getTargetTriple())),
+        TLI(TLII) {}
+
+  MapVector<const Function *, Candidate> run() {
+    MapVector<const Function *, Candidate> candidates;
+    for (auto &F : M) {
+      if (auto candidate = scan(F))
+        candidates.insert({&F, std::move(*candidate)});
+    }
+
+    // Drop the functions that call functions without clones, and add the
+    // accesses of the callees to the forwarded pointers, until nothing
+    // changes.
+    bool changed;
+    do {
+      changed = false;
+      SmallVector<const Function *, 8> dropped;
+      for (auto &[F, candidate] : candidates) {
+        bool keep = llvm::all_of(candidate.callees, [&](auto *callee) {
+          return candidates.count(callee) != 0;
+        });
+
+        for (auto &forwarded : candidate.forwardedPointers) {
+          if (!keep)
+            break;
+          auto &calleeRanges = candidates[forwarded.callee].ranges;
+          auto it = calleeRanges.find(forwarded.calleeArgNo);
+          if (it == calleeRanges.end())
+            continue;
+          changed |= extend(candidate.ranges, forwarded.callerArgNo,
+                            it->second.first + forwarded.offset,
+                            it->second.second + forwarded.offset);
+        }
+
+        if (!keep || !isWithinLimit(candidate.ranges))
+          dropped.push_back(F);
+      }
+
+      for (auto *F : dropped)
+        candidates.erase(F);
+      changed |= !dropped.empty();
+    } while (changed);
+
+    return candidates;
+  }
+
+private:
+  std::optional<Candidate> scan(const Function &F) const {
+    if (F.isDeclaration() || F.isVarArg() || F.getName() == "main" ||
+        F.getName().startswith("__sym_") || ConcreteClones::isClone(F) ||
+        F.hasFnAttribute(Attribute::Naked))
+      return std::nullopt;
+
+    Candidate candidate;
+    for (auto &I : instructions(F)) {
+      bool supported;
+      if (auto *load = dyn_cast<LoadInst>(&I)) {
+        supported = !load->isAtomic() &&
+                    addAccess(candidate, load->getPointerOperand(),
+                              load->getType(), false);
+      } else if (auto *store = dyn_cast<StoreInst>(&I)) {
+        supported = !store->isAtomic() &&
+                    addAccess(candidate, store->getPointerOperand(),
+                              store->getValueOperand()->getType(), true);
+      } else if (auto *call = dyn_cast<CallInst>(&I)) {
+        supported = scanCall(candidate, *call);
+      } else {
+        supported =
+            isa<BinaryOperator>(I) || isa<UnaryOperator>(I) ||
+            isa<CmpInst>(I) || isa<CastInst>(I) || isa<GetElementPtrInst>(I) ||
+            isa<SelectInst>(I) || isa<PHINode>(I) ||
+            isa<ExtractValueInst>(I) || isa<InsertValueInst>(I) ||
+            isa<ExtractElementInst>(I) || isa<InsertElementInst>(I) ||
+            isa<ShuffleVectorInst>(I) || isa<FreezeInst>(I) ||
+            isa<AllocaInst>(I) || isa<BranchInst>(I) || isa<SwitchInst>(I) ||
+            isa<ReturnInst>(I) || isa<UnreachableInst>(I);
+      }
+
+      if (!supported)
+        return std::nullopt;
+    }
+
+    return candidate;
+  }
+
+  bool scanCall(Candidate &candidate, const CallInst &call) const {
+    if (call.isInlineAsm())
+      return false;
+
+    if (auto *memIntrinsic = dyn_cast<MemIntrinsic>(&call)) {
+      auto *length = dyn_cast<ConstantInt>(memIntrinsic->getLength());
+      if (length == nullptr || length->getValue().ugt(kMaxAccessSize))
+        return false;
+      auto size = length->getZExtValue();
+      if (auto *memTransfer = dyn_cast<MemTransferInst>(memIntrinsic)) {
+        if (!addAccess(candidate, memTransfer->getRawSource(), size, false))
+          return false;
+      }
+      return addAccess(candidate, memIntrinsic->getRawDest(), size, true);
+    }
+
+    if (auto *intrinsic = dyn_cast<IntrinsicInst>(&call))
+      return intrinsic->doesNotAccessMemory() ||
+             intrinsic->onlyAccessesInaccessibleMemory() ||
+             intrinsic->isLifetimeStartOrEnd() ||
+             isa<DbgInfoIntrinsic>(intrinsic);
+
+    auto *callee = call.getCalledFunction();
+    if (callee == nullptr)
+      return false;
+
+    // The C library isn't instrumented, so it doesn't matter whether the
+    // memory that we pass to it is concrete. Callbacks, however, would run
+    // instrumented code.
+    if (callee->isDeclaration()) {
+      LibFunc libFunc;
+      if (isRuntimeWrapper(*callee) || !TLI.getLibFunc(*callee, libFunc))
+        return false;
+      return llvm::none_of(call.args(), [](const Use &arg) {
+        return isa<Function>(arg->stripPointerCasts());
+      });
+    }
+
+    if (callee->isInterposable())
+      return false;
+
+    candidate.callees.insert(callee);
+    for (auto &arg : call.args()) {
+      if (!arg->getType()->isPointerTy())
+        continue;
+
+      auto [base, offset] = getBase(arg);
+      if (isa<ConstantPointerNull>(base) || isa<UndefValue>(base) ||
+          isa<AllocaInst>(base) || isConstantGlobal(base))
+        continue;
+      auto *param = dyn_cast<Argument>(base);
+      if (param == nullptr || !offset)
+        return false;
+      candidate.forwardedPointers.push_back({callee, call.getArgOperandNo(&arg),
+                                             param->getArgNo(), *offset});
+    }
+    return true;
+  }
+
+  bool addAccess(Candidate &candidate, const Value *pointer, Type *type,
+                 bool write) const {
+    auto size = DL.getTypeStoreSize(type);
+    if (size.isScalable())
+      return false;
+    return addAccess(candidate, pointer, uint64_t(size), write);
+  }
+
+  bool addAccess(Candidate &candidate, const Value *pointer, uint64_t size,
+                 bool write) const {
+    auto [base, offset] = getBase(pointer);
+    if (isa<AllocaInst>(base))
+      return true;
+    if (isConstantGlobal(base))
+      return !write;
+
+    auto *param = dyn_cast<Argument>(base);
+    if (param == nullptr || !offset || size > uint64_t(kMaxAccessSize))
+      return false;
+    extend(candidate.ranges, param->getArgNo(), *offset, *offset + size);
+    return true;
+  }
+
+  /// Find the object that a pointer points into, and the offset into it if
+  /// it's constant and reasonably small.
+  std::pair<const Value *, std::optional<int64_t>>
+  getBase(const Value *pointer) const {
+    APInt offset(DL.getIndexTypeSizeInBits(pointer->getType()), 0);
+    auto *base = pointer->stripAndAccumulateConstantOffsets(
+        DL, offset, /* AllowNonInbounds */ true);
+    if (offset.getMinSignedBits() > 32)
+      return {base, std::nullopt};
+    return {base, offset.getSExtValue()};
+  }
+
+  static bool isConstantGlobal(const Value *V) {
+    auto *global = dyn_cast<GlobalVariable>(V);
+    return global != nullptr && global->isConstant();
+  }
+
+  Module &M;
+  const DataLayout &DL;
+  TargetLibraryInfoImpl TLII;
+  TargetLibraryInfo TLI;
+};
+
+/// The clones of the module that is currently being instrumented.
+struct CachedConcreteClones {
+  const Module *module = nullptr;
+  std::unique_ptr<ConcreteClones> clones;
+};
+
+thread_local CachedConcreteClones cachedConcreteClones;
+
+} // namespace
+
+ConcreteClones::ConcreteClones(Module &M)
+    : runtime(M), intPtrType(M.getDataLayout().getIntPtrType(M.getContext())) {
+  for (auto &[F, candidate] : CloneAnalysis(M).run()) {
+    auto &functionAccesses = accesses[F];
+    for (auto &[argNo, range] : candidate.ranges)
+      functionAccesses.push_back({argNo, range.first, range.second});
+    llvm::sort(functionAccesses, [](const Access &a, const Access &b) {
+      return a.argNo < b.argNo;
+    });
+  }
+}
+
+bool ConcreteClones::isClone(const Function &F) {
+  return F.hasFnAttribute(kCloneAttribute);
+}
+
+Function *ConcreteClones::getClone(Function &F) {
+  if (auto *clone = clones.lookup(&F))
+    return clone;
+
+  assert(hasClone(F) && "The function can't have a concrete clone");
+  ValueToValueMapTy VMap;
+  auto *clone = CloneFunction(&F, VMap);
+  clone->setName(F.getName() + kCloneSuffix);
+  clone->setLinkage(GlobalValue::InternalLinkage);
+  clone->setVisibility(GlobalValue::DefaultVisibility);
+  clone->setComdat(nullptr);
+  clone->setDSOLocal(true);
+  clone->addFnAttr(kCloneAttribute);
+  clones[&F] = clone;
+
+  // Concrete code calls concrete code.
+  for (auto &I : instructions(*clone)) {
+    if (auto *call = dyn_cast<CallBase>(&I)) {
+      auto *callee = call->getCalledFunction();
+      if (callee != nullptr && hasClone(*callee))
+        call->setCalledFunction(getClone(*callee));
+    }
+  }
+
+  return clone;
+}
+
+void ConcreteClones::insertDispatch(Function &F, const InputTaint *taint) {
+  auto *clone = clones.lookup(&F);
+  assert(clone != nullptr && "The clone must exist before instrumentation");
+
+  auto &Ctx = F.getContext();
+  auto &oldEntry = F.getEntryBlock();
+  auto *dispatchBlock = BasicBlock::Create(Ctx, "", &F, &oldEntry);
+  auto *concreteBlock = BasicBlock::Create(Ctx, "", &F, &oldEntry);
+
+  // Static allocas have to stay in the entry block.
+  for (auto it = oldEntry.begin(); it != oldEntry.end();) {
+    auto *alloca = dyn_cast<AllocaInst>(&*it++);
+    if (alloca != nullptr && isa<ConstantInt>(alloca->getArraySize()))
+      alloca->moveBefore(*dispatchBlock, dispatchBlock->end());
+  }
+
+  // Read the parameter expressions that the instrumented code reads (see
+  // Symbolizer::symbolizeFunctionArguments); the others may be stale.
+  IRBuilder<> IRB(dispatchBlock);
+  auto *ptrT = IRB.getInt8PtrTy();
+  Value *isConcrete = IRB.getTrue();
+  auto addCondition = [&](Value *condition) {
+    isConcrete = isa<Constant>(isConcrete)
+                     ? condition
+                     : IRB.CreateAnd(isConcrete, condition);
+  };
+
+  for (auto &arg : F.args()) {
+    if (arg.user_empty() || (taint && !taint->mayBeSymbolic(&arg)))
+      continue;
+    auto *expr = IRB.CreateCall(runtime.getParameterExpression,
+                                IRB.getInt8(arg.getArgNo()));
+    addCondition(IRB.CreateICmpEQ(expr, ConstantPointerNull::get(ptrT)));
+  }
+
+  for (auto &access : accesses.lookup(&F)) {
+    Value *start = IRB.CreatePointerCast(F.getArg(access.argNo), ptrT);
+    if (access.begin != 0)
+      start = IRB.CreateGEP(IRB.getInt8Ty(), start, IRB.getInt64(access.begin));
+    addCondition(IRB.CreateCall(
+        runtime.isConcreteMemory,
+        {start, ConstantInt::get(intPtrType, access.end - access.begin)}));
+  }
+
+  IRB.CreateCondBr(isConcrete, concreteBlock, &oldEntry);
+
+  // The caller has set the return expression to null, and the clone doesn't
+  // touch it.
+  IRB.SetInsertPoint(concreteBlock);
+  SmallVector<Value *, 8> args;
+  for (auto &arg : F.args())
+    args.push_back(&arg);
+  auto *call = IRB.CreateCall(clone, args);
+  call->setCallingConv(F.getCallingConv());
+  call->setAttributes(F.getAttributes());
+  call->setTailCall(llvm::none_of(F.args(), [](const Argument &arg) {
+    return arg.hasByValAttr() || arg.hasInAllocaAttr();
+  }));
+  if (F.getReturnType()->isVoidTy())
+    IRB.CreateRetVoid();
+  else
+    IRB.CreateRet(call);
+}
+
+ConcreteClones *getConcreteClones(Module &M) {
+  if (auto *disable = std::getenv(kDisableVariable);
+      disable != nullptr && StringRef(disable) == "1")
+    return nullptr;
+
+  if (cachedConcreteClones.module != &M) {
+    cachedConcreteClones.module = &M;
+    cachedConcreteClones.clones = std::make_unique<ConcreteClones>(M);
+  }
+
+  return cachedConcreteClones.clones.get();
+}
+
+void releaseConcreteClones(Module &M) {
+  if (cachedConcreteClones.module != &M)
+    return;
+
+  cachedConcreteClones.module = nullptr;
+  cachedConcreteClones.clones.reset();
+}
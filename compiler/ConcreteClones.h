@@ -0,0 +1,91 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CONCRETECLONES_H
+#define CONCRETECLONES_H
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ValueMap.h>
+
+#include "InputTaint.h"
+#include "Runtime.h"
+
+//
+// Uninstrumented clones of functions, so that calls whose inputs are all
+// concrete run at native speed.
+//
+// An instrumented function with a clone checks at entry whether the
+// expressions of its parameters are null and the memory that it may access
+// through its pointer parameters is concrete; if so, it calls the clone
+// instead of running the instrumented code. This is only correct if the
+// function can't see symbolic data in any other way, so a function has a
+// clone only if
+//
+//  - it accesses memory through its own stack variables, constant globals, and
+//    its pointer parameters at constant offsets (within a page),
+//  - it calls nothing but the C library (without callbacks), intrinsics
+//    without side effects on memory, and other functions with clones, passing
+//    them only pointers that satisfy the same conditions.
+//
+// Clones call the clones of their callees directly.
+//
+
+class ConcreteClones {
+public:
+  explicit ConcreteClones(llvm::Module &M);
+
+  /// Whether the function can have a concrete clone.
+  bool hasClone(const llvm::Function &F) const {
+    return accesses.count(&F) != 0;
+  }
+
+  /// Get the clone of the function, creating it from the function's current
+  /// body if necessary. The pass calls this before instrumenting the function.
+  llvm::Function *getClone(llvm::Function &F);
+
+  /// Make the (instrumented) function call its clone when its inputs are
+  /// concrete. The input-taint analysis, if any, tells us which parameter
+  /// expressions the function reads.
+  void insertDispatch(llvm::Function &F, const InputTaint *taint);
+
+  /// Whether the function is a concrete clone.
+  static bool isClone(const llvm::Function &F);
+
+private:
+  /// A range of bytes that a function may access through a pointer parameter.
+  struct Access {
+    unsigned argNo;
+    int64_t begin, end;
+  };
+
+  const Runtime runtime;
+  llvm::Type *intPtrType;
+
+  /// The functions that can have clones, with the memory that they access
+  /// through their parameters.
+  llvm::ValueMap<const llvm::Function *, llvm::SmallVector<Access, 2>>
+      accesses;
+  llvm::ValueMap<const llvm::Function *, llvm::Function *> clones;
+};
+
+/// The clones of the module, set up on first use; null if the user disabled
+/// them with SYMCC_NO_CONCRETE_CLONES=1.
+ConcreteClones *getConcreteClones(llvm::Module &M);
+
+/// Forget the clones of the module.
+void releaseConcreteClones(llvm::Module &M);
+
+#endif
@@ -24,6 +24,10 @@ void FPOverflowChecker::visitBinaryOperator(BinaryOperator &I) {
   if (I.hasNoNaNs() && I.hasNoInfs())
     return;
 
+  // concrete operands -> nothing to check
+  if (taint && !taint->mayBeSymbolic(&I))
+    return;
+
   // TODO implement!!!
   LLVMContext &Ctx = I.getContext();
   Function *F = I.getFunction();
@@ -9,6 +9,7 @@
 #include <llvm/IR/ValueMap.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include "InputTaint.h"
 #include "Runtime.h"
 
 class FPOverflowChecker : public llvm::InstVisitor<FPOverflowChecker> {
@@ -17,6 +18,7 @@ public:
   void visitBinaryOperator(llvm::BinaryOperator &I);
   void setSementicThreshold(double sementic_threshold);
   void setSementicTolerance(double sementic_tolerance);
+  void setInputTaint(const InputTaint &taintRef) { taint = &taintRef; }
 
   const Runtime runtime;
 
@@ -34,6 +36,7 @@ private:
 
   double sementic_threshold;
   double sementic_tolerance;
+  const InputTaint *taint = nullptr;
 };
 
 #endif
\ No newline at end of file
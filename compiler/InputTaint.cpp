@@ -0,0 +1,662 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "InputTaint.h"
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Operator.h>
+
+#if LLVM_VERSION_MAJOR < 17
+#include <llvm/ADT/Triple.h>
+#else
+#include <llvm/TargetParser/Triple.h>
+#endif
+
+#include "Runtime.h"
+
+using namespace llvm;
+
+namespace {
+
+/// Set this variable to 1 to instrument all code.
+constexpr char kDisableVariable[] = "SYMCC_NO_INPUT_TAINT";
+
+/// The wrappers in the run-time library that neither return symbolic data nor
+/// write it to the memory of their arguments. (The memory that the mmap
+/// family returns may hold symbolic data, but it isn't a stack variable or an
+/// internal global, so we assume that anyway.)
+const StringSet<> kConcreteWrappers = {
+    "malloc", "calloc", "realloc", "free",   "mmap",    "mmap64",
+    "munmap", "mremap", "open",    "fopen", "fopen64",
+};
+
+/// Union-find over memory regions. Region 0 stands for all memory that code
+/// outside the module can reach; it is always the representative of its set.
+/// Region 1 is where null points, i.e., nowhere; it never joins a set.
+class Regions {
+public:
+  static constexpr unsigned kExternal = 0;
+  static constexpr unsigned kNowhere = 1;
+
+  unsigned create() {
+    parents.push_back(parents.size());
+    return parents.size() - 1;
+  }
+
+  unsigned find(unsigned region) {
+    while (parents[region] != region) {
+      parents[region] = parents[parents[region]];
+      region = parents[region];
+    }
+    return region;
+  }
+
+  void unite(unsigned a, unsigned b) {
+    a = find(a);
+    b = find(b);
+    if (a == b || a == kNowhere || b == kNowhere)
+      return;
+    if (b == kExternal)
+      std::swap(a, b);
+    parents[b] = a;
+  }
+
+private:
+  std::vector<unsigned> parents{kExternal, kNowhere};
+};
+
+/// The computation behind InputTaint.
+class TaintSolver {
+public:
+  explicit TaintSolver(Module &M)
+      : M(M), TLII(Triple(M.getTargetTriple())), TLI(TLII) {}
+
+  void solve() {
+    for (auto &F : M) {
+      if (!F.isDeclaration())
+        functions.push_back(&F);
+    }
+
+    for (auto &G : M.globals()) {
+      if (G.hasLocalLinkage() && !hasOnlyInstructionUsers(G))
+        regions.unite(nodeOf(&G), Regions::kExternal);
+    }
+
+    for (auto *F : functions) {
+      if (isExternallyCallable(*F)) {
+        regions.unite(returnNodeOf(*F), Regions::kExternal);
+        for (auto &arg : F->args())
+          regions.unite(nodeOf(&arg), Regions::kExternal);
+      }
+
+      for (auto &I : instructions(*F))
+        unifyPointers(I);
+    }
+
+    for (auto *F : functions) {
+      // The main function doesn't receive symbolic arguments (see
+      // Symbolizer::symbolizeFunctionArguments).
+      if (isExternallyCallable(*F) && F->getName() != "main") {
+        for (auto &arg : F->args())
+          tainted.insert(&arg);
+      }
+    }
+
+    do {
+      changed = false;
+      for (auto *F : functions) {
+        for (auto &I : instructions(*F))
+          propagate(I);
+      }
+    } while (changed);
+  }
+
+  ArrayRef<Function *> definedFunctions() const { return functions; }
+
+  bool isTainted(const Value *V) const { return tainted.count(V) != 0; }
+
+  bool isTaintedRegion(const Value *pointer) {
+    auto region = regions.find(nodeOf(pointer));
+    return region == Regions::kExternal || taintedRegions.count(region) != 0;
+  }
+
+  bool returnsSymbolic(const Function &F) const {
+    return symbolicReturns.count(&F) != 0;
+  }
+
+  bool isExternallyCallable(const Function &F) const {
+    return !F.hasLocalLinkage() || F.hasAddressTaken();
+  }
+
+  /// Whether the call goes to a function that we know not to be instrumented
+  /// (and not to call back into instrumented code).
+  bool callsUninstrumentedCode(const CallBase &call) const {
+    if (call.isInlineAsm() || isa<IntrinsicInst>(call))
+      return true;
+    auto *callee = call.getCalledFunction();
+    if (callee == nullptr || !isLibraryFunction(*callee))
+      return false;
+    for (auto &arg : call.args()) {
+      if (isa<Function>(arg->stripPointerCasts()))
+        return false;
+    }
+    return true;
+  }
+
+private:
+  /// Whether the function is part of the C library, which isn't
+  /// instrumented; the wrappers of the run-time library are not.
+  bool isLibraryFunction(const Function &F) const {
+    LibFunc libFunc;
+    return !isRuntimeWrapper(F) && TLI.getLibFunc(F, libFunc);
+  }
+
+  static bool isConcreteWrapper(const Function &F) {
+    auto name = F.getName();
+    name.consume_back(kWrapperSuffix);
+    return isRuntimeWrapper(F) && kConcreteWrappers.count(name) != 0;
+  }
+
+  /// Whether calls to the function go to the definition in this module.
+  static const Function *getModuleCallee(const CallBase &call) {
+    auto *callee = call.getCalledFunction();
+    if (callee == nullptr || callee->isDeclaration() ||
+        callee->isInterposable())
+      return nullptr;
+    return callee;
+  }
+
+  /// Whether we know all pointers to the global.
+  static bool hasOnlyInstructionUsers(const Value &V) {
+    for (auto *user : V.users()) {
+      if (isa<Instruction>(user))
+        continue;
+      auto *op = dyn_cast<Operator>(user);
+      if (op == nullptr || !isa<Constant>(user) ||
+          !(isa<GEPOperator>(op) || op->getOpcode() == Instruction::BitCast ||
+            op->getOpcode() == Instruction::AddrSpaceCast) ||
+          !hasOnlyInstructionUsers(*user))
+        return false;
+    }
+    return true;
+  }
+
+  /// The region that a pointer refers to.
+  unsigned nodeOf(const Value *pointer) {
+    // Pointer arithmetic doesn't leave the object.
+    while (true) {
+      if (auto *GEP = dyn_cast<GEPOperator>(pointer)) {
+        pointer = GEP->getPointerOperand();
+        continue;
+      }
+      auto *op = dyn_cast<Operator>(pointer);
+      if (op != nullptr && (op->getOpcode() == Instruction::BitCast ||
+                            op->getOpcode() == Instruction::AddrSpaceCast)) {
+        pointer = op->getOperand(0);
+        continue;
+      }
+      break;
+    }
+
+    // Null doesn't point anywhere, so it shouldn't merge regions.
+    if (isa<ConstantPointerNull>(pointer) || isa<UndefValue>(pointer))
+      return Regions::kNowhere;
+
+    auto it = nodes.find(pointer);
+    if (it != nodes.end())
+      return it->second;
+
+    unsigned node;
+    if (isa<Instruction>(pointer) || isa<Argument>(pointer))
+      node = regions.create();
+    else if (auto *G = dyn_cast<GlobalVariable>(pointer);
+             G != nullptr && G->hasLocalLinkage())
+      node = regions.create();
+    else
+      node = Regions::kExternal;
+
+    nodes[pointer] = node;
+    return node;
+  }
+
+  unsigned returnNodeOf(const Function &F) {
+    auto it = returnNodes.find(&F);
+    if (it != returnNodes.end())
+      return it->second;
+    return returnNodes[&F] = regions.create();
+  }
+
+  static bool isPointer(const Value *V) {
+    return V->getType()->isPtrOrPtrVectorTy();
+  }
+
+  void escape(const Value *V) {
+    if (isPointer(V))
+      regions.unite(nodeOf(V), Regions::kExternal);
+  }
+
+  void unite(const Value *a, const Value *b) {
+    if (isPointer(a) && isPointer(b))
+      regions.unite(nodeOf(a), nodeOf(b));
+  }
+
+  /// Merge the regions that a pointer-typed instruction may refer to.
+  void unifyPointers(const Instruction &I) {
+    switch (I.getOpcode()) {
+    case Instruction::GetElementPtr:
+    case Instruction::BitCast:
+    case Instruction::AddrSpaceCast:
+    case Instruction::Alloca:
+    case Instruction::ICmp:
+      // The region doesn't change, or there is no pointer to follow.
+      return;
+    case Instruction::Load:
+      escape(&I);
+      return;
+    case Instruction::Store:
+      escape(cast<StoreInst>(I).getValueOperand());
+      return;
+    case Instruction::AtomicRMW:
+      escape(cast<AtomicRMWInst>(I).getValOperand());
+      escape(&I);
+      return;
+    case Instruction::AtomicCmpXchg:
+      escape(cast<AtomicCmpXchgInst>(I).getCompareOperand());
+      escape(cast<AtomicCmpXchgInst>(I).getNewValOperand());
+      return;
+    case Instruction::PHI:
+    case Instruction::Select:
+    case Instruction::Freeze:
+      for (auto &operand : I.operands())
+        unite(&I, operand);
+      return;
+    case Instruction::Ret:
+      if (auto *value = cast<ReturnInst>(I).getReturnValue();
+          value != nullptr && isPointer(value))
+        regions.unite(returnNodeOf(*I.getFunction()), nodeOf(value));
+      return;
+    case Instruction::Call:
+    case Instruction::Invoke:
+    case Instruction::CallBr:
+      unifyCall(cast<CallBase>(I));
+      return;
+    default:
+      for (auto &operand : I.operands())
+        escape(operand);
+      escape(&I);
+      return;
+    }
+  }
+
+  void unifyCall(const CallBase &call) {
+    if (auto *memTransfer = dyn_cast<MemTransferInst>(&call)) {
+      // The run-time library copies the shadow of the source, so it must be
+      // up to date whenever the destination may hold symbolic data.
+      unite(memTransfer->getRawDest(), memTransfer->getRawSource());
+      return;
+    }
+
+    if (isa<IntrinsicInst>(call)) {
+      for (auto &arg : call.args())
+        unite(&call, arg);
+      return;
+    }
+
+    if (auto *callee = getModuleCallee(call)) {
+      for (auto &arg : call.args()) {
+        auto argNo = call.getArgOperandNo(&arg);
+        if (argNo < callee->arg_size())
+          unite(arg, callee->getArg(argNo));
+        else
+          escape(arg);
+      }
+      if (isPointer(&call))
+        regions.unite(nodeOf(&call), returnNodeOf(*callee));
+      return;
+    }
+
+    // The wrappers in the run-time library read the shadow of the memory that
+    // we pass to them, and other external code may keep the pointers.
+    bool library = call.getCalledFunction() != nullptr &&
+                   isLibraryFunction(*call.getCalledFunction());
+    for (auto &arg : call.args()) {
+      if (!library || !call.doesNotCapture(call.getArgOperandNo(&arg)))
+        escape(arg);
+    }
+    escape(&call);
+  }
+
+  void taint(const Value *V) {
+    if (tainted.insert(V).second)
+      changed = true;
+  }
+
+  void taintRegion(const Value *pointer) {
+    auto region = regions.find(nodeOf(pointer));
+    if (region != Regions::kExternal && region != Regions::kNowhere &&
+        taintedRegions.insert(region).second)
+      changed = true;
+  }
+
+  bool anyOperandTainted(const Instruction &I) const {
+    for (auto &operand : I.operands()) {
+      if (isTainted(operand))
+        return true;
+    }
+    return false;
+  }
+
+  void propagate(const Instruction &I) {
+    switch (I.getOpcode()) {
+    case Instruction::Alloca:
+    case Instruction::Br:
+    case Instruction::Switch:
+    case Instruction::IndirectBr:
+    case Instruction::Unreachable:
+    case Instruction::Fence:
+      return;
+    case Instruction::Load:
+      if (isTaintedRegion(cast<LoadInst>(I).getPointerOperand()))
+        taint(&I);
+      return;
+    case Instruction::Store: {
+      auto &store = cast<StoreInst>(I);
+      if (isTainted(store.getValueOperand()))
+        taintRegion(store.getPointerOperand());
+      return;
+    }
+    case Instruction::AtomicRMW: {
+      auto &rmw = cast<AtomicRMWInst>(I);
+      if (isTainted(rmw.getValOperand()))
+        taintRegion(rmw.getPointerOperand());
+      if (isTaintedRegion(rmw.getPointerOperand()) || anyOperandTainted(I))
+        taint(&I);
+      return;
+    }
+    case Instruction::AtomicCmpXchg: {
+      auto &cmpXchg = cast<AtomicCmpXchgInst>(I);
+      if (isTainted(cmpXchg.getNewValOperand()))
+        taintRegion(cmpXchg.getPointerOperand());
+      if (isTaintedRegion(cmpXchg.getPointerOperand()) || anyOperandTainted(I))
+        taint(&I);
+      return;
+    }
+    case Instruction::Ret:
+      if (auto *value = cast<ReturnInst>(I).getReturnValue();
+          value != nullptr && isTainted(value))
+        symbolicReturns.insert(I.getFunction());
+      return;
+    case Instruction::Call:
+    case Instruction::Invoke:
+    case Instruction::CallBr:
+      propagateCall(cast<CallBase>(I));
+      return;
+    default:
+      break;
+    }
+
+    if (isa<BinaryOperator>(I) || isa<UnaryOperator>(I) || isa<CmpInst>(I) ||
+        isa<CastInst>(I) || isa<GetElementPtrInst>(I) || isa<SelectInst>(I) ||
+        isa<PHINode>(I) || isa<ExtractValueInst>(I) ||
+        isa<InsertValueInst>(I) || isa<ExtractElementInst>(I) ||
+        isa<InsertElementInst>(I) || isa<ShuffleVectorInst>(I) ||
+        isa<FreezeInst>(I)) {
+      if (anyOperandTainted(I))
+        taint(&I);
+      return;
+    }
+
+    // Anything else (e.g., va_arg or a landing pad) may produce symbolic data.
+    if (!I.getType()->isVoidTy())
+      taint(&I);
+  }
+
+  void propagateCall(const CallBase &call) {
+    if (isa<MemTransferInst>(call))
+      return;
+
+    if (auto *memSet = dyn_cast<MemSetInst>(&call)) {
+      if (isTainted(memSet->getValue()))
+        taintRegion(memSet->getRawDest());
+      return;
+    }
+
+    if (isa<IntrinsicInst>(call)) {
+      for (auto &arg : call.args()) {
+        if (isTainted(arg))
+          taint(&call);
+      }
+      return;
+    }
+
+    if (auto *callee = getModuleCallee(call)) {
+      for (auto &arg : call.args()) {
+        auto argNo = call.getArgOperandNo(&arg);
+        if (argNo < callee->arg_size() && isTainted(arg))
+          taint(callee->getArg(argNo));
+      }
+      if (returnsSymbolic(*callee))
+        taint(&call);
+      return;
+    }
+
+    auto *callee = call.getCalledFunction();
+    if (callee != nullptr &&
+        (isConcreteWrapper(*callee) || isLibraryFunction(*callee)))
+      return;
+
+    // Anything else may be instrumented (or be the source of symbolic data),
+    // so it may write symbolic data to the memory we pass and return a
+    // symbolic result.
+    for (auto &arg : call.args()) {
+      if (isPointer(arg))
+        taintRegion(arg);
+    }
+    taint(&call);
+  }
+
+  Module &M;
+  TargetLibraryInfoImpl TLII;
+  TargetLibraryInfo TLI;
+
+  std::vector<Function *> functions;
+  Regions regions;
+  DenseMap<const Value *, unsigned> nodes;
+  DenseMap<const Function *, unsigned> returnNodes;
+
+  DenseSet<const Value *> tainted;
+  DenseSet<unsigned> taintedRegions;
+  DenseSet<const Function *> symbolicReturns;
+  bool changed = false;
+};
+
+/// The analysis of the module that is currently being instrumented.
+struct CachedInputTaint {
+  const Module *module = nullptr;
+  std::unique_ptr<InputTaint> analysis;
+};
+
+thread_local CachedInputTaint cachedInputTaint;
+
+} // namespace
+
+InputTaint::InputTaint(Module &M) : moduleName(M.getModuleIdentifier()) {
+  TaintSolver solver(M);
+  solver.solve();
+
+  for (auto *F : solver.definedFunctions()) {
+    auto &info = functionFacts[F];
+    info.externallyCallable = solver.isExternallyCallable(*F);
+    info.returnsSymbolic = solver.returnsSymbolic(*F);
+    info.callsInstrumentedCode = false;
+
+    for (auto &arg : F->args()) {
+      if (!solver.isTainted(&arg))
+        facts[&arg] = kConcrete;
+    }
+
+    for (auto &I : instructions(*F)) {
+      uint8_t fact = solver.isTainted(&I) ? 0 : kConcrete;
+
+      const Value *target = nullptr;
+      if (auto *store = dyn_cast<StoreInst>(&I))
+        target = store->getPointerOperand();
+      else if (auto *memIntrinsic = dyn_cast<MemIntrinsic>(&I))
+        target = memIntrinsic->getRawDest();
+      if (target != nullptr && !solver.isTaintedRegion(target))
+        fact |= kConcreteTarget;
+
+      if (auto *call = dyn_cast<CallBase>(&I)) {
+        if (solver.callsUninstrumentedCode(*call))
+          fact |= kUninstrumentedCallee;
+        else
+          info.callsInstrumentedCode = true;
+      }
+
+      if (fact != 0)
+        facts[&I] = fact;
+    }
+  }
+}
+
+uint8_t InputTaint::factsOf(const Value *V) const {
+  auto it = facts.find(V);
+  return (it != facts.end()) ? it->second : 0;
+}
+
+bool InputTaint::mayBeSymbolic(const Value *V) const {
+  if (isa<Constant>(V))
+    return false;
+  return (factsOf(V) & kConcrete) == 0;
+}
+
+bool InputTaint::needsInstrumentation(const Instruction &I) const {
+  if (auto *branch = dyn_cast<BranchInst>(&I))
+    return branch->isConditional() && mayBeSymbolic(branch->getCondition());
+
+  if (auto *switchInst = dyn_cast<SwitchInst>(&I))
+    return mayBeSymbolic(switchInst->getCondition());
+
+  if (auto *ret = dyn_cast<ReturnInst>(&I)) {
+    if (ret->getReturnValue() == nullptr)
+      return false;
+    // The caller sets the return expression to null before the call, so we
+    // only need to set it if something in between may have changed it.
+    auto it = functionFacts.find(I.getFunction());
+    if (it == functionFacts.end())
+      return true;
+    return it->second.returnsSymbolic ||
+           (it->second.externallyCallable && it->second.callsInstrumentedCode);
+  }
+
+  if (isa<StoreInst>(I) || isa<MemIntrinsic>(I))
+    return (factsOf(&I) & kConcreteTarget) == 0;
+
+  if (auto *call = dyn_cast<CallBase>(&I)) {
+    if (call->isInlineAsm())
+      return true;
+    if (isa<IntrinsicInst>(call))
+      return mayBeSymbolic(call);
+    if (!call->user_empty() && mayBeSymbolic(call))
+      return true;
+    for (unsigned argNo = 0; argNo < call->arg_size(); argNo++) {
+      if (needsParameterExpression(*call, argNo))
+        return true;
+    }
+    return false;
+  }
+
+  if (isa<AllocaInst>(I) || isa<UnreachableInst>(I))
+    return false;
+
+  return mayBeSymbolic(&I);
+}
+
+bool InputTaint::needsInstrumentation(const Function &F) const {
+  for (auto &arg : F.args()) {
+    if (!arg.user_empty() && mayBeSymbolic(&arg))
+      return true;
+  }
+
+  for (auto &I : instructions(F)) {
+    if (needsInstrumentation(I))
+      return true;
+  }
+
+  return false;
+}
+
+bool InputTaint::needsParameterExpression(const CallBase &call,
+                                          unsigned argNo) const {
+  if (factsOf(&call) & kUninstrumentedCallee)
+    return false;
+
+  // Functions only read the expressions of the parameters that may be
+  // symbolic (see Symbolizer::symbolizeFunctionArguments).
+  auto *callee = call.getCalledFunction();
+  if (callee != nullptr && !callee->isDeclaration() &&
+      !callee->isInterposable() && functionFacts.count(callee) != 0)
+    return argNo < callee->arg_size() && mayBeSymbolic(callee->getArg(argNo));
+
+  return true;
+}
+
+void InputTaint::countFunction(size_t instrumented, size_t skipped) {
+  instrumentedInstructions += instrumented;
+  skippedInstructions += skipped;
+  if (instrumented == 0)
+    skippedFunctions++;
+  else
+    instrumentedFunctions++;
+}
+
+void InputTaint::report(raw_ostream &out) const {
+  out << "[SymbolizePass] " << moduleName << ": instrumented "
+      << instrumentedInstructions << " instructions, skipped "
+      << skippedInstructions << " (" << skippedFunctions << " of "
+      << (instrumentedFunctions + skippedFunctions)
+      << " functions left uninstrumented)\n";
+}
+
+InputTaint *getInputTaint(Module &M) {
+  if (auto *disable = std::getenv(kDisableVariable);
+      disable != nullptr && StringRef(disable) == "1")
+    return nullptr;
+
+  if (cachedInputTaint.module != &M) {
+    cachedInputTaint.module = &M;
+    cachedInputTaint.analysis = std::make_unique<InputTaint>(M);
+  }
+
+  return cachedInputTaint.analysis.get();
+}
+
+void releaseInputTaint(Module &M) {
+  if (cachedInputTaint.module != &M)
+    return;
+
+  cachedInputTaint.analysis->report(errs());
+  cachedInputTaint.module = nullptr;
+  cachedInputTaint.analysis.reset();
+}
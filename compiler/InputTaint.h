@@ -0,0 +1,124 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef INPUTTAINT_H
+#define INPUTTAINT_H
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ValueMap.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <string>
+
+//
+// A flow-insensitive, interprocedural analysis of which values in a module can
+// carry symbolic data, so that we don't instrument code that only ever
+// computes on concrete values (e.g., timers, logging and configuration).
+//
+// Symbolic data enters the module through the functions that write it to
+// memory (the run-time library's wrappers of read, fread, mmap and friends,
+// symcc_make_symbolic*, and any external function that may be instrumented
+// elsewhere, e.g., ROS deserializers), through the parameters of functions that
+// code outside the module can call, and through the results of calls to such
+// functions. Memory is partitioned into regions by unifying the pointers that
+// may refer to the same object; the stack variables and internal globals whose
+// address never leaves the module each get their own region, and everything
+// else (the heap, external globals, anything other modules can reach) is one
+// region that we always assume to hold symbolic data. The C library is assumed
+// not to be instrumented.
+//
+// The symbolizer and the overflow checkers run on one function at a time, so
+// the analysis is computed when the first function of the module needs it and
+// kept until the module is finalized. Instructions that appear later (e.g.,
+// when intrinsics are lowered) are unknown to the analysis and treated as
+// possibly symbolic.
+//
+
+class InputTaint {
+public:
+  explicit InputTaint(llvm::Module &M);
+
+  /// Whether the value may have a symbolic expression at run time.
+  bool mayBeSymbolic(const llvm::Value *V) const;
+
+  /// Whether the instrumentation of the instruction can have any effect.
+  bool needsInstrumentation(const llvm::Instruction &I) const;
+
+  /// Whether any part of the function needs instrumentation.
+  bool needsInstrumentation(const llvm::Function &F) const;
+
+  /// Whether a call needs to pass the expression of the given argument.
+  bool needsParameterExpression(const llvm::CallBase &call,
+                                unsigned argNo) const;
+
+  /// Count the instructions of a function that we instrument and skip.
+  void countFunction(size_t instrumented, size_t skipped);
+
+  /// Print the counts for the module.
+  void report(llvm::raw_ostream &out) const;
+
+private:
+  // A value that replaces an analyzed one doesn't necessarily share its
+  // facts. (The maps also drop the entries of deleted values, so nothing
+  // stale is left behind if a module is never finalized.)
+  template <typename KeyT>
+  struct FactsConfig : llvm::ValueMapConfig<KeyT> {
+    enum { FollowRAUW = false };
+  };
+
+  enum Fact : uint8_t {
+    /// The value never has a symbolic expression.
+    kConcrete = 1,
+    /// The memory that the instruction writes never holds symbolic data.
+    kConcreteTarget = 2,
+    /// The call goes to code that isn't instrumented (i.e., an intrinsic or
+    /// the C library).
+    kUninstrumentedCallee = 4,
+  };
+
+  struct FunctionFacts {
+    /// The function can be called from outside the module (or indirectly).
+    bool externallyCallable = true;
+    /// The function may return a symbolic value.
+    bool returnsSymbolic = true;
+    /// The function calls code that may set the return expression.
+    bool callsInstrumentedCode = true;
+  };
+
+  uint8_t factsOf(const llvm::Value *V) const;
+
+  llvm::ValueMap<const llvm::Value *, uint8_t,
+                 FactsConfig<const llvm::Value *>>
+      facts;
+  llvm::ValueMap<const llvm::Function *, FunctionFacts,
+                 FactsConfig<const llvm::Function *>>
+      functionFacts;
+
+  std::string moduleName;
+  size_t instrumentedInstructions = 0;
+  size_t skippedInstructions = 0;
+  size_t instrumentedFunctions = 0;
+  size_t skippedFunctions = 0;
+};
+
+/// The analysis of the module, computed on first use; null if the user
+/// disabled it with SYMCC_NO_INPUT_TAINT=1.
+InputTaint *getInputTaint(llvm::Module &M);
+
+/// Report the results for the module and discard the analysis.
+void releaseInputTaint(llvm::Module &M);
+
+#endif
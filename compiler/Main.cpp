@@ -95,6 +95,12 @@ PassPluginLibraryInfo getSymbolizePluginInfo() {
                   PM.addPass(FPOverflowCheckerPass());
                   PM.addPass(SymbolizePass());
                 });
+            // The site table describes all functions of the module, so it
+            // can only be built at the end.
+            PB.registerOptimizerLastEPCallback(
+                [](ModulePassManager &PM, OptimizationLevel) {
+                  PM.addPass(SiteTablePass());
+                });
           }};
 }
 
@@ -1,49 +1,64 @@
 #ifndef OVERFLOW_H
 #define OVERFLOW_H
 
-#include <llvm/IR/BasicBlock.h>
+#include <optional>
+
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/InstVisitor.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Metadata.h>
-#include <llvm/IR/ValueMap.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include "InputTaint.h"
 #include "Runtime.h"
 
+//
+// The overflow checker doesn't change the code; it only marks the integer
+// operations to check with "symros.arith" metadata. The symbolizer turns the
+// marks into calls to _sym_check_arith, which builds the check predicates only
+// if an operand is symbolic.
+//
+
+/// The checks that _sym_check_arith can perform; must match the SYMCC_CHECK_*
+/// values in RuntimeCommon.h.
+enum ArithCheck : uint32_t {
+  kCheckAddOverflow = 1 << 0,
+  kCheckSubOverflow = 1 << 1,
+  kCheckMulOverflow = 1 << 2,
+  kCheckDivisionByZero = 1 << 3,
+  kCheckSignedBound = 1 << 4,
+  kCheckUnsignedBound = 1 << 5,
+  kCheckSignedMinusBound = 1 << 6,
+  kCheckMaxBound = 1 << 7,
+  kCheckMinBound = 1 << 8,
+  kCheckSignedMaxBound = 1 << 9,
+  kCheckSignedMinBound = 1 << 10,
+};
+
+/// The checks requested for an instruction.
+struct ArithChecks {
+  uint32_t mask;
+  int32_t threshold;
+  int32_t tolerance;
+};
+
+/// The checks that the overflow checker requested for the instruction, if any.
+std::optional<ArithChecks> getArithChecks(const llvm::Instruction &I);
+
 class OverflowChecker : public llvm::InstVisitor<OverflowChecker> {
 public:
   explicit OverflowChecker(llvm::Module &M) : runtime(M) {}
   void visitBinaryOperator(llvm::BinaryOperator &I);
   void setSementicThreshold(int sementic_threshold);
   void setSementicTolerance(int sementic_tolerance);
+  void setInputTaint(const InputTaint &taintRef) { taint = &taintRef; }
 
   const Runtime runtime;
 
 private:
-  llvm::Value *getAddOverflowCondition(llvm::BinaryOperator &I,
-                                       llvm::IRBuilder<> &IRB);
-  llvm::Value *getSubOverflowCondition(llvm::BinaryOperator &I,
-                                       llvm::IRBuilder<> &IRB);
-  llvm::Value *getMulOverflowCondition(llvm::BinaryOperator &I,
-                                       llvm::IRBuilder<> &IRB);
-  llvm::Value *getDividedByZeroCondition(llvm::BinaryOperator &I,
-                                         llvm::IRBuilder<> &IRB);
-  llvm::Value *getSementicSignedBoundCondition(llvm::BinaryOperator &I,
-                                               llvm::IRBuilder<> &IRB);
-  llvm::Value *getSementicUnsignedBoundCondition(llvm::BinaryOperator &I,
-                                                 llvm::IRBuilder<> &IRB);
-
-  llvm::Value *getSementicSignedMinusBoundCondition(llvm::BinaryOperator &I, llvm::IRBuilder<> &IRB);
-
-  llvm::Value *getSementicMaxBoundCondition(llvm::BinaryOperator &I, llvm::IRBuilder<> &IRB);
-  llvm::Value *getSementicMinBoundCondition(llvm::BinaryOperator &I, llvm::IRBuilder<> &IRB);
-
-  llvm::Value *getSementicSignedMaxBoundCondition(llvm::BinaryOperator &I, llvm::IRBuilder<> &IRB);
-  llvm::Value *getSementicSignedMinBoundCondition(llvm::BinaryOperator &I, llvm::IRBuilder<> &IRB);
-
-  int sementic_threshold;
-  int sementic_tolerance;
+  int sementic_threshold = 0;
+  int sementic_tolerance = 0;
+  const InputTaint *taint = nullptr;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -24,6 +24,7 @@
 #include <llvm/CodeGen/TargetLowering.h>
 #include <llvm/CodeGen/TargetSubtargetInfo.h>
 #include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
@@ -38,9 +39,12 @@
 #include <llvm/MC/TargetRegistry.h>
 #endif
 
+#include "ConcreteClones.h"
 #include "FPOverflow.h"
+#include "InputTaint.h"
 #include "Overflow.h"
 #include "Runtime.h"
+#include "Sites.h"
 #include "Symbolizer.h"
 #include "Unroll.h"
 
@@ -71,7 +75,7 @@ bool instrumentModule(Module &M) {
   for (auto &function : M.functions()) {
     auto name = function.getName();
     if (isInterceptedFunction(function))
-      function.setName(name + "_symbolized");
+      function.setName(name + kWrapperSuffix);
   }
 
   // Insert a constructor that initializes the runtime and any globals.
@@ -83,6 +87,24 @@ bool instrumentModule(Module &M) {
   return true;
 }
 
+bool finalizeModule(Module &M) {
+  releaseInputTaint(M);
+  releaseConcreteClones(M);
+
+  auto *siteTable = emitSiteTable(M);
+  if (siteTable == nullptr)
+    return false;
+
+  // Register the site table right after initializing the runtime.
+  if (auto *ctor = M.getFunction(kSymCtorName)) {
+    IRBuilder<> IRB(ctor->getEntryBlock().getTerminator());
+    IRB.CreateCall(Runtime(M).registerSites,
+                   IRB.CreatePointerCast(siteTable, IRB.getInt8PtrTy()));
+  }
+
+  return true;
+}
+
 bool canLower(const CallInst *CI) {
   const Function *Callee = CI->getCalledFunction();
   if (!Callee)
@@ -172,12 +194,29 @@ void liftInlineAssembly(CallInst *CI) {
 
 bool instrumentFunction(Function &F, llvm::LoopInfo *LI) {
   auto functionName = F.getName();
-  if (functionName == kSymCtorName)
+  // Concrete clones stay uninstrumented.
+  if (functionName == kSymCtorName || ConcreteClones::isClone(F))
     return false;
 
   // DEBUG(errs() << "Symbolizing function ");
   // DEBUG(errs().write_escaped(functionName) << '\n');
 
+  // Leave functions alone that never see symbolic data.
+  auto *taint = getInputTaint(*F.getParent());
+  if (taint && !taint->needsInstrumentation(F)) {
+    taint->countFunction(0, F.getInstructionCount());
+    return false;
+  }
+
+  // Clone the function before we modify its body. The checkers have run
+  // already, but they only add annotations and branches without effects, so
+  // the clone doesn't need the runtime.
+  auto *clones = getConcreteClones(*F.getParent());
+  if (clones && clones->hasClone(F))
+    clones->getClone(F);
+  else
+    clones = nullptr;
+
   SmallVector<Instruction *, 0> allInstructions;
   allInstructions.reserve(F.getInstructionCount());
   for (auto &I : instructions(F))
@@ -201,17 +240,32 @@ bool instrumentFunction(Function &F, llvm::LoopInfo *LI) {
   Symbolizer symbolizer(*F.getParent());
   if (LI)
     symbolizer.setLoopInfo(*LI);
+  if (taint)
+    symbolizer.setInputTaint(*taint);
+  symbolizer.numberInstructions(allInstructions);
   symbolizer.symbolizeFunctionArguments(F);
 
   for (auto &basicBlock : F)
     symbolizer.insertBasicBlockNotification(basicBlock);
 
-  for (auto *instPtr : allInstructions)
+  size_t skipped = 0;
+  for (auto *instPtr : allInstructions) {
+    if (taint && !taint->needsInstrumentation(*instPtr)) {
+      skipped++;
+      continue;
+    }
     symbolizer.visit(instPtr);
+  }
+  if (taint)
+    taint->countFunction(allInstructions.size() - skipped, skipped);
 
   symbolizer.finalizePHINodes();
   symbolizer.shortCircuitExpressionUses();
 
+  // Run the clone instead if the inputs turn out to be concrete.
+  if (clones)
+    clones->insertDispatch(F, taint);
+
   // DEBUG(errs() << F << '\n');
   assert(!verifyFunction(F, &errs()) &&
          "SymbolizePass produced invalid bitcode");
@@ -223,8 +277,13 @@ bool instrumentFunction(Function &F, llvm::LoopInfo *LI) {
 
 bool OverflowCheckerLegacyPass::runOnFunction(Function &F) {
   // OverflowChecker checker;
+  if (ConcreteClones::isClone(F))
+    return false;
+
   errs() << "[OverflowCheckerLegacyPass] visiting function: " << F.getName() << "\n";
   OverflowChecker checker(*F.getParent());
+  if (auto *taint = getInputTaint(*F.getParent()))
+    checker.setInputTaint(*taint);
   checker.setSementicThreshold(10);
   checker.setSementicTolerance(10);
 
@@ -241,8 +300,13 @@ bool OverflowCheckerLegacyPass::runOnFunction(Function &F) {
 
 bool FPOverflowCheckerLegacyPass::runOnFunction(Function &F) {
   // OverflowChecker checker;
+  if (ConcreteClones::isClone(F))
+    return false;
+
   errs() << "[FPOverflowCheckerLegacyPass] visiting function: " << F.getName() << "\n";
   FPOverflowChecker checker(*F.getParent());
+  if (auto *taint = getInputTaint(*F.getParent()))
+    checker.setInputTaint(*taint);
   checker.setSementicThreshold(100.0);
   checker.setSementicTolerance(1e-5);
 
@@ -266,12 +330,21 @@ bool SymbolizeLegacyPass::runOnFunction(Function &F) {
   return instrumentFunction(F, nullptr);
 }
 
+bool SymbolizeLegacyPass::doFinalization(Module &M) {
+  return finalizeModule(M);
+}
+
 #if LLVM_VERSION_MAJOR >= 12
 
 PreservedAnalyses OverflowCheckerPass::run(Function &F,
                                            FunctionAnalysisManager &) {
+  if (ConcreteClones::isClone(F))
+    return PreservedAnalyses::all();
+
   errs() << "[OverflowCheckerPass] visiting function: " << F.getName() << "\n";
   OverflowChecker checker(*F.getParent());
+  if (auto *taint = getInputTaint(*F.getParent()))
+    checker.setInputTaint(*taint);
   checker.setSementicThreshold(100);
 
   std::vector<Instruction *> allInstructions;
@@ -286,8 +359,13 @@ PreservedAnalyses OverflowCheckerPass::run(Function &F,
 
 PreservedAnalyses FPOverflowCheckerPass::run(Function &F,
                                              FunctionAnalysisManager &) {
+  if (ConcreteClones::isClone(F))
+    return PreservedAnalyses::all();
+
   errs() << "[FPOverflowCheckerPass] visiting function: " << F.getName() << "\n";
   FPOverflowChecker checker(*F.getParent());
+  if (auto *taint = getInputTaint(*F.getParent()))
+    checker.setInputTaint(*taint);
   checker.setSementicThreshold(100.0);
 
   std::vector<Instruction *> allInstructions;
@@ -340,4 +418,9 @@ PreservedAnalyses SymbolizePass::run(Module &M, ModuleAnalysisManager &) {
                              : PreservedAnalyses::all();
 }
 
+PreservedAnalyses SiteTablePass::run(Module &M, ModuleAnalysisManager &) {
+  return finalizeModule(M) ? PreservedAnalyses::none()
+                           : PreservedAnalyses::all();
+}
+
 #endif
@@ -58,6 +58,7 @@ public:
 
   virtual bool doInitialization(llvm::Module &M) override;
   virtual bool runOnFunction(llvm::Function &F) override;
+  virtual bool doFinalization(llvm::Module &M) override;
 };
 
 #if LLVM_VERSION_MAJOR >= 12
@@ -96,6 +97,15 @@ public:
   static bool isRequired() { return true; }
 };
 
+/// Emit the site table of the module once all functions are instrumented
+/// (see Sites.h).
+class SiteTablePass : public llvm::PassInfoMixin<SiteTablePass> {
+public:
+  llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &);
+
+  static bool isRequired() { return true; }
+};
+
 #endif
 
 #endif
@@ -74,9 +74,11 @@ Runtime::Runtime(Module &M) {
       import(M, "_sym_concat_helper", ptrT, ptrT,
              ptrT); // doesn't follow naming convention for historic reasons
   pushPathConstraint =
-      import(M, "_sym_push_path_constraint_with_loc", voidT, ptrT, int1T, intPtrType);
-  pushPathConstraintWithLoc =
-      import(M, "_sym_push_path_constraint_with_loc", voidT, ptrT, int1T, intPtrType, ptrT, int32T, int32T);
+      import(M, "_sym_push_path_constraint", voidT, ptrT, int1T, intPtrType);
+  registerSites = import(M, "_sym_register_sites", voidT, ptrT);
+  checkArith = import(M, "_sym_check_arith", voidT, int32T, ptrT, ptrT, ptrT,
+                      IRB.getInt64Ty(), IRB.getInt64Ty(), IRB.getInt64Ty(),
+                      int32T, int32T, intPtrType);
 
   // Overflow arithmetic
   buildAddOverflow =
@@ -197,6 +199,8 @@ Runtime::Runtime(Module &M) {
   memcpy = import(M, "_sym_memcpy", voidT, ptrT, ptrT, intPtrType);
   memset = import(M, "_sym_memset", voidT, ptrT, ptrT, intPtrType);
   memmove = import(M, "_sym_memmove", voidT, ptrT, ptrT, intPtrType);
+  isConcreteMemory =
+      import(M, "_sym_is_concrete_memory", int1T, ptrT, intPtrType);
   readMemory =
       import(M, "_sym_read_memory", ptrT, intPtrType, intPtrType, int1T);
   writeMemory = import(M, "_sym_write_memory", voidT, intPtrType, intPtrType,
@@ -215,11 +219,16 @@ Runtime::Runtime(Module &M) {
 /// Decide whether a function is called symbolically.
 bool isInterceptedFunction(const Function &f) {
   static const StringSet<> kInterceptedFunctions = {
-      "malloc", "calloc",  "mmap",     "mmap64",  "open",    "read",
-      "lseek",  "lseek64", "fopen",    "fopen64", "fread",   "fseek",
-      "fseeko", "rewind",  "fseeko64", "getc",    "ungetc",  "memcpy",
-      "memset", "strncpy", "strchr",   "memcmp",  "memmove", "ntohl",
-      "fgets",  "fgetc",   "getchar",  "bcopy",   "bcmp",    "bzero"};
+      "malloc",  "calloc",  "realloc", "free",     "mmap",    "mmap64",
+      "munmap",  "mremap",  "open",    "read",     "lseek",   "lseek64",
+      "fopen",   "fopen64", "fread",   "fseek",    "fseeko",  "rewind",
+      "fseeko64", "getc",   "ungetc",  "memcpy",   "memset",  "strncpy",
+      "strchr",  "memcmp",  "memmove", "ntohl",    "fgets",   "fgetc",
+      "getchar", "bcopy",   "bcmp",    "bzero"};
 
   return (kInterceptedFunctions.count(f.getName()) > 0);
 }
+
+bool isRuntimeWrapper(const Function &f) {
+  return isInterceptedFunction(f) || f.getName().endswith(kWrapperSuffix);
+}
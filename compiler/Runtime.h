@@ -72,6 +72,7 @@ struct Runtime {
   SymFnT memcpy{};
   SymFnT memset{};
   SymFnT memmove{};
+  SymFnT isConcreteMemory{};
   SymFnT readMemory{};
   SymFnT writeMemory{};
   SymFnT buildZeroBytes{};
@@ -82,7 +83,8 @@ struct Runtime {
   SymFnT notifyBasicBlock{};
   // branch instrunction localization
   SymFnT localizeBranchInstruction{};
-  SymFnT pushPathConstraintWithLoc{};
+  SymFnT registerSites{};
+  SymFnT checkArith{};
 
   /// Mapping from icmp predicates to the functions that build the corresponding
   /// symbolic expressions.
@@ -103,4 +105,12 @@ struct Runtime {
 
 bool isInterceptedFunction(const llvm::Function &f);
 
+/// The suffix that calls to intercepted functions get (see
+/// isInterceptedFunction), redirecting them to the run-time library.
+constexpr char kWrapperSuffix[] = "_symbolized";
+
+/// Decide whether a function is a wrapper in the run-time library, before or
+/// after the redirection.
+bool isRuntimeWrapper(const llvm::Function &f);
+
 #endif
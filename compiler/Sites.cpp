@@ -0,0 +1,204 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Sites.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/xxhash.h>
+
+#if LLVM_VERSION_MAJOR < 17
+#include <llvm/ADT/Triple.h>
+#else
+#include <llvm/TargetParser/Triple.h>
+#endif
+
+using namespace llvm;
+
+namespace {
+
+/// The named metadata that collects the sites of the module.
+constexpr char kSitesMetadata[] = "symcc.sites";
+
+/// The section that holds the site tables, so that tools can find them in the
+/// linked binary.
+constexpr char kSiteSection[] = "symcc_sites";
+
+/// Must match SYMCC_SITE_TABLE_VERSION in RuntimeCommon.h.
+constexpr uint32_t kSiteTableVersion = 2;
+
+/// Must match SYMCC_SITE_LOOP in RuntimeCommon.h.
+constexpr uint8_t kSiteLoopFlag = 1;
+
+/// The names of the check kinds, in the order of their numbers (starting at
+/// 1).
+constexpr const char *kCheckKinds[] = {
+    "int_overflow",
+    "int_divided_by_zero",
+    "int_exceptional_signed_value",
+    "int_exceptional_unsigned_value",
+    "fp_overflow",
+    "fp_divided_by_zero",
+    "fp_exceptional_value",
+    "int_exceptional_signed_minus_value",
+    "int_exceptional_max_value",
+    "int_exceptional_min_value",
+    "int_exceptional_signed_max_value",
+    "int_exceptional_signed_min_value",
+    "fp_exceptional_minus_value",
+    "fp_exceptional_max_value",
+    "fp_exceptional_min_value",
+};
+
+uint64_t getInt(const MDNode *node, unsigned index) {
+  return mdconst::extract<ConstantInt>(node->getOperand(index))
+      ->getZExtValue();
+}
+
+StringRef getString(const MDNode *node, unsigned index) {
+  return cast<MDString>(node->getOperand(index))->getString();
+}
+
+} // namespace
+
+uint8_t getCheckKind(const Instruction &I) {
+  auto *MD = I.getMetadata("symros.check");
+  if (MD == nullptr || MD->getNumOperands() == 0)
+    return 0;
+
+  auto *S = dyn_cast<MDString>(MD->getOperand(0));
+  if (S == nullptr)
+    return 0;
+
+  for (size_t i = 0; i < std::size(kCheckKinds); i++) {
+    if (S->getString() == kCheckKinds[i])
+      return i + 1;
+  }
+
+  return 0;
+}
+
+uint64_t computeSiteId(const Function &F, unsigned position) {
+  std::string key = F.getParent()->getSourceFileName();
+  key.push_back('\0');
+  key.append(F.getName().begin(), F.getName().end());
+  key.push_back('\0');
+  char positionBytes[sizeof(uint32_t)];
+  support::endian::write32le(positionBytes, position);
+  key.append(positionBytes, sizeof(positionBytes));
+  return xxHash64(key);
+}
+
+void recordSite(Module &M, uint64_t siteId, const Instruction &I,
+                unsigned position, uint8_t checkKind, bool loop) {
+  // Report the location in the source code that the user wrote, i.e., look
+  // through inlining.
+  StringRef filename;
+  int line = -1;
+  unsigned column = 0;
+  if (const DILocation *Loc = I.getDebugLoc()) {
+    while (Loc->getInlinedAt())
+      Loc = Loc->getInlinedAt();
+
+    filename = Loc->getFilename();
+    line = Loc->getLine();
+    column = Loc->getColumn();
+  }
+
+  auto &C = M.getContext();
+  auto *int32T = Type::getInt32Ty(C);
+  auto *int8T = Type::getInt8Ty(C);
+  Metadata *fields[] = {
+      ConstantAsMetadata::get(ConstantInt::get(Type::getInt64Ty(C), siteId)),
+      MDString::get(C, filename),
+      MDString::get(C, I.getFunction()->getName()),
+      ConstantAsMetadata::get(ConstantInt::get(int32T, line, true)),
+      ConstantAsMetadata::get(ConstantInt::get(int32T, column)),
+      ConstantAsMetadata::get(ConstantInt::get(int32T, position)),
+      ConstantAsMetadata::get(ConstantInt::get(int8T, checkKind)),
+      ConstantAsMetadata::get(
+          ConstantInt::get(int8T, loop ? kSiteLoopFlag : 0))};
+  M.getOrInsertNamedMetadata(kSitesMetadata)
+      ->addOperand(MDNode::get(C, fields));
+}
+
+GlobalVariable *emitSiteTable(Module &M) {
+  auto *records = M.getNamedMetadata(kSitesMetadata);
+  if (records == nullptr)
+    return nullptr;
+
+  auto &C = M.getContext();
+  auto *int64T = Type::getInt64Ty(C);
+  auto *int32T = Type::getInt32Ty(C);
+  auto *int8T = Type::getInt8Ty(C);
+  auto *siteT = StructType::get(int64T, int32T, int32T, int32T, int32T, int32T,
+                                int8T, int8T, ArrayType::get(int8T, 2));
+
+  // Each string is stored once; sites refer to file and function names by
+  // their offset in the string pool.
+  std::string strings;
+  StringMap<uint32_t> stringOffsets;
+  auto addString = [&](StringRef string) {
+    auto [entry, inserted] = stringOffsets.try_emplace(string, strings.size());
+    if (inserted) {
+      strings.append(string.begin(), string.end());
+      strings.push_back('\0');
+    }
+    return ConstantInt::get(int32T, entry->second);
+  };
+
+  auto *module = addString(M.getSourceFileName());
+  std::vector<Constant *> sites;
+  sites.reserve(records->getNumOperands());
+  for (auto *record : records->operands()) {
+    sites.push_back(ConstantStruct::get(
+        siteT, {ConstantInt::get(int64T, getInt(record, 0)),
+                addString(getString(record, 1)),
+                addString(getString(record, 2)),
+                ConstantInt::get(int32T, getInt(record, 3)),
+                ConstantInt::get(int32T, getInt(record, 4)),
+                ConstantInt::get(int32T, getInt(record, 5)),
+                ConstantInt::get(int8T, getInt(record, 6)),
+                ConstantInt::get(int8T, getInt(record, 7)),
+                ConstantAggregateZero::get(ArrayType::get(int8T, 2))}));
+  }
+
+  M.eraseNamedMetadata(records);
+
+  // Keep the size of the table a multiple of its alignment, so that the
+  // tables of all modules in the section are contiguous.
+  strings.resize((strings.size() + 7) & ~size_t(7), '\0');
+
+  auto *header = ConstantStruct::getAnon(
+      {ConstantInt::get(int32T, kSiteTableVersion),
+       ConstantInt::get(int32T, sites.size()),
+       ConstantInt::get(int32T, strings.size()), module});
+  auto *sitesArray =
+      ConstantArray::get(ArrayType::get(siteT, sites.size()), sites);
+  auto *pool = ConstantDataArray::getRaw(strings, strings.size(), int8T);
+  auto *table = ConstantStruct::getAnon({header, sitesArray, pool});
+
+  auto *tableVar = new GlobalVariable(M, table->getType(), true,
+                                     GlobalValue::PrivateLinkage, table,
+                                     "__sym_site_table");
+  tableVar->setAlignment(Align(8));
+  if (Triple(M.getTargetTriple()).isOSBinFormatELF())
+    tableVar->setSection(kSiteSection);
+
+  return tableVar;
+}
@@ -0,0 +1,54 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SITES_H
+#define SITES_H
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/IR/Module.h>
+
+//
+// The site table of a module describes every place where the instrumented
+// code pushes path constraints: source location, check kind and whether the
+// site is a loop condition. The calls into the run-time library then only
+// pass the site ID, and the runtime looks up the rest when it needs it.
+//
+// Site IDs are a hash of the module's source file, the function name and the
+// position of the instruction in the function, so they are the same in every
+// build of the same code and (barring collisions, see util/site_map.py) unique
+// across all modules of a program.
+//
+// The symbolizer runs on one function at a time, so it records the sites as
+// module metadata, and the table is built once all functions are done. The
+// layout of the table must match SymSiteTable in RuntimeCommon.h.
+//
+
+/// The check kind of a branch that the overflow checkers inserted (see the
+/// "symros.check" metadata), or 0 for ordinary branches.
+uint8_t getCheckKind(const llvm::Instruction &I);
+
+/// Compute the ID of the site at the given position in a function.
+uint64_t computeSiteId(const llvm::Function &F, unsigned position);
+
+/// Record a site in the module's metadata.
+void recordSite(llvm::Module &M, uint64_t siteId, const llvm::Instruction &I,
+                unsigned position, uint8_t checkKind, bool loop);
+
+/// Build the site table from the recorded sites, and remove the records.
+/// Returns null if the module doesn't have any sites.
+llvm::GlobalVariable *emitSiteTable(llvm::Module &M);
+
+#endif
@@ -22,6 +22,7 @@
 #include <llvm/IR/Metadata.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
 
+#include "Overflow.h"
 #include "Runtime.h"
 
 using namespace llvm;
@@ -34,7 +35,7 @@ void Symbolizer::symbolizeFunctionArguments(Function &F) {
   IRBuilder<> IRB(F.getEntryBlock().getFirstNonPHI());
 
   for (auto &arg : F.args()) {
-    if (!arg.user_empty())
+    if (!arg.user_empty() && (!taint || taint->mayBeSymbolic(&arg)))
       symbolicExpressions[&arg] = IRB.CreateCall(runtime.getParameterExpression,
                                                  IRB.getInt8(arg.getArgNo()));
   }
@@ -45,6 +46,22 @@ void Symbolizer::insertBasicBlockNotification(llvm::BasicBlock &B) {
   IRB.CreateCall(runtime.notifyBasicBlock, getTargetPreferredInt(&B));
 }
 
+void Symbolizer::numberInstructions(ArrayRef<Instruction *> instructions) {
+  for (size_t i = 0; i < instructions.size(); i++)
+    instructionPositions[instructions[i]] = i;
+}
+
+ConstantInt *Symbolizer::registerSite(Instruction &I, uint8_t checkKind,
+                                      bool loop) {
+  auto position = instructionPositions.lookup(&I);
+  // On 32-bit targets, site IDs are truncated to the size of a pointer.
+  auto *siteId =
+      ConstantInt::get(intPtrType, computeSiteId(*I.getFunction(), position));
+  recordSite(*I.getModule(), siteId->getZExtValue(), I, position, checkKind,
+             loop);
+  return siteId;
+}
+
 void Symbolizer::setLoopInfo(llvm::LoopInfo &LoopInfoRef) { LI = &LoopInfoRef; }
 
 void Symbolizer::finalizePHINodes() {
@@ -376,12 +393,16 @@ void Symbolizer::handleFunctionCall(CallBase &I, Instruction *returnPoint) {
   // if (callee == nullptr)
     // tryAlternative(IRB, I.getCalledOperand(), I);
 
-  for (Use &arg : I.args())
+  for (Use &arg : I.args()) {
+    // The callee doesn't read the expressions of concrete parameters.
+    if (taint && !taint->needsParameterExpression(I, arg.getOperandNo()))
+      continue;
     IRB.CreateCall(runtime.setParameterExpression,
                    {ConstantInt::get(IRB.getInt8Ty(), arg.getOperandNo()),
                     getSymbolicExpressionOrNull(arg)});
+  }
 
-  if (!I.user_empty()) {
+  if (!I.user_empty() && (!taint || taint->mayBeSymbolic(&I))) {
     // The result of the function is used somewhere later on. Since we have no
     // way of knowing whether the function is instrumented (and thus sets a
     // proper return expression), we have to account for the possibility that
@@ -428,6 +449,31 @@ void Symbolizer::visitBinaryOperator(BinaryOperator &I) {
   auto runtimeCall =
       buildRuntimeCall(IRB, handler, {I.getOperand(0), I.getOperand(1)});
   registerSymbolicComputation(runtimeCall, &I);
+
+  // The overflow checker may have asked for checks on the operation (see
+  // Overflow.h). The run-time library builds them from the operands and the
+  // result, so they depend on the same inputs as the result: if it is
+  // concrete, there is nothing to check, and otherwise the short-circuiting
+  // code gives us the result expression.
+  auto checks = getArithChecks(I);
+  if (!checks || !runtimeCall)
+    return;
+
+  IRBuilder<> CheckIRB(I.getNextNode());
+  auto *int64T = CheckIRB.getInt64Ty();
+  auto checkCall = buildRuntimeCall(
+      CheckIRB, runtime.checkArith,
+      {{CheckIRB.getInt32(checks->mask), false},
+       {I.getOperand(0), true},
+       {I.getOperand(1), true},
+       {runtimeCall->lastInstruction, false},
+       {CheckIRB.CreateZExt(I.getOperand(0), int64T), false},
+       {CheckIRB.CreateZExt(I.getOperand(1), int64T), false},
+       {CheckIRB.CreateZExt(&I, int64T), false},
+       {CheckIRB.getInt32(checks->threshold), false},
+       {CheckIRB.getInt32(checks->tolerance), false},
+       {registerSite(I), false}});
+  registerSymbolicComputation(checkCall);
 }
 
 void Symbolizer::visitUnaryOperator(UnaryOperator &I) {
@@ -445,33 +491,10 @@ void Symbolizer::visitSelectInst(SelectInst &I) {
   // expression over from the chosen argument.
 
   IRBuilder<> IRB(&I);
-
-  // locage branch instrunction
-  std::string filename;
-  int Line = -1;
-  if (auto DL = I.getDebugLoc()) {
-    if (auto Loc = DL.get()) {
-      while (Loc && Loc->getInlinedAt()) {
-        Loc = Loc->getInlinedAt();
-      }
-
-      filename = Loc->getFilename().str();
-      Line = Loc->getLine();
-    }
-  }
-  llvm::Value *filenameVal = IRB.CreateGlobalStringPtr(filename);
-  llvm::Value *lineVal = IRB.getInt32(Line);
-
-  int slot = ID++;
-  llvm::Value *slotVal = IRB.getInt32(slot);
-
-  auto runtimeCall = buildRuntimeCall(IRB, runtime.pushPathConstraintWithLoc,
+  auto runtimeCall = buildRuntimeCall(IRB, runtime.pushPathConstraint,
                                       {{I.getCondition(), true},
                                        {I.getCondition(), false},
-                                       {getTargetPreferredInt(&I), false},
-                                       {filenameVal, false},
-                                       {lineVal, false},
-                                       {slotVal, false}});
+                                       {registerSite(I), false}});
   registerSymbolicComputation(runtimeCall);
   if (getSymbolicExpression(I.getTrueValue()) ||
       getSymbolicExpression(I.getFalseValue())) {
@@ -519,70 +542,7 @@ void Symbolizer::visitBranchInst(BranchInst &I) {
 
   IRBuilder<> IRB(&I);
 
-  // branch instrunction localization
-  std::string filename;
-  int Line = -1;
-
-  if (auto DL = I.getDebugLoc()) {
-    if (auto Loc = DL.get()) {
-      while (Loc && Loc->getInlinedAt()) {
-        Loc = Loc->getInlinedAt();
-      }
-
-      filename = Loc->getFilename().str();
-      Line = Loc->getLine();
-    }
-  }
-
-  llvm::Value *filenameVal = IRB.CreateGlobalStringPtr(filename);
-  llvm::Value *lineVal = IRB.getInt32(Line);
-  int slot = ID++;
-
-  // identify symros numeric check branch
-  if (MDNode *MD = I.getMetadata("symros.check")) {
-    if (MD->getNumOperands() > 0) {
-      if (auto *S = dyn_cast<MDString>(MD->getOperand(0))) {
-        std::string check_type = S->getString().str();
-
-        if (check_type == "int_overflow")
-          slot += 1000;
-        else if (check_type == "int_divided_by_zero")
-          slot += 2000;
-        else if (check_type == "int_exceptional_signed_value")
-          slot += 3000;
-        else if (check_type == "int_exceptional_unsigned_value")
-          slot += 4000;
-        else if (check_type == "fp_overflow")
-          slot += 5000;
-        else if (check_type == "fp_divided_by_zero")
-          slot += 6000;
-        else if (check_type == "fp_exceptional_value")
-          slot += 7000;
-        else if (check_type == "int_exceptional_signed_minus_value")
-          slot += 8000;
-        else if (check_type == "int_exceptional_max_value")
-          slot += 9000;
-        else if (check_type == "int_exceptional_min_value")
-          slot += 10000;
-        else if (check_type == "int_exceptional_signed_max_value")
-          slot += 11000;
-        else if (check_type == "int_exceptional_signed_min_value")
-          slot += 12000;
-        else if (check_type == "fp_exceptional_minus_value")
-          slot += 13000;
-        else if (check_type == "fp_exceptional_max_value")
-          slot += 14000;
-        else if (check_type == "fp_exceptional_min_value")
-          slot += 15000;
-      }
-    }
-  }
-
-  llvm::Value *slotVal = IRB.getInt32(slot);
-  // if (filename.find("/libcxx_symcc_install") == std::string::npos) {
-  //   IRB.CreateCall(runtime.localizeBranchInstruction,
-  //                 {filenameVal, lineVal});
-  // }
+  auto checkKind = getCheckKind(I);
 
   // loop info identify
   if (LI) {
@@ -599,7 +559,6 @@ void Symbolizer::visitBranchInst(BranchInst &I) {
 
         if (S0In ^ S1In) {
           errs() << "loop condition is identified!\n";
-          slotVal = IRB.getInt32(-1);
 
           // [NEW] 이미 이 branch에 guard를 삽입했으면 다시 하지 않기 (무한 split
           // 방지)
@@ -650,13 +609,10 @@ void Symbolizer::visitBranchInst(BranchInst &I) {
                         llvm::MDNode::get(I.getContext(), {}));
 
           auto runtimeCall =
-              buildRuntimeCall(PushIRB, runtime.pushPathConstraintWithLoc,
-                              {{I.getCondition(), true},
+              buildRuntimeCall(PushIRB, runtime.pushPathConstraint,
+                               {{I.getCondition(), true},
                                 {I.getCondition(), false},
-                                {getTargetPreferredInt(&I), false},
-                                {filenameVal, false},
-                                {lineVal, false},
-                                {slotVal, false}});
+                                {registerSite(I, checkKind, true), false}});
           registerSymbolicComputation(runtimeCall);
 
           PushIRB.CreateStore(PushIRB.getTrue(), LoopSeenFlag[&I]);
@@ -671,13 +627,11 @@ void Symbolizer::visitBranchInst(BranchInst &I) {
     }
   }
 
-  auto runtimeCall = buildRuntimeCall(IRB, runtime.pushPathConstraintWithLoc,
-                                      {{I.getCondition(), true},
-                                       {I.getCondition(), false},
-                                       {getTargetPreferredInt(&I), false},
-                                       {filenameVal, false},
-                                       {lineVal, false},
-                                       {slotVal, false}});
+  auto runtimeCall = buildRuntimeCall(
+      IRB, runtime.pushPathConstraint,
+      {{I.getCondition(), true},
+       {I.getCondition(), false},
+       {registerSite(I, checkKind), false}});
   registerSymbolicComputation(runtimeCall);
 }
 
@@ -1096,26 +1050,7 @@ void Symbolizer::visitSwitchInst(SwitchInst &I) {
   if (conditionExpr == nullptr)
     return;
 
-  // Locate the switch instruction
-  std::string filename;
-  int Line = -1;
-
-  if (auto DL = I.getDebugLoc()) {
-    if (auto Loc = DL.get()) {
-      while (Loc && Loc->getInlinedAt()) {
-        Loc = Loc->getInlinedAt();
-      }
-
-      filename = Loc->getFilename().str();
-      Line = Loc->getLine();
-    }
-  }
-
-  llvm::Value *filenameVal = IRB.CreateGlobalStringPtr(filename);
-  llvm::Value *lineVal = IRB.getInt32(Line);
-
-  int slot = ID++;
-  llvm::Value *slotVal = IRB.getInt32(slot);
+  auto *siteId = registerSite(I);
 
   // Build a check whether we have a symbolic condition, to be used later.
   auto *haveSymbolicCondition = IRB.CreateICmpNE(
@@ -1130,9 +1065,8 @@ void Symbolizer::visitSwitchInst(SwitchInst &I) {
     auto *caseConstraint = IRB.CreateCall(
         runtime.comparisonHandlers[CmpInst::ICMP_EQ],
         {conditionExpr, createValueExpression(caseHandle.getCaseValue(), IRB)});
-    IRB.CreateCall(runtime.pushPathConstraintWithLoc,
-                   {caseConstraint, caseTaken, getTargetPreferredInt(&I),
-                    filenameVal, lineVal, slotVal});
+    IRB.CreateCall(runtime.pushPathConstraint,
+                   {caseConstraint, caseTaken, siteId});
   }
 }
 
@@ -25,17 +25,17 @@
 #include <unordered_map>
 #include <utility>
 
+#include "InputTaint.h"
 #include "Runtime.h"
+#include "Sites.h"
 
 class Symbolizer : public llvm::InstVisitor<Symbolizer> {
 public:
   explicit Symbolizer(llvm::Module &M)
-      : ID(0), runtime(M), dataLayout(M.getDataLayout()),
+      : runtime(M), dataLayout(M.getDataLayout()),
         ptrBits(M.getDataLayout().getPointerSizeInBits()),
         intPtrType(M.getDataLayout().getIntPtrType(M.getContext())) {}
 
-  uint64_t ID;
-
   /// Insert code to obtain the symbolic expressions for the function arguments.
   void symbolizeFunctionArguments(llvm::Function &F);
 
@@ -43,9 +43,17 @@ public:
   /// entry.
   void insertBasicBlockNotification(llvm::BasicBlock &B);
 
+  /// Remember the position of each instruction in the function before
+  /// instrumentation; site IDs are derived from it (see Sites.h).
+  void numberInstructions(llvm::ArrayRef<llvm::Instruction *> instructions);
+
   /// set Loop info
   void setLoopInfo(llvm::LoopInfo &LoopInfoRef);
 
+  /// Use the input-taint analysis to leave out expressions that are always
+  /// null.
+  void setInputTaint(const InputTaint &taintRef) { taint = &taintRef; }
+
   /// Finish the processing of PHI nodes.
   ///
   /// This assumes that there is a dummy PHI node for each such instruction in
@@ -149,6 +157,12 @@ private:
   llvm::LoopInfo *LI = nullptr;
   llvm::DenseMap<llvm::Instruction *, llvm::AllocaInst *> LoopSeenFlag;
 
+  /// The input-taint analysis of the module, if enabled.
+  const InputTaint *taint = nullptr;
+
+  /// The positions of the function's instructions (see numberInstructions).
+  llvm::DenseMap<const llvm::Instruction *, unsigned> instructionPositions;
+
   /// A symbolic input.
   struct Input {
     llvm::Value *concreteValue;
@@ -317,6 +331,11 @@ private:
                                   reinterpret_cast<uint64_t>(pointer));
   }
 
+  /// Describe the path-constraint site of the instruction in the module's
+  /// site table (see Sites.h), and return the site ID for the run-time call.
+  llvm::ConstantInt *registerSite(llvm::Instruction &I, uint8_t checkKind = 0,
+                                  bool loop = false);
+
   /// Compute the offset of a member in a (possibly nested) aggregate.
   uint64_t aggregateMemberOffset(llvm::Type *aggregateType,
                                  llvm::ArrayRef<unsigned> indices) const;
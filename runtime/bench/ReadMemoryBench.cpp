@@ -0,0 +1,114 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Microbenchmark for _sym_read_memory. We store symbolic words and load them
+// back, once with the runtime's implementation (which folds consecutive
+// extracts of the same expression) and once with a reader that concatenates
+// the shadow bytes one by one, the way the runtime used to. Besides the time
+// per load, we report the size of the loaded expression as the number of
+// concat and extract operations in its printed form.
+//
+// Usage: symcc-read-memory-bench [number of loads]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <Runtime.h>
+#include <Shadow.h>
+
+namespace {
+
+/// Load the bytes one at a time.
+SymExpr readBytewise(uint8_t *addr, size_t length, bool little_endian) {
+  if (isConcrete(addr, length))
+    return nullptr;
+
+  SymExpr result = nullptr;
+  ReadOnlyShadow shadow(addr, length);
+  for (auto it = shadow.begin_non_null(); it != shadow.end_non_null(); ++it) {
+    if (result == nullptr)
+      result = *it;
+    else
+      result = little_endian ? _sym_concat_helper(*it, result)
+                             : _sym_concat_helper(result, *it);
+  }
+  return result;
+}
+
+size_t countOccurrences(const std::string &haystack, const char *needle) {
+  size_t count = 0;
+  for (auto pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + 1))
+    count++;
+  return count;
+}
+
+/// The number of concat and extract operations in the expression.
+size_t expressionSize(SymExpr expr) {
+  std::string text = _sym_expr_to_string(expr);
+  return countOccurrences(text, "concat") + countOccurrences(text, "extract");
+}
+
+/// Store a symbolic value and load it back. The value is a single 8-byte
+/// store or two 4-byte stores, and it's loaded as one 8-byte word.
+template <SymExpr (*Read)(uint8_t *, size_t, bool)>
+void measure(const char *name, bool split, size_t count) {
+  alignas(8) uint8_t buffer[8];
+  memset(buffer, 0, sizeof(buffer));
+
+  auto *input = _sym_get_input_byte(0, 0);
+  SymExpr loaded = nullptr;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < count; i++) {
+    // Vary the value so that the runtime can't reuse earlier results.
+    if (split) {
+      auto *value = _sym_build_add(_sym_build_zext(input, 24),
+                                   _sym_build_integer(i, 32));
+      _sym_write_memory(buffer, 4, value, true);
+      _sym_write_memory(buffer + 4, 4, value, true);
+    } else {
+      auto *value = _sym_build_add(_sym_build_zext(input, 56),
+                                   _sym_build_integer(i, 64));
+      _sym_write_memory(buffer, 8, value, true);
+    }
+    loaded = Read(buffer, 8, true);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double nanoseconds =
+      std::chrono::duration<double, std::nano>(end - start).count();
+  printf("%-10s %8.1f ns/load  (%zu concat/extract operations)\n", name,
+         nanoseconds / count, expressionSize(loaded));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100'000;
+  _sym_initialize();
+
+  printf("8-byte store, 8-byte load\n");
+  measure<readBytewise>("bytewise", false, count);
+  measure<_sym_read_memory>("folding", false, count);
+  printf("two 4-byte stores, 8-byte load\n");
+  measure<readBytewise>("bytewise", true, count);
+  measure<_sym_read_memory>("folding", true, count);
+  return 0;
+}
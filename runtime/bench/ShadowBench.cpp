@@ -0,0 +1,228 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Microbenchmark for the shadow page table. We replay a synthetic trace of
+// memory accesses in the way _sym_read_memory and _sym_write_memory handle
+// them (a concreteness check, then a walk over the shadow bytes with a page
+// lookup at every page crossing) against the std::map that the runtime used
+// to have, the page directory in Shadow.h and, where available, the
+// direct-mapped shadow.
+//
+// Usage: symcc-shadow-bench [number of accesses]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <Shadow.h>
+
+// The shadow iterators refer to a few backend functions in assertions, for
+// concrete bytes and for word records; the benchmark never builds
+// expressions, so stubs are enough.
+size_t _sym_bits_helper(SymExpr) { return 8; }
+SymExpr _sym_build_integer(uint64_t, uint8_t) { return nullptr; }
+SymExpr _sym_extract_helper(SymExpr, size_t, size_t) { return nullptr; }
+
+namespace {
+
+struct Access {
+  uintptr_t address;
+  uint32_t length;
+  bool write;
+  bool symbolic;
+};
+
+/// Generate accesses that resemble a typical program: mostly small accesses to
+/// a few stack pages, small and medium accesses spread over a heap, and the
+/// occasional large copy. A few percent of the writes are symbolic.
+std::vector<Access> generateTrace(size_t count) {
+  std::mt19937_64 random(42);
+  constexpr uintptr_t kStack = 0x7ffd00000000;
+  constexpr uintptr_t kHeap = 0x555500000000;
+  constexpr uintptr_t kHeapSize = 32 << 20;
+
+  std::vector<Access> trace;
+  trace.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    Access access{};
+    auto kind = random() % 1000;
+    if (kind < 600) {
+      access.address = kStack + random() % (8 * kPageSize);
+      access.length = 1u << (random() % 4);
+    } else if (kind < 999) {
+      access.address = kHeap + random() % kHeapSize;
+      access.length = 1 + random() % 64;
+    } else {
+      access.address = kHeap + random() % kHeapSize;
+      access.length = 1 + random() % (4 * kPageSize);
+    }
+    access.write = random() % 3 == 0;
+    access.symbolic = access.write && random() % 100 < 5;
+    trace.push_back(access);
+  }
+  return trace;
+}
+
+/// A fake expression; the benchmark only compares it against null.
+SymExpr symbolicByte() { return reinterpret_cast<SymExpr>(uintptr_t(8)); }
+
+/// The replaced implementation: a search tree from page addresses to shadows.
+struct MapTable {
+  std::map<uintptr_t, SymExpr *> pages;
+
+  SymExpr *find(uintptr_t page) const {
+    auto it = pages.find(page);
+    return it != pages.end() ? it->second : nullptr;
+  }
+
+  SymExpr *create(uintptr_t page) {
+    return pages[page] =
+               static_cast<SymExpr *>(calloc(kPageSize, sizeof(SymExpr)));
+  }
+
+  size_t size() const { return pages.size(); }
+};
+
+/// The page tables in Shadow.h. There can only be one direct shadow map per
+/// process, so we use g_shadow_pages for the one that the runtime is built
+/// with.
+#ifdef SYMCC_DIRECT_SHADOW
+ShadowPageDirectory &directory() {
+  static ShadowPageDirectory instance;
+  return instance;
+}
+DirectShadowMap &directShadow() { return g_shadow_pages; }
+#else
+ShadowPageDirectory &directory() { return g_shadow_pages; }
+#ifdef SYMCC_HAVE_DIRECT_SHADOW
+DirectShadowMap &directShadow() {
+  static DirectShadowMap instance;
+  return instance;
+}
+#endif
+#endif
+
+template <typename T, T &(*Instance)()> struct RuntimeTable {
+  SymExpr *find(uintptr_t page) const { return Instance().find(page); }
+  SymExpr *create(uintptr_t page) { return Instance().create(page).shadow; }
+  size_t size() const { return Instance().size(); }
+};
+
+/// Replay the trace against a page table, following the logic of
+/// isConcrete and the shadow iterators.
+template <typename Table> struct Replayer {
+  Table table;
+  size_t symbolicReads = 0;
+
+  SymExpr *getOrCreateShadow(uintptr_t page) {
+    if (auto *shadow = table.find(page))
+      return shadow;
+
+    return table.create(page);
+  }
+
+  bool isConcrete(uintptr_t address, size_t length) {
+    if (pageStart(address) == pageStart(address + length) &&
+        table.find(pageStart(address)) == nullptr)
+      return true;
+
+    for (uintptr_t page = pageStart(address); page < address + length;
+         page += kPageSize) {
+      auto *shadow = table.find(page);
+      if (shadow == nullptr)
+        continue;
+
+      auto first = std::max(page, address);
+      auto last = std::min(page + kPageSize, address + length);
+      for (auto a = first; a < last; a++) {
+        if (shadow[pageOffset(a)] != nullptr)
+          return false;
+      }
+    }
+    return true;
+  }
+
+  void read(uintptr_t address, size_t length) {
+    if (isConcrete(address, length))
+      return;
+    symbolicReads++;
+  }
+
+  void write(uintptr_t address, size_t length, bool symbolic) {
+    if (!symbolic && isConcrete(address, length))
+      return;
+
+    for (uintptr_t page = pageStart(address); page < address + length;
+         page += kPageSize) {
+      auto *shadow = getOrCreateShadow(page);
+      auto first = std::max(page, address);
+      auto last = std::min(page + kPageSize, address + length);
+      for (auto a = first; a < last; a++)
+        shadow[pageOffset(a)] = symbolic ? symbolicByte() : nullptr;
+    }
+  }
+
+  void replay(const std::vector<Access> &trace) {
+    for (const auto &access : trace) {
+      if (access.write)
+        write(access.address, access.length, access.symbolic);
+      else
+        read(access.address, access.length);
+    }
+  }
+};
+
+template <typename Table>
+double measure(const char *name, const std::vector<Access> &trace) {
+  // The first pass creates the shadow pages; we measure the second one, so
+  // that allocation and page faults don't dominate the result.
+  Replayer<Table> replayer;
+  replayer.replay(trace);
+  replayer.symbolicReads = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  replayer.replay(trace);
+  auto end = std::chrono::steady_clock::now();
+
+  double nanoseconds =
+      std::chrono::duration<double, std::nano>(end - start).count();
+  printf("%-10s %8.1f ns/access  (%zu shadow pages, %zu symbolic reads)\n",
+         name, nanoseconds / trace.size(), replayer.table.size(),
+         replayer.symbolicReads);
+  return nanoseconds;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10'000'000;
+  auto trace = generateTrace(count);
+
+  auto mapTime = measure<MapTable>("std::map", trace);
+  auto directoryTime =
+      measure<RuntimeTable<ShadowPageDirectory, directory>>("directory", trace);
+  printf("speedup    %8.2fx\n", mapTime / directoryTime);
+#ifdef SYMCC_HAVE_DIRECT_SHADOW
+  auto directTime =
+      measure<RuntimeTable<DirectShadowMap, directShadow>>("direct", trace);
+  printf("speedup    %8.2fx\n", mapTime / directTime);
+#endif
+  return 0;
+}
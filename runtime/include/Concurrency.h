@@ -0,0 +1,103 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CONCURRENCY_H
+#define CONCURRENCY_H
+
+#include <mutex>
+
+//
+// Building blocks for the thread-safe runtime (see SYMCC_RT_THREAD_SAFE).
+// Programs that run instrumented code on several threads need the shared
+// state of the runtime to be synchronized; single-threaded programs shouldn't
+// pay for it, so without SYMCC_THREAD_SAFE the locks below do nothing and the
+// accessors are plain memory accesses.
+//
+
+#ifdef SYMCC_THREAD_SAFE
+
+#define SYMCC_THREAD_LOCAL thread_local
+
+using RuntimeMutex = std::mutex;
+using RecursiveRuntimeMutex = std::recursive_mutex;
+
+#else
+
+#define SYMCC_THREAD_LOCAL
+
+/// A mutex that doesn't do anything, for the single-threaded runtime.
+struct NoMutex {
+  void lock() {}
+  void unlock() {}
+  bool try_lock() { return true; }
+};
+
+using RuntimeMutex = NoMutex;
+using RecursiveRuntimeMutex = NoMutex;
+
+#endif
+
+/// Read a variable that other threads may write. The acquire ordering makes
+/// the memory that a pointer refers to visible along with the pointer.
+template <typename T> T loadShared(const T &variable) {
+#ifdef SYMCC_THREAD_SAFE
+  return __atomic_load_n(&variable, __ATOMIC_ACQUIRE);
+#else
+  return variable;
+#endif
+}
+
+/// Write a variable that other threads may read without a lock.
+template <typename T> void storeShared(T &variable, T value) {
+#ifdef SYMCC_THREAD_SAFE
+  __atomic_store_n(&variable, value, __ATOMIC_RELEASE);
+#else
+  variable = value;
+#endif
+}
+
+/// Replace the value of a variable, returning the previous value.
+template <typename T> T exchangeShared(T &variable, T value) {
+#ifdef SYMCC_THREAD_SAFE
+  return __atomic_exchange_n(&variable, value, __ATOMIC_ACQ_REL);
+#else
+  T previous = variable;
+  variable = value;
+  return previous;
+#endif
+}
+
+/// Add to a counter (with wrap-around, so adding the two's complement
+/// subtracts). Counters don't order other memory accesses.
+template <typename T> void addShared(T &variable, T delta) {
+#ifdef SYMCC_THREAD_SAFE
+  __atomic_fetch_add(&variable, delta, __ATOMIC_RELAXED);
+#else
+  variable += delta;
+#endif
+}
+
+/// Set bits in a variable, returning the previous value.
+template <typename T> T fetchOrShared(T &variable, T bits) {
+#ifdef SYMCC_THREAD_SAFE
+  return __atomic_fetch_or(&variable, bits, __ATOMIC_ACQ_REL);
+#else
+  T previous = variable;
+  variable |= bits;
+  return previous;
+#endif
+}
+
+#endif
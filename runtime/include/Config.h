@@ -34,6 +34,19 @@ struct FileInput {
   std::string fileName;
 };
 
+/// Format of the constraint log written by the simple backend.
+enum class LogFormat {
+  /// Dump the entire solver state as SMT-LIB text for every query.
+  Smt,
+  /// Write declarations and path-prefix constraints once, and let each query
+  /// refer to its prefix by ID.
+  Delta,
+  /// Write each expression node once into a binary node table, and let each
+  /// query refer to its assertions by node ID (see BinaryLogFormat.h in the
+  /// simple backend).
+  Binary,
+};
+
 struct Config {
   using InputConfig = std::variant<NoInput, StdinInput, MemoryInput, FileInput>;
 
@@ -46,6 +59,43 @@ struct Config {
   /// The file to log constraint solving information to.
   std::string logFile = "";
 
+  /// The format of the constraint log.
+  LogFormat logFormat = LogFormat::Smt;
+
+  /// Do we write the log from a background thread?
+  bool asyncLog = false;
+
+  /// Do we drop log records when the asynchronous writer can't keep up (as
+  /// opposed to waiting for it)?
+  bool asyncLogDropWhenFull = false;
+
+  /// The size of the asynchronous log's buffer in bytes.
+  size_t asyncLogBufferSize = size_t(16) << 20;
+
+  /// The maximum number of queries per branch site and direction (simple
+  /// backend only); zero means no limit.
+  size_t siteBudget = 0;
+
+  /// Does each calling context of a branch site get its own budget?
+  bool siteBudgetContext = false;
+
+  /// Do we keep the path constraints of the execution in the solver, so that
+  /// queries contain them (simple backend only)? By default, each query only
+  /// contains the new constraint.
+  bool keepPathPrefix = false;
+
+  /// Do we include all path constraints in queries (simple backend only)? By
+  /// default, we drop the ones that don't share variables with the new
+  /// constraint, directly or indirectly.
+  bool fullPathPrefix = false;
+
+  /// Do we skip queries that we have emitted before (simple backend only)?
+  bool queryCache = false;
+
+  /// The file that keeps the query cache across executions; if empty, the
+  /// cache only lives as long as the process.
+  std::string queryCacheFile = "";
+
   /// Do we prune expressions on hot paths?
   bool pruning = false;
 
@@ -58,7 +108,9 @@ struct Config {
   /// The garbage collection threshold.
   ///
   /// We will start collecting unused symbolic expressions if the total number
-  /// of allocated expressions in the target program exceeds this number.
+  /// of allocated expressions in the target program exceeds this number. Later
+  /// collections wait for twice the number of expressions that survived the
+  /// previous one if that is more (see scheduleGarbageCollection).
   ///
   /// Collecting too often hurts performance, whereas delaying garbage
   /// collection for too long might make us run out of memory. The goal of this
@@ -66,6 +118,21 @@ struct Config {
   /// 2GB on most workloads because requiring that amount of memory per core
   /// participating in the analysis seems reasonable.
   size_t garbageCollectionThreshold = 5'000'000;
+
+  /// Do we release the shadows of pages that have become concrete when we
+  /// collect garbage?
+  bool releaseConcreteShadow = false;
+
+  /// The number of threads solving queries in the background (simple backend
+  /// only). Zero means that we log the queries instead of solving them.
+  size_t solverThreads = 0;
+
+  /// The number of queries that may wait for a solver thread.
+  size_t solverQueueSize = 16;
+
+  /// Do we drop queries when the solver threads can't keep up (as opposed to
+  /// waiting for them)?
+  bool solverQueueDropWhenFull = false;
 };
 
 /// The global configuration object.
@@ -16,8 +16,12 @@
 #ifndef GARBAGECOLLECTION_H
 #define GARBAGECOLLECTION_H
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <utility>
-#include <set>
+#include <vector>
 
 #include <Runtime.h>
 
@@ -29,7 +33,59 @@ using ExpressionRegion = std::pair<SymExpr *, size_t>;
 /// expressions.
 void registerExpressionRegion(ExpressionRegion r);
 
-/// Return the set of currently reachable symbolic expressions.
-std::set<SymExpr> collectReachableExpressions();
+/// A set of expressions in the form of a bitmap over expression IDs. Each
+/// backend gives its expressions small, dense IDs (e.g., Z3's AST IDs), so
+/// marking an expression and testing for it are bit operations.
+class ExpressionMarks {
+public:
+  void mark(size_t id) {
+    if (id / 64 >= bits_.size())
+      bits_.resize(std::max(id / 64 + 1, 2 * bits_.size()));
+    bits_[id / 64] |= uint64_t(1) << (id % 64);
+  }
+
+  bool isMarked(size_t id) const {
+    return id / 64 < bits_.size() && ((bits_[id / 64] >> (id % 64)) & 1);
+  }
+
+private:
+  std::vector<uint64_t> bits_;
+};
+
+/// The kinds of garbage collection. Backends keep track of the expressions
+/// that they have created since the previous collection, the young ones. A
+/// minor collection only decides which of those are garbage; since young
+/// expressions can only be in the parts of shadow memory that have received
+/// expressions since then (see DirtyCards), it only scans those. The
+/// expressions that survive become old. A full collection scans all of shadow
+/// memory and considers all expressions.
+enum class CollectionKind { None, Minor, Full };
+
+/// Decide whether it is time to collect garbage, given the number of
+/// expressions and how many of them are young.
+///
+/// We collect when the number of expressions reaches the configured threshold
+/// or twice the number that survived the previous collection, whichever is
+/// more, so that programs with many live expressions don't collect over and
+/// over without reclaiming much. Collections are minor unless the old
+/// expressions have doubled since the last full collection.
+CollectionKind scheduleGarbageCollection(size_t expressions, size_t young);
+
+/// Mark the symbolic expressions that are currently reachable, using the
+/// backend's function to map expressions to IDs. For a minor collection, only
+/// young expressions are guaranteed to be marked if they are reachable.
+ExpressionMarks markReachableExpressions(size_t (*expressionId)(SymExpr),
+                                         CollectionKind kind);
+
+/// Record a collection that left the given number of expressions alive and
+/// reclaimed the others, schedule the next one, and pass the statistics to the
+/// user's handler.
+void reportGarbageCollection(CollectionKind kind, size_t live,
+                             size_t reclaimed,
+                             std::chrono::steady_clock::duration pause);
+
+/// Release the shadows of pages that don't contain symbolic bytes anymore, if
+/// configured to do so, and return their number.
+size_t releaseConcreteShadows();
 
 #endif
@@ -199,6 +199,12 @@ Z3_ast _sym_build_bits_to_int(Z3_ast expr, int is_signed);
 SymExpr _sym_concat_helper(SymExpr a, SymExpr b);
 SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit);
 size_t _sym_bits_helper(SymExpr expr);
+/* If the expression is an extract, return its argument and store the bounds;
+ * otherwise, return null. */
+SymExpr _sym_extract_source_helper(SymExpr expr, size_t *first_bit,
+                                   size_t *last_bit);
+/* Reverse the order of the bytes. */
+SymExpr _sym_bswap_helper(SymExpr expr);
 
 /*
  * Function-call helpers
@@ -213,6 +219,8 @@ SymExpr _sym_get_return_expression(void);
  */
 void _sym_push_path_constraint(nullable SymExpr constraint, int taken,
                                uintptr_t site_id);
+/* For code instrumented without a site table, which passes the location with
+ * every constraint. */
 void _sym_push_path_constraint_with_loc(nullable SymExpr constraint, int taken,
                                uintptr_t site_id, const char * filename, int line, int col);
 SymExpr _sym_get_input_byte(size_t offset, uint8_t concrete_value);
@@ -226,6 +234,73 @@ void _sym_make_symbolic_with_prefix(const void *data, size_t byte_length,
                         size_t input_offset, const char * prefix);
 void _sym_localize_branch_instruction(const char * filename, int line_number);
 
+/*
+ * Arithmetic checks
+ *
+ * The compiler pass asks for checks on integer operations with a mask of the
+ * following values. For each check, the runtime builds a predicate over the
+ * operands and the result and pushes it, together with its concrete outcome,
+ * to the backend; the check kinds are those of the site table.
+ */
+#define SYMCC_CHECK_ADD_OVERFLOW (1u << 0)
+#define SYMCC_CHECK_SUB_OVERFLOW (1u << 1)
+#define SYMCC_CHECK_MUL_OVERFLOW (1u << 2)
+#define SYMCC_CHECK_DIVISION_BY_ZERO (1u << 3)
+#define SYMCC_CHECK_SIGNED_BOUND (1u << 4)       /* result >s threshold */
+#define SYMCC_CHECK_UNSIGNED_BOUND (1u << 5)     /* result >u threshold */
+#define SYMCC_CHECK_SIGNED_MINUS_BOUND (1u << 6) /* result <s -threshold */
+#define SYMCC_CHECK_MAX_BOUND (1u << 7)        /* within tolerance of UMAX */
+#define SYMCC_CHECK_MIN_BOUND (1u << 8)        /* result <u tolerance */
+#define SYMCC_CHECK_SIGNED_MAX_BOUND (1u << 9) /* within tolerance of SMAX */
+#define SYMCC_CHECK_SIGNED_MIN_BOUND (1u << 10) /* within tolerance of SMIN */
+
+/* The expressions must not be null; the compiler pass only calls this
+ * function when an operand is symbolic. */
+void _sym_check_arith(uint32_t kind_mask, SymExpr lhs, SymExpr rhs,
+                      SymExpr result, uint64_t lhs_value, uint64_t rhs_value,
+                      uint64_t result_value, int32_t threshold,
+                      int32_t tolerance, uintptr_t site_id);
+/* Implemented by the backends: push the predicate of a check. */
+void _sym_push_check_constraint(SymExpr constraint, int taken,
+                                uintptr_t site_id, uint8_t check_kind);
+
+/*
+ * Site metadata
+ *
+ * The compiler pass describes the path-constraint sites of each module in a
+ * table, which it places in the symcc_sites section and registers from the
+ * module's constructor; path constraints then only carry the site ID.
+ */
+#define SYMCC_SITE_TABLE_VERSION 2
+
+/* The site is a loop condition. */
+#define SYMCC_SITE_LOOP 1
+
+typedef struct {
+  /* A hash of the module, the function and the position (truncated to the
+   * size of a pointer on 32-bit targets). */
+  uint64_t site_id;
+  uint32_t file;     /* offset of the file name in the string pool */
+  uint32_t function; /* offset of the function name in the string pool */
+  int32_t line;      /* -1 if unknown */
+  uint32_t column;
+  uint32_t position; /* of the instruction in the function */
+  uint8_t check_kind; /* 0 for ordinary branches */
+  uint8_t flags;
+  uint8_t reserved[2];
+} SymSite;
+
+typedef struct {
+  uint32_t version;
+  uint32_t num_sites;
+  uint32_t strings_size;
+  uint32_t module; /* offset of the module's source file in the string pool */
+  /* Followed by num_sites SymSite records and a pool of strings_size bytes
+   * of null-terminated strings. */
+} SymSiteTable;
+
+void _sym_register_sites(const SymSiteTable *table);
+
 /*
  * Memory management
  */
@@ -235,6 +310,7 @@ void _sym_write_memory(uint8_t *addr, size_t length, nullable SymExpr expr,
 void _sym_memcpy(uint8_t *dest, const uint8_t *src, size_t length);
 void _sym_memset(uint8_t *memory, SymExpr value, size_t length);
 void _sym_memmove(uint8_t *dest, const uint8_t *src, size_t length);
+bool _sym_is_concrete_memory(const uint8_t *addr, size_t length);
 SymExpr _sym_build_zero_bytes(size_t length);
 SymExpr _sym_build_insert(SymExpr target, SymExpr to_insert, uint64_t offset,
                           bool little_endian);
@@ -274,6 +350,27 @@ void symcc_reset_constraints();
 typedef void (*TestCaseHandler)(const void *, size_t);
 void symcc_set_test_case_handler(TestCaseHandler handler);
 
+/* Statistics of the garbage collector, as of the most recent collection. */
+typedef struct {
+  uint64_t collections;      /* Collections so far */
+  uint64_t full_collections; /* Full collections among them */
+  uint64_t live;             /* Expressions that survived the collection */
+  uint64_t reclaimed;        /* Expressions that the collection released */
+  uint64_t total_reclaimed;  /* Expressions released by all collections */
+  uint64_t pause_ns;         /* Duration of the collection */
+  uint64_t total_pause_ns;   /* Duration of all collections */
+} GarbageCollectionStats;
+
+/* Register a function that receives the statistics after every collection. */
+typedef void (*GarbageCollectionStatsHandler)(const GarbageCollectionStats *);
+void symcc_set_gc_stats_handler(GarbageCollectionStatsHandler handler);
+
+/* Collect garbage if the backend holds enough expressions (see
+   SYMCC_GC_THRESHOLD). The collector only finds the symbolic values in memory,
+   so call this where no function on the call stack keeps any in local
+   variables, e.g., at the top of the program's main loop. */
+void symcc_collect_garbage(void);
+
 #ifdef __cplusplus
 }
 #endif
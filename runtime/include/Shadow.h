@@ -18,9 +18,12 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <map>
+#include <vector>
 
+#include <Concurrency.h>
 #include <Runtime.h>
 
 #include <z3.h>
@@ -28,15 +31,24 @@
 //
 // This file is dedicated to the management of shadow memory.
 //
-// We manage shadows at page granularity. Since the shadow for each page is
-// malloc'ed and thus at an unpredictable location in memory, we need special
-// handling for memory allocations that cross page boundaries. This header
+// We manage shadows at page granularity. Since the shadow for each page may be
+// at an unpredictable location in memory, we need special handling for memory
+// allocations that cross page boundaries. This header
 // provides iterators over shadow memory that automatically handle jumps between
 // memory pages (and thus shadow regions). They should work with the C++
 // standard library.
 //
 // We represent shadowed memory as a sequence of 8-bit expressions. The
-// iterators therefore expose the shadow in the form of byte expressions.
+// iterators therefore expose the shadow in the form of byte expressions. With
+// SYMCC_WORD_SHADOW, aligned words may be kept whole instead (see the word
+// records below); the iterators still expose bytes.
+//
+// In the thread-safe runtime, lookups don't take locks: the tables publish
+// new shadows with release stores, and readers use acquire loads. Only the
+// creation of shadows is serialized, with locks that are striped by page so
+// that threads working on different memory rarely contend. Shadows stay in
+// place once they exist, because another thread may be using them at any
+// time.
 //
 
 constexpr uintptr_t kPageSize = 4096;
@@ -51,9 +63,451 @@ constexpr uintptr_t pageOffset(uintptr_t addr) {
   return (addr & (kPageSize - 1));
 }
 
-/// A mapping from page addresses to the corresponding shadow regions. Each
-/// shadow is large enough to hold one expression per byte on the shadowed page.
-extern std::map<uintptr_t, SymExpr *> g_shadow_pages;
+/// The granularity at which we record where expressions have been stored since
+/// the last garbage collection (see DirtyCards); the eight cards of a page fit
+/// the bits of a byte.
+constexpr uintptr_t kCardSize = 512;
+constexpr unsigned kCardsPerPage = kPageSize / kCardSize;
+
+static_assert(kCardsPerPage == 8, "The card bits of a page must fit a byte");
+
+/// The shadow of a page, i.e., one expression per byte on the page, and the
+/// number of symbolic bytes on the page (the non-null entries of the shadow).
+/// With the count, we can tell that a page is concrete without scanning its
+/// shadow; the iterators below keep it up to date. The card bits record which
+/// parts of the shadow have received expressions since the last garbage
+/// collection.
+struct ShadowPage {
+  SymExpr *shadow;
+  uint16_t *symbolicBytes;
+  uint8_t *dirtyCards;
+};
+
+/// A mapping from page addresses to the corresponding shadows.
+///
+/// Lookups happen on every memory access, so we use a two-level page directory
+/// (like the page tables of the CPU) instead of a search tree: the high bits
+/// of the page number select a leaf table, and the low bits select the entry
+/// in the leaf. The directory itself is in zero-initialized static storage,
+/// and leaves are allocated on demand with mmap, so memory that is never
+/// touched costs nothing. Pages beyond the address range of the directory are
+/// kept in a map; user space on common systems doesn't use such addresses.
+class ShadowPageDirectory {
+public:
+  /// Return the shadow of the page starting at the given address, or a null
+  /// shadow if there is none.
+  ShadowPage findPage(uintptr_t page) {
+    auto pageNumber = page / kPageSize;
+    if (pageNumber >= kNumPages)
+      return findHigh(page);
+
+    auto *leaf = loadShared(directory_[pageNumber >> kLeafBits]);
+    if (leaf == nullptr)
+      return {nullptr, nullptr, nullptr};
+
+    auto index = pageNumber & (kLeafSize - 1);
+    return {loadShared(leaf->shadows[index]), &leaf->symbolicBytes[index],
+            &leaf->dirtyCards[index]};
+  }
+
+  SymExpr *find(uintptr_t page) { return findPage(page).shadow; }
+
+  /// Allocate an empty shadow for the page starting at the given address,
+  /// unless it has one already (which, in the thread-safe runtime, another
+  /// thread may have created since the lookup). Return the page's shadow.
+  ShadowPage create(uintptr_t page);
+
+  /// If the page has a shadow without symbolic bytes, remove it and keep it
+  /// for reuse. This invalidates iterators into the shadow, so the
+  /// thread-safe runtime doesn't do it.
+  void recycle(uintptr_t page);
+
+  /// Remove the shadows of all pages without symbolic bytes, and return their
+  /// number. This invalidates iterators into the shadows, so the thread-safe
+  /// runtime doesn't do it.
+  size_t releaseConcretePages();
+
+  /// The number of shadowed pages.
+  size_t size() const { return loadShared(size_); }
+
+  /// Call the function with the address and the shadow of every shadowed
+  /// page, without any particular order.
+  template <typename F> void forEach(F &&callback) {
+    {
+      std::lock_guard<RuntimeMutex> lock(leafMutex_);
+      for (auto directoryIndex : leaves_) {
+        auto *leaf = directory_[directoryIndex];
+        for (size_t i = 0; i < kLeafSize; i++) {
+          if (auto *shadow = loadShared(leaf->shadows[i]))
+            callback(((uintptr_t(directoryIndex) << kLeafBits) | i) *
+                         kPageSize,
+                     ShadowPage{shadow, &leaf->symbolicBytes[i],
+                                &leaf->dirtyCards[i]});
+        }
+      }
+    }
+
+    std::lock_guard<RuntimeMutex> lock(highPagesMutex_);
+    for (auto &[page, highPage] : highPages_)
+      callback(page, ShadowPage{highPage.shadow, &highPage.symbolicBytes,
+                                &highPage.dirtyCards});
+  }
+
+private:
+#if UINTPTR_MAX > 0xffffffffu
+  static constexpr unsigned kAddressBits = 48;
+#else
+  static constexpr unsigned kAddressBits = 32;
+#endif
+  static constexpr unsigned kPageNumberBits = kAddressBits - 12;
+  static constexpr uintptr_t kNumPages = uintptr_t(1) << kPageNumberBits;
+  static constexpr unsigned kLeafBits = kPageNumberBits / 2;
+  static constexpr size_t kLeafSize = size_t(1) << kLeafBits;
+  static constexpr size_t kDirectorySize =
+      size_t(1) << (kPageNumberBits - kLeafBits);
+
+  static_assert(kPageSize == 4096, "The directory assumes 4 KiB pages");
+
+  struct Leaf {
+    SymExpr *shadows[kLeafSize];
+    uint16_t symbolicBytes[kLeafSize];
+    uint8_t dirtyCards[kLeafSize];
+  };
+
+  struct HighPage {
+    SymExpr *shadow;
+    uint16_t symbolicBytes;
+    uint8_t dirtyCards;
+  };
+
+  ShadowPage findHigh(uintptr_t page);
+  ShadowPage createHigh(uintptr_t page);
+
+  /// Return the leaf with the given index, allocating it if necessary.
+  Leaf *getOrCreateLeaf(size_t directoryIndex);
+
+  /// Take a shadow from the pool, or allocate a new one.
+  SymExpr *allocateShadow();
+
+  /// Keep the (all-null) shadow for reuse, or free it if the pool is full.
+  void pool(SymExpr *shadow);
+
+  /// The number of unused shadows that we keep around.
+  static constexpr size_t kPoolSize = 256;
+
+  /// The leaves, indexed by the high bits of the page number. We rely on
+  /// zero-initialization of static storage, so there is no initializer.
+  Leaf *directory_[kDirectorySize];
+
+  /// The indices of the leaves that exist, for enumeration.
+  std::vector<uint32_t> leaves_;
+  RuntimeMutex leafMutex_;
+
+  /// Shadows of pages beyond the range of the directory.
+  std::map<uintptr_t, HighPage> highPages_;
+  RuntimeMutex highPagesMutex_;
+
+  /// Locks for the creation of shadows, selected by page number.
+  static constexpr size_t kCreateStripes = 64;
+  RuntimeMutex createMutexes_[kCreateStripes];
+
+  size_t size_ = 0;
+
+  /// Shadows that we can reuse for new pages. Programs that allocate and free
+  /// buffers for symbolic data repeatedly would otherwise keep allocating
+  /// shadows; we don't use a container so that the pool stays intact (and
+  /// visible to LeakSanitizer) while static objects are destroyed.
+  SymExpr *pool_[kPoolSize];
+  size_t pooled_ = 0;
+};
+
+#if defined(__x86_64__) && defined(__linux__)
+#define SYMCC_HAVE_DIRECT_SHADOW 1
+#endif
+
+#ifdef SYMCC_HAVE_DIRECT_SHADOW
+
+/// An alternative to the page directory that computes the location of a shadow
+/// from the address alone. We reserve one large region of address space at a
+/// fixed location, with a shadow slot for every page in the parts of the
+/// address space that Linux uses for programs on x86-64: the low range for
+/// non-PIE binaries, the range of PIE binaries and the heap, and the range
+/// below the stack where shared libraries and mappings go. The region is
+/// mapped with MAP_NORESERVE, so the kernel only commits memory for the parts
+/// that we write to, and untouched shadow reads as null, i.e., concrete.
+///
+/// A bitmap records which pages have a shadow; it spares isConcrete a read of
+/// the shadow itself and lets us enumerate the shadowed pages for garbage
+/// collection and diagnostics. Pages outside the covered ranges (which
+/// programs hardly ever use) are kept in a map, like in the page directory.
+///
+/// The region is at a fixed address, so there can only be one instance per
+/// process.
+class DirectShadowMap {
+public:
+  /// Return the shadow of the page starting at the given address, or a null
+  /// shadow if there is none.
+  ShadowPage findPage(uintptr_t page) {
+    auto index = pageIndex(page);
+    if (index == kNoIndex)
+      return findOutside(page);
+
+    if (!isShadowed(index))
+      return {nullptr, nullptr, nullptr};
+
+    return {shadowOf(index), &symbolicBytes_[index], &dirtyCards_[index]};
+  }
+
+  SymExpr *find(uintptr_t page) { return findPage(page).shadow; }
+
+  /// Provide a shadow for the page starting at the given address, unless it
+  /// has one already (which, in the thread-safe runtime, another thread may
+  /// have created since the lookup). Return the page's shadow.
+  ShadowPage create(uintptr_t page);
+
+  /// If the page has a shadow without symbolic bytes outside the region,
+  /// remove it. Shadows in the region are at fixed locations, so there is
+  /// nothing to reuse; clearing them is all it takes to make a page concrete.
+  /// The thread-safe runtime keeps all shadows in place.
+  void recycle([[maybe_unused]] uintptr_t page) {
+#ifndef SYMCC_THREAD_SAFE
+    if (pageIndex(page) == kNoIndex)
+      recycleOutside(page);
+#endif
+  }
+
+  /// Give the memory of the shadows of all pages without symbolic bytes back
+  /// to the system, and return their number. The thread-safe runtime keeps
+  /// all shadows in place.
+  size_t releaseConcretePages();
+
+  /// The number of shadowed pages.
+  size_t size() const { return pages_.size() + outsidePages_.size(); }
+
+  /// Call the function with the address and the shadow of every shadowed
+  /// page, without any particular order.
+  template <typename F> void forEach(F &&callback) {
+    {
+      std::lock_guard<RuntimeMutex> lock(pagesMutex_);
+      for (auto index : pages_)
+        callback(addressOf(index),
+                 ShadowPage{shadowOf(index), &symbolicBytes_[index],
+                            &dirtyCards_[index]});
+    }
+
+    std::lock_guard<RuntimeMutex> lock(outsidePagesMutex_);
+    for (auto &[page, outsidePage] : outsidePages_)
+      callback(page, ShadowPage{outsidePage.shadow, &outsidePage.symbolicBytes,
+                                &outsidePage.dirtyCards});
+  }
+
+private:
+  struct Range {
+    uintptr_t start;
+    uintptr_t size;
+  };
+
+  static constexpr Range kRanges[] = {
+      {0, uintptr_t(1) << 40},                         // non-PIE binaries
+      {0x550000000000, uintptr_t(1) << 41},            // PIE binaries, heap
+      {0x7e8000000000, 0x800000000000 - 0x7e8000000000}, // mappings, stack
+  };
+
+  static constexpr uintptr_t kShadowBase = 0x120000000000;
+  static constexpr size_t kNumPages =
+      (kRanges[0].size + kRanges[1].size + kRanges[2].size) / kPageSize;
+  static constexpr size_t kShadowSize = kNumPages * kPageSize * sizeof(SymExpr);
+  static constexpr size_t kNoIndex = ~size_t(0);
+
+  static_assert(kShadowBase + kShadowSize <= kRanges[1].start,
+                "The shadow region must not overlap the shadowed ranges");
+  static_assert(kNumPages <= UINT32_MAX, "Page indices must fit 32 bits");
+
+  /// Return the index of the page's shadow slot, or kNoIndex if the page
+  /// isn't in the covered ranges.
+  static size_t pageIndex(uintptr_t page) {
+    size_t firstIndex = 0;
+    for (const auto &range : kRanges) {
+      if (page - range.start < range.size)
+        return firstIndex + (page - range.start) / kPageSize;
+      firstIndex += range.size / kPageSize;
+    }
+    return kNoIndex;
+  }
+
+  static uintptr_t addressOf(size_t index);
+
+  static SymExpr *shadowOf(size_t index) {
+    return reinterpret_cast<SymExpr *>(kShadowBase) + index * kPageSize;
+  }
+
+  bool isShadowed(size_t index) const {
+    auto *bitmap = loadShared(bitmap_);
+    return bitmap != nullptr &&
+           ((loadShared(bitmap[index / 64]) >> (index % 64)) & 1);
+  }
+
+  struct OutsidePage {
+    SymExpr *shadow;
+    uint16_t symbolicBytes;
+    uint8_t dirtyCards;
+  };
+
+  ShadowPage findOutside(uintptr_t page);
+  void recycleOutside(uintptr_t page);
+
+  /// Map the shadow region, the bitmap, the counts and the cards unless another
+  /// thread has done so, and return the bitmap.
+  uint64_t *reserve();
+
+  /// One bit per page, set if the page has a shadow; null until we reserve
+  /// the shadow region. We publish it last, so the rest of the region is in
+  /// place when other threads see it.
+  uint64_t *bitmap_ = nullptr;
+  RuntimeMutex reserveMutex_;
+
+  /// The number of symbolic bytes and the dirty cards of each page.
+  uint16_t *symbolicBytes_ = nullptr;
+  uint8_t *dirtyCards_ = nullptr;
+
+  /// The indices of the shadowed pages, for enumeration.
+  std::vector<uint32_t> pages_;
+  RuntimeMutex pagesMutex_;
+
+  /// Shadows of pages outside the covered ranges.
+  std::map<uintptr_t, OutsidePage> outsidePages_;
+  RuntimeMutex outsidePagesMutex_;
+};
+
+#endif
+
+#if defined(SYMCC_DIRECT_SHADOW) && !defined(SYMCC_HAVE_DIRECT_SHADOW)
+#error "The direct-mapped shadow is only available on x86-64 Linux"
+#endif
+
+#ifdef SYMCC_DIRECT_SHADOW
+using ShadowPages = DirectShadowMap;
+#else
+using ShadowPages = ShadowPageDirectory;
+#endif
+
+extern ShadowPages g_shadow_pages;
+
+/// The pages with cards that have received expressions since the last garbage
+/// collection. Expressions that are younger than the last collection can only
+/// be in those parts of shadow memory, so minor collections don't need to scan
+/// the rest (see GarbageCollection.h). The thread-safe runtime doesn't collect
+/// garbage, so it doesn't mark cards either.
+class DirtyCards {
+public:
+  /// Record that an expression has been stored at the address, given the card
+  /// bits of its page.
+  void mark(uintptr_t address, uint8_t *cards) {
+    auto bit = uint8_t(1u << (pageOffset(address) / kCardSize));
+    if ((*cards & bit) != 0)
+      return;
+
+    if (*cards == 0)
+      pages_.push_back(pageStart(address));
+    *cards |= bit;
+  }
+
+  /// The pages with dirty cards, possibly with duplicates (if a page has been
+  /// released and shadowed again in the meantime).
+  const std::vector<uintptr_t> &pages() const { return pages_; }
+
+  /// Forget the dirty pages; the caller clears their card bits.
+  void clear() { pages_.clear(); }
+
+private:
+  std::vector<uintptr_t> pages_;
+};
+
+extern DirtyCards g_dirty_cards;
+
+#if defined(SYMCC_WORD_SHADOW) && defined(SYMCC_THREAD_SAFE)
+#error "The word-granular shadow isn't available in the thread-safe runtime"
+#endif
+
+#ifdef SYMCC_WORD_SHADOW
+constexpr bool kWordShadow = true;
+#else
+constexpr bool kWordShadow = false;
+#endif
+
+//
+// Word records. Most stores are aligned words, and most loads read them back
+// whole, so splitting every stored value into one extract per byte mostly
+// creates expressions that nobody needs. With SYMCC_WORD_SHADOW, an aligned
+// little-endian store of 2, 4 or 8 bytes puts the stored expression itself
+// into each shadow slot of the word, with the binary logarithm of the size in
+// the low bits of the pointer (which are clear because expressions are at
+// least 8-byte aligned). Byte expressions are built only when an access
+// doesn't match the word, and assigning to a single byte of a word splits the
+// word into bytes first. Hence, all slots of a word hold the same record.
+//
+
+constexpr uintptr_t kWordTagMask = 7;
+
+/// Check whether the shadow slot holds a word record.
+inline bool isWordSlot(SymExpr slot) {
+  return kWordShadow && (reinterpret_cast<uintptr_t>(slot) & kWordTagMask) != 0;
+}
+
+/// The size in bytes of the word in the slot.
+inline size_t wordSize(SymExpr slot) {
+  return size_t(1) << (reinterpret_cast<uintptr_t>(slot) & kWordTagMask);
+}
+
+/// The expression of the word in the slot.
+inline SymExpr wordExpression(SymExpr slot) {
+  return reinterpret_cast<SymExpr>(reinterpret_cast<uintptr_t>(slot) &
+                                   ~kWordTagMask);
+}
+
+/// The expression for the byte at the address, which is part of the word in
+/// the slot.
+inline SymExpr wordByte(SymExpr slot, uintptr_t address) {
+  size_t index = address & (wordSize(slot) - 1);
+  return _sym_extract_helper(wordExpression(slot), 8 * index + 7, 8 * index);
+}
+
+/// Check whether an access can use a word record.
+inline bool isWordAccess(uintptr_t address, size_t length, bool little_endian) {
+  return kWordShadow && little_endian &&
+         (length == 2 || length == 4 || length == 8) &&
+         (address & (length - 1)) == 0;
+}
+
+/// Replace the word record that the shadow of the address is part of with
+/// byte expressions.
+inline void splitWord(uintptr_t address, SymExpr *shadow, uint8_t *dirtyCards) {
+  auto slot = *shadow;
+  auto size = wordSize(slot);
+  auto *word = shadow - (address & (size - 1));
+  auto wordAddress = address & ~uintptr_t(size - 1);
+  for (size_t i = 0; i < size; i++)
+    word[i] = wordByte(slot, wordAddress + i);
+  g_dirty_cards.mark(address, dirtyCards);
+}
+
+/// Store an expression as a word record (see isWordAccess), or make the word
+/// concrete if the expression is null.
+void storeWord(uintptr_t address, size_t length, SymExpr expr);
+
+/// Return the expression of the word record of the given size at the address,
+/// or null if the shadow doesn't hold one (which doesn't mean that the memory
+/// is concrete).
+inline SymExpr loadWord(uintptr_t address, size_t length) {
+  auto *shadow = g_shadow_pages.find(pageStart(address));
+  if (shadow == nullptr)
+    return nullptr;
+
+  auto slot = shadow[pageOffset(address)];
+  if (!isWordSlot(slot) || wordSize(slot) != length)
+    return nullptr;
+  return wordExpression(slot);
+}
 
 /// An iterator that walks over the shadow bytes corresponding to a memory
 /// region. If there is no shadow for any given memory address, it just returns
@@ -93,10 +547,29 @@ public:
   }
 
   SymExpr operator*() {
-    assert((shadow_ == nullptr || *shadow_ == nullptr ||
-            _sym_bits_helper(*shadow_) == 8) &&
+    if (shadow_ == nullptr)
+      return nullptr;
+
+    if (isWordSlot(*shadow_))
+      return wordByte(*shadow_, address_);
+
+    assert((*shadow_ == nullptr || _sym_bits_helper(*shadow_) == 8) &&
            "Shadow memory always represents bytes");
-    return shadow_ != nullptr ? *shadow_ : nullptr;
+    return *shadow_;
+  }
+
+  /// If the byte is part of a word record, return the word's expression and
+  /// store the bits that correspond to the byte (in the way of
+  /// _sym_extract_source_helper); otherwise, return null. This saves building
+  /// the byte expression when the caller only wants to know where it comes
+  /// from.
+  SymExpr wordSource(size_t *first_bit, size_t *last_bit) const {
+    if (shadow_ == nullptr || !isWordSlot(*shadow_))
+      return nullptr;
+
+    *last_bit = 8 * (address_ & (wordSize(*shadow_) - 1));
+    *first_bit = *last_bit + 7;
+    return wordExpression(*shadow_);
   }
 
   bool operator==(const ReadShadowIterator &other) const {
@@ -109,9 +582,8 @@ public:
 
 protected:
   static SymExpr *getShadow(uintptr_t address) {
-    if (auto shadowPageIt = g_shadow_pages.find(pageStart(address));
-        shadowPageIt != g_shadow_pages.end())
-      return shadowPageIt->second + pageOffset(address);
+    if (auto *shadowPage = g_shadow_pages.find(pageStart(address)))
+      return shadowPage + pageOffset(address);
 
     return nullptr;
   }
@@ -135,20 +607,60 @@ public:
   }
 };
 
+/// A reference to the shadow of a byte that keeps the count of symbolic bytes
+/// and the dirty cards of the page up to date when it is assigned to.
+class ShadowByteReference {
+public:
+  ShadowByteReference(uintptr_t address, SymExpr *shadow,
+                      uint16_t *symbolicBytes, uint8_t *dirtyCards)
+      : address_(address), shadow_(shadow), symbolicBytes_(symbolicBytes),
+        dirtyCards_(dirtyCards) {}
+
+  ShadowByteReference &operator=(SymExpr expr) {
+    if (isWordSlot(*shadow_))
+      splitWord(address_, shadow_, dirtyCards_);
+
+    auto previous = exchangeShared(*shadow_, expr);
+    if ((expr != nullptr) != (previous != nullptr))
+      addShared(*symbolicBytes_, uint16_t(expr != nullptr ? 1 : -1));
+#ifndef SYMCC_THREAD_SAFE
+    if (expr != nullptr)
+      g_dirty_cards.mark(address_, dirtyCards_);
+#endif
+    return *this;
+  }
+
+  ShadowByteReference &operator=(const ShadowByteReference &other) {
+    return *this = static_cast<SymExpr>(other);
+  }
+
+  operator SymExpr() const {
+    return isWordSlot(*shadow_) ? wordByte(*shadow_, address_) : *shadow_;
+  }
+
+private:
+  uintptr_t address_;
+  SymExpr *shadow_;
+  uint16_t *symbolicBytes_;
+  uint8_t *dirtyCards_;
+};
+
 /// An iterator that walks over the shadow corresponding to a memory region and
 /// exposes it for modification. If there is no shadow yet, it creates a new
 /// one.
 class WriteShadowIterator : public ReadShadowIterator {
 public:
+  using reference = ShadowByteReference;
+
   WriteShadowIterator(uintptr_t address) : ReadShadowIterator(address) {
-    shadow_ = getOrCreateShadow(address);
+    enterPage();
   }
 
   WriteShadowIterator &operator++() {
     auto previousAddress = address_++;
     shadow_++;
     if (pageStart(address_) != pageStart(previousAddress))
-      shadow_ = getOrCreateShadow(address_);
+      enterPage();
     return *this;
   }
 
@@ -156,23 +668,28 @@ public:
     auto previousAddress = address_--;
     shadow_--;
     if (pageStart(address_) != pageStart(previousAddress))
-      shadow_ = getOrCreateShadow(address_);
+      enterPage();
     return *this;
   }
 
-  SymExpr &operator*() { return *shadow_; }
+  ShadowByteReference operator*() {
+    return {address_, shadow_, symbolicBytes_, dirtyCards_};
+  }
 
 protected:
-  static SymExpr *getOrCreateShadow(uintptr_t address) {
-    if (auto *shadow = getShadow(address))
-      return shadow;
-
-    auto *newShadow =
-        static_cast<SymExpr *>(malloc(kPageSize * sizeof(SymExpr)));
-    memset(newShadow, 0, kPageSize * sizeof(SymExpr));
-    g_shadow_pages[pageStart(address)] = newShadow;
-    return newShadow + pageOffset(address);
+  /// Look up the shadow of the current page, creating it if necessary.
+  void enterPage() {
+    auto page = g_shadow_pages.findPage(pageStart(address_));
+    if (page.shadow == nullptr)
+      page = g_shadow_pages.create(pageStart(address_));
+
+    shadow_ = page.shadow + pageOffset(address_);
+    symbolicBytes_ = page.symbolicBytes;
+    dirtyCards_ = page.dirtyCards;
   }
+
+  uint16_t *symbolicBytes_;
+  uint8_t *dirtyCards_;
 };
 
 /// A view on shadow memory that exposes read-only functionality.
@@ -213,15 +730,31 @@ template <typename T> struct ReadWriteShadow {
 /// Check whether the indicated memory range is concrete, i.e., there is no
 /// symbolic byte in the entire region.
 template <typename T> bool isConcrete(T *addr, size_t nbytes) {
-  // Fast path for allocations within one page.
-  auto byteBuf = reinterpret_cast<uintptr_t>(addr);
-  if (pageStart(byteBuf) == pageStart(byteBuf + nbytes) &&
-      !g_shadow_pages.count(pageStart(byteBuf)))
-    return true;
-
-  ReadOnlyShadow shadow(addr, nbytes);
-  return std::all_of(shadow.begin(), shadow.end(),
-                     [](SymExpr expr) { return (expr == nullptr); });
+  auto start = reinterpret_cast<uintptr_t>(addr);
+  auto end = start + nbytes;
+  for (auto page = pageStart(start); page < end; page += kPageSize) {
+    // Pages without shadow or without symbolic bytes don't need a closer
+    // look, and neither do pages that we cover completely.
+    auto shadowPage = g_shadow_pages.findPage(page);
+    if (shadowPage.shadow == nullptr)
+      continue;
+
+    auto symbolicBytes = loadShared(*shadowPage.symbolicBytes);
+    if (symbolicBytes == 0)
+      continue;
+
+    auto first = std::max(page, start);
+    auto last = std::min(page + kPageSize, end);
+    if (last - first == kPageSize || symbolicBytes == kPageSize)
+      return false;
+
+    auto *shadow = shadowPage.shadow + pageOffset(first);
+    if (!std::all_of(shadow, shadow + (last - first),
+                     [](SymExpr expr) { return (expr == nullptr); }))
+      return false;
+  }
+
+  return true;
 }
 
 #endif
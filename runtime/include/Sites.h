@@ -0,0 +1,42 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with the SymCC runtime. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SITES_H
+#define SITES_H
+
+#include <cstdint>
+
+/// What the runtime knows about a path-constraint site, taken from the site
+/// tables that instrumented modules register (see SymSiteTable in
+/// RuntimeCommon.h).
+struct SiteInfo {
+  /// The source file, or the empty string if unknown.
+  const char *file;
+  /// The line in the source file, or -1 if unknown.
+  int line;
+  unsigned column;
+  const char *module;
+  const char *function;
+  unsigned position;
+  uint8_t checkKind;
+  bool loop;
+};
+
+/// Find the metadata of a site. Tables are merged into the lookup structure
+/// lazily, so registering them at startup is cheap. Returns null for sites
+/// that no table describes, e.g., the ones that the libc wrappers use.
+const SiteInfo *findSite(uintptr_t siteId);
+
+#endif
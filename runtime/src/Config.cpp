@@ -38,6 +38,38 @@ bool checkFlagString(std::string value) {
   throw std::runtime_error(msg.str());
 }
 
+LogFormat parseLogFormat(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (value.empty() || value == "smt")
+    return LogFormat::Smt;
+
+  if (value == "delta")
+    return LogFormat::Delta;
+
+  if (value == "binary")
+    return LogFormat::Binary;
+
+  std::stringstream msg;
+  msg << "Unknown log format " << value;
+  throw std::runtime_error(msg.str());
+}
+
+size_t parseUnsigned(const char *value, const char *what) {
+  try {
+    return std::stoul(value);
+  } catch (std::invalid_argument &) {
+    std::stringstream msg;
+    msg << "Can't convert " << value << " to an integer";
+    throw std::runtime_error(msg.str());
+  } catch (std::out_of_range &) {
+    std::stringstream msg;
+    msg << what << " must be between 0 and "
+        << std::numeric_limits<size_t>::max();
+    throw std::runtime_error(msg.str());
+  }
+}
+
 } // namespace
 
 Config g_config;
@@ -68,6 +100,52 @@ void loadConfig() {
   if (logFile != nullptr)
     g_config.logFile = logFile;
 
+  auto *logFormat = getenv("SYMCC_LOG_FORMAT");
+  if (logFormat != nullptr)
+    g_config.logFormat = parseLogFormat(logFormat);
+
+  if (g_config.logFormat == LogFormat::Binary && g_config.logFile.empty())
+    throw std::runtime_error{"The binary log format requires a log file"};
+
+  auto *asyncLog = getenv("SYMCC_ASYNC_LOG");
+  if (asyncLog != nullptr)
+    g_config.asyncLog = checkFlagString(asyncLog);
+
+  auto *asyncLogDrop = getenv("SYMCC_ASYNC_LOG_DROP");
+  if (asyncLogDrop != nullptr)
+    g_config.asyncLogDropWhenFull = checkFlagString(asyncLogDrop);
+
+  auto *asyncLogBuffer = getenv("SYMCC_ASYNC_LOG_BUFFER");
+  if (asyncLogBuffer != nullptr)
+    g_config.asyncLogBufferSize =
+        parseUnsigned(asyncLogBuffer, "The asynchronous log's buffer size");
+
+  auto *siteBudget = getenv("SYMCC_SITE_BUDGET");
+  if (siteBudget != nullptr)
+    g_config.siteBudget = parseUnsigned(siteBudget, "The site budget");
+
+  auto *siteBudgetContext = getenv("SYMCC_SITE_BUDGET_CONTEXT");
+  if (siteBudgetContext != nullptr)
+    g_config.siteBudgetContext = checkFlagString(siteBudgetContext);
+
+  auto *keepPathPrefix = getenv("SYMCC_KEEP_PATH_PREFIX");
+  if (keepPathPrefix != nullptr)
+    g_config.keepPathPrefix = checkFlagString(keepPathPrefix);
+
+  auto *fullPathPrefix = getenv("SYMCC_FULL_PATH_PREFIX");
+  if (fullPathPrefix != nullptr)
+    g_config.fullPathPrefix = checkFlagString(fullPathPrefix);
+
+  auto *queryCache = getenv("SYMCC_QUERY_CACHE");
+  if (queryCache != nullptr)
+    g_config.queryCache = checkFlagString(queryCache);
+
+  auto *queryCacheFile = getenv("SYMCC_QUERY_CACHE_FILE");
+  if (queryCacheFile != nullptr && *queryCacheFile != '\0') {
+    g_config.queryCacheFile = queryCacheFile;
+    g_config.queryCache = true;
+  }
+
   auto *pruning = getenv("SYMCC_ENABLE_LINEARIZATION");
   if (pruning != nullptr)
     g_config.pruning = checkFlagString(pruning);
@@ -77,19 +155,25 @@ void loadConfig() {
     g_config.aflCoverageMap = aflCoverageMap;
 
   auto *garbageCollectionThreshold = getenv("SYMCC_GC_THRESHOLD");
-  if (garbageCollectionThreshold != nullptr) {
-    try {
-      g_config.garbageCollectionThreshold =
-          std::stoul(garbageCollectionThreshold);
-    } catch (std::invalid_argument &) {
-      std::stringstream msg;
-      msg << "Can't convert " << garbageCollectionThreshold << " to an integer";
-      throw std::runtime_error(msg.str());
-    } catch (std::out_of_range &) {
-      std::stringstream msg;
-      msg << "The GC threshold must be between 0 and "
-          << std::numeric_limits<size_t>::max();
-      throw std::runtime_error(msg.str());
-    }
-  }
+  if (garbageCollectionThreshold != nullptr)
+    g_config.garbageCollectionThreshold =
+        parseUnsigned(garbageCollectionThreshold, "The GC threshold");
+
+  auto *releaseConcreteShadow = getenv("SYMCC_RELEASE_CONCRETE_SHADOW");
+  if (releaseConcreteShadow != nullptr)
+    g_config.releaseConcreteShadow = checkFlagString(releaseConcreteShadow);
+
+  auto *solverThreads = getenv("SYMCC_SOLVER_THREADS");
+  if (solverThreads != nullptr)
+    g_config.solverThreads =
+        parseUnsigned(solverThreads, "The number of solver threads");
+
+  auto *solverQueueSize = getenv("SYMCC_SOLVER_QUEUE_SIZE");
+  if (solverQueueSize != nullptr)
+    g_config.solverQueueSize =
+        parseUnsigned(solverQueueSize, "The solver queue size");
+
+  auto *solverQueueDrop = getenv("SYMCC_SOLVER_QUEUE_DROP");
+  if (solverQueueDrop != nullptr)
+    g_config.solverQueueDropWhenFull = checkFlagString(solverQueueDrop);
 }
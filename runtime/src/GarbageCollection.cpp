@@ -15,36 +15,171 @@
 
 #include "GarbageCollection.h"
 
+#include <algorithm>
 #include <vector>
 
+#include <RuntimeCommon.h>
+
+#include <Concurrency.h>
+#include <Config.h>
 #include <Runtime.h>
 #include <Shadow.h>
 
 /// A list of memory regions that are known to contain symbolic expressions.
 std::vector<ExpressionRegion> expressionRegions;
+RuntimeMutex expressionRegionsMutex;
 
 void registerExpressionRegion(ExpressionRegion r) {
+  std::lock_guard<RuntimeMutex> lock(expressionRegionsMutex);
   expressionRegions.push_back(std::move(r));
 }
 
-std::set<SymExpr> collectReachableExpressions() {
-  std::set<SymExpr> reachableExpressions;
-  auto collectReachableExpressions = [&](ExpressionRegion r) {
-    auto *end = r.first + r.second;
-    for (SymExpr *expr_ptr = r.first; expr_ptr < end; expr_ptr++) {
-      if (*expr_ptr != nullptr) {
-        reachableExpressions.insert(*expr_ptr);
-      }
+namespace {
+
+/// The number of pointers that we check at once when looking for expressions;
+/// they fill a cache line, and the compiler can combine them with vector
+/// instructions.
+constexpr size_t kScanBlock = 8;
+
+/// Mark the expressions in the region, stopping early once we have seen the
+/// given number of them, and skipping blocks that don't contain any.
+void markRegion(ExpressionMarks &marks, size_t (*expressionId)(SymExpr),
+                const SymExpr *start, size_t length, size_t expected) {
+  size_t found = 0;
+  SymExpr previous = nullptr;
+  auto markBlock = [&](const SymExpr *block, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      auto *expr = block[i];
+      if (expr == nullptr)
+        continue;
+
+      found++;
+      // Neighboring entries often hold the same expression (e.g., after a
+      // memset, or in the slots of a word record), and looking up the ID may
+      // be comparatively expensive.
+      if (expr != previous)
+        marks.mark(
+            expressionId(isWordSlot(expr) ? wordExpression(expr) : expr));
+      previous = expr;
     }
   };
 
-  for (auto &r : expressionRegions) {
-    collectReachableExpressions(r);
+  size_t offset = 0;
+  for (; offset + kScanBlock <= length && found < expected;
+       offset += kScanBlock) {
+    uintptr_t any = 0;
+    for (size_t i = 0; i < kScanBlock; i++)
+      any |= reinterpret_cast<uintptr_t>(start[offset + i]);
+    if (any != 0)
+      markBlock(start + offset, kScanBlock);
   }
 
-  for (const auto &mapping : g_shadow_pages) {
-    collectReachableExpressions({mapping.second, kPageSize});
+  if (found < expected)
+    markBlock(start + offset, length - offset);
+}
+
+/// Mark the expressions on the dirty cards of the page, and clean the cards.
+void markDirtyCards(ExpressionMarks &marks, size_t (*expressionId)(SymExpr),
+                    uintptr_t pageAddress) {
+  auto page = g_shadow_pages.findPage(pageAddress);
+  // Released shadows have clean cards; the page may have been shadowed again
+  // since, in which case it is in the list twice.
+  if (page.shadow == nullptr || *page.dirtyCards == 0)
+    return;
+
+  auto cards = *page.dirtyCards;
+  *page.dirtyCards = 0;
+  if (*page.symbolicBytes == 0)
+    return;
+
+  for (unsigned card = 0; card < kCardsPerPage; card++) {
+    if ((cards >> card) & 1)
+      markRegion(marks, expressionId, page.shadow + card * kCardSize,
+                 kCardSize, kCardSize);
   }
+}
+
+GarbageCollectionStats g_gc_stats;
+GarbageCollectionStatsHandler g_gc_stats_handler = nullptr;
+
+/// The number of expressions at which we collect next, and the number of old
+/// expressions at which the collection is a full one (zero until the first
+/// collection, meaning the configured threshold).
+size_t g_next_collection = 0;
+size_t g_next_full_collection = 0;
+
+} // namespace
+
+CollectionKind scheduleGarbageCollection(size_t expressions, size_t young) {
+  auto nextCollection =
+      std::max(g_next_collection, g_config.garbageCollectionThreshold);
+  if (expressions < nextCollection)
+    return CollectionKind::None;
+
+  auto nextFullCollection =
+      std::max(g_next_full_collection, g_config.garbageCollectionThreshold);
+  return (expressions - young >= nextFullCollection) ? CollectionKind::Full
+                                                     : CollectionKind::Minor;
+}
+
+ExpressionMarks markReachableExpressions(size_t (*expressionId)(SymExpr),
+                                         CollectionKind kind) {
+  ExpressionMarks marks;
+
+  {
+    std::lock_guard<RuntimeMutex> lock(expressionRegionsMutex);
+    for (auto &r : expressionRegions)
+      markRegion(marks, expressionId, r.first, r.second, r.second);
+  }
+
+  for (auto page : g_dirty_cards.pages())
+    markDirtyCards(marks, expressionId, page);
+  g_dirty_cards.clear();
+
+  if (kind == CollectionKind::Full) {
+    // The count of symbolic bytes lets us skip concrete pages entirely and
+    // stop scanning the others as soon as we have seen all of their
+    // expressions.
+    g_shadow_pages.forEach([&](uintptr_t, ShadowPage page) {
+      if (auto symbolicBytes = loadShared(*page.symbolicBytes))
+        markRegion(marks, expressionId, page.shadow, kPageSize, symbolicBytes);
+    });
+  }
+
+  return marks;
+}
+
+void reportGarbageCollection(CollectionKind kind, size_t live,
+                             size_t reclaimed,
+                             std::chrono::steady_clock::duration pause) {
+  g_next_collection = 2 * live;
+  if (kind == CollectionKind::Full)
+    g_next_full_collection = 2 * live;
+
+  auto pauseNanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(pause).count();
+  g_gc_stats.collections++;
+  if (kind == CollectionKind::Full)
+    g_gc_stats.full_collections++;
+  g_gc_stats.live = live;
+  g_gc_stats.reclaimed = reclaimed;
+  g_gc_stats.total_reclaimed += reclaimed;
+  g_gc_stats.pause_ns = pauseNanoseconds;
+  g_gc_stats.total_pause_ns += pauseNanoseconds;
+
+  if (g_gc_stats_handler != nullptr)
+    g_gc_stats_handler(&g_gc_stats);
+}
+
+void symcc_set_gc_stats_handler(GarbageCollectionStatsHandler handler) {
+  g_gc_stats_handler = handler;
+}
+
+void symcc_collect_garbage() { _sym_collect_garbage(); }
+
+size_t releaseConcreteShadows() {
+  if (!g_config.releaseConcreteShadow)
+    return 0;
 
-  return reachableExpressions;
+  return g_shadow_pages.releaseConcretePages();
 }
@@ -30,6 +30,7 @@
 // function's result.
 
 #include <cassert>
+#include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -40,6 +41,7 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <malloc.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -92,6 +94,32 @@ void maybeSetInputFile(const char *path, int fd) {
   inputOffset = 0;
 }
 
+/// Make the memory region concrete because the program is done with it, and
+/// recycle the shadows of pages that don't contain symbolic data anymore.
+/// Otherwise, stale expressions would show up in the next allocation that
+/// reuses the memory, and they would keep shadows alive for the garbage
+/// collector to scan.
+void forgetMemory(uintptr_t start, size_t length) {
+  if (length == 0)
+    return;
+
+  auto *addr = reinterpret_cast<uint8_t *>(start);
+  if (!isConcrete(addr, length)) {
+    ReadWriteShadow shadow(addr, length);
+    std::fill(shadow.begin(), shadow.end(), nullptr);
+  }
+
+  for (auto page = pageStart(start); page < start + length; page += kPageSize)
+    g_shadow_pages.recycle(page);
+}
+
+/// Copy the shadow of memory that has moved to a new location. Like
+/// _sym_memcpy, but the source is an address that we must not dereference.
+void moveShadow(uintptr_t from, uintptr_t to, size_t length) {
+  std::copy(ReadShadowIterator(from), ReadShadowIterator(from + length),
+            WriteShadowIterator(to));
+}
+
 } // namespace
 
 void initLibcWrappers() {
@@ -122,6 +150,62 @@ void *SYM(calloc)(size_t nmemb, size_t size) {
   return result;
 }
 
+// After the call to realloc, we only need the old address for its shadow. GCC
+// warns about any use of the address, even as an integer.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuse-after-free"
+#endif
+
+void *SYM(realloc)(void *ptr, size_t size) {
+  // Usually, the old memory is concrete, and then there is no shadow to move
+  // or clear.
+  auto oldAddress = reinterpret_cast<uintptr_t>(ptr);
+  size_t oldSize = ptr != nullptr ? malloc_usable_size(ptr) : 0;
+  bool oldConcrete = isConcrete(ptr, oldSize);
+  auto *result = realloc(ptr, size);
+
+  tryAlternative(size, _sym_get_parameter_expression(1), SYM(realloc));
+
+  _sym_set_return_expression(nullptr);
+
+  if (oldConcrete)
+    return result;
+
+  if (result == nullptr) {
+    // A zero size frees the memory; otherwise, the call failed and the old
+    // memory is untouched.
+    if (size == 0)
+      forgetMemory(oldAddress, oldSize);
+    return result;
+  }
+
+  if (reinterpret_cast<uintptr_t>(result) != oldAddress) {
+    // The contents (and hence their expressions) moved.
+    moveShadow(oldAddress, reinterpret_cast<uintptr_t>(result),
+               std::min(oldSize, size));
+    forgetMemory(oldAddress, oldSize);
+  } else if (size < oldSize) {
+    forgetMemory(oldAddress + size, oldSize - size);
+  }
+
+  return result;
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic pop
+#endif
+
+void SYM(free)(void *ptr) {
+  if (ptr != nullptr)
+    forgetMemory(reinterpret_cast<uintptr_t>(ptr), malloc_usable_size(ptr));
+
+  free(ptr);
+
+  // No return value, hence no corresponding expression.
+  _sym_set_return_expression(nullptr);
+}
+
 // See comment on lseek and lseek64 below; the same applies to the "off"
 // parameter of mmap.
 
@@ -161,6 +245,54 @@ void *SYM(mmap)(void *addr, size_t len, int prot, int flags, int fildes,
   return SYM(mmap64)(addr, len, prot, flags, fildes, off);
 }
 
+int SYM(munmap)(void *addr, size_t len) {
+  auto result = munmap(addr, len);
+  _sym_set_return_expression(nullptr);
+
+  if (result == 0) {
+    // The kernel unmaps whole pages.
+    auto start = reinterpret_cast<uintptr_t>(addr);
+    forgetMemory(start, pageStart(start + len + kPageSize - 1) - start);
+  }
+
+  return result;
+}
+
+// Like libc's mremap, this is variadic: the new address is only passed (and
+// only valid) with MREMAP_FIXED.
+void *SYM(mremap)(void *oldAddress, size_t oldSize, size_t newSize, int flags,
+                  ...) {
+  void *result;
+  if (flags & MREMAP_FIXED) {
+    va_list args;
+    va_start(args, flags);
+    auto *newAddress = va_arg(args, void *);
+    va_end(args);
+    result = mremap(oldAddress, oldSize, newSize, flags, newAddress);
+  } else {
+    result = mremap(oldAddress, oldSize, newSize, flags);
+  }
+
+  tryAlternative(newSize, _sym_get_parameter_expression(2), SYM(mremap));
+
+  _sym_set_return_expression(nullptr);
+
+  if (result == MAP_FAILED)
+    return result;
+
+  auto oldStart = reinterpret_cast<uintptr_t>(oldAddress);
+  if (result != oldAddress) {
+    // The contents moved, and the old mapping is gone.
+    moveShadow(oldStart, reinterpret_cast<uintptr_t>(result),
+               std::min(oldSize, newSize));
+    forgetMemory(oldStart, oldSize);
+  } else if (newSize < oldSize) {
+    forgetMemory(oldStart + newSize, oldSize - newSize);
+  }
+
+  return result;
+}
+
 int SYM(open)(const char *path, int oflag, mode_t mode) {
   auto result = open(path, oflag, mode);
   _sym_set_return_expression(nullptr);
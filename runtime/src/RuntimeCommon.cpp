@@ -17,13 +17,14 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
-#include <numeric>
 #include <stdexcept>
 #include <variant>
 #include <iostream>
 
+#include "Concurrency.h"
 #include "Config.h"
 #include "GarbageCollection.h"
 #include "RuntimeCommon.h"
@@ -33,10 +34,11 @@ namespace {
 
 constexpr int kMaxFunctionArguments = 256;
 
-/// Global storage for function parameters and the return value.
-SymExpr g_return_value;
-std::array<SymExpr, kMaxFunctionArguments> g_function_arguments;
-// TODO make thread-local
+/// Storage for function parameters and the return value. Calls happen on the
+/// caller's thread, so each thread needs its own slots.
+SYMCC_THREAD_LOCAL SymExpr g_return_value;
+SYMCC_THREAD_LOCAL std::array<SymExpr, kMaxFunctionArguments>
+    g_function_arguments;
 
 SymExpr buildMinSignedInt(uint8_t bits) {
   return _sym_build_integer((uint64_t)(1) << (bits - 1), bits);
@@ -135,6 +137,12 @@ void _sym_memmove(uint8_t *dest, const uint8_t *src, size_t length) {
     std::copy(srcShadow.begin(), srcShadow.end(), destShadow.begin());
 }
 
+bool _sym_is_concrete_memory(const uint8_t *addr, size_t length) {
+  // Instrumented functions call this at entry to decide whether they can run
+  // their uninstrumented clone, so it mustn't create any shadow.
+  return isConcrete(addr, length);
+}
+
 SymExpr _sym_read_memory(uint8_t *addr, size_t length, bool little_endian) {
   assert(length && "Invalid query for zero-length memory region");
 
@@ -149,17 +157,77 @@ SymExpr _sym_read_memory(uint8_t *addr, size_t length, bool little_endian) {
   if (isConcrete(addr, length))
     return nullptr;
 
+  auto address = reinterpret_cast<uintptr_t>(addr);
+  if (isWordAccess(address, length, little_endian)) {
+    if (auto *word = loadWord(address, length))
+      return word;
+  }
+
+  // Stores split values into one extract per byte (except for word records,
+  // whose bytes we treat like extracts of the word). When neighboring bytes
+  // are consecutive slices of the same expression (typically because we read
+  // a value that was stored in one piece), we take the whole run with a
+  // single extract, or return the expression itself, instead of concatenating
+  // the bytes.
+  SymExpr result = nullptr;
+  auto append = [&](SymExpr piece) {
+    if (result == nullptr)
+      result = piece;
+    else
+      result = little_endian ? _sym_concat_helper(piece, result)
+                             : _sym_concat_helper(result, piece);
+  };
+
+  struct {
+    SymExpr source = nullptr;
+    // The expression of the first byte, unless we haven't built it.
+    SymExpr firstByte = nullptr;
+    size_t firstBit = 0, lastBit = 0;
+  } run;
+  auto finishRun = [&] {
+    if (run.source == nullptr)
+      return;
+
+    if (run.firstBit - run.lastBit == 7 && run.firstByte != nullptr)
+      append(run.firstByte);
+    else if (run.lastBit == 0 &&
+             run.firstBit + 1 == _sym_bits_helper(run.source))
+      append(run.source);
+    else
+      append(_sym_extract_helper(run.source, run.firstBit, run.lastBit));
+    run.source = nullptr;
+  };
+
   ReadOnlyShadow shadow(addr, length);
-  return std::accumulate(shadow.begin_non_null(), shadow.end_non_null(),
-                         static_cast<SymExpr>(nullptr),
-                         [&](SymExpr result, SymExpr byteExpr) {
-                           if (result == nullptr)
-                             return byteExpr;
+  for (auto it = shadow.begin_non_null(); it != shadow.end_non_null(); ++it) {
+    SymExpr byteExpr = nullptr;
+    size_t firstBit, lastBit;
+    auto *source = it.wordSource(&firstBit, &lastBit);
+    if (source == nullptr) {
+      byteExpr = *it;
+      source = _sym_extract_source_helper(byteExpr, &firstBit, &lastBit);
+    }
+    // In little-endian order, each byte continues the run upwards, otherwise
+    // downwards.
+    if (source != nullptr && source == run.source &&
+        (little_endian ? lastBit == run.firstBit + 1
+                       : firstBit + 1 == run.lastBit)) {
+      if (little_endian)
+        run.firstBit = firstBit;
+      else
+        run.lastBit = lastBit;
+      continue;
+    }
+
+    finishRun();
+    if (source != nullptr)
+      run = {source, byteExpr, firstBit, lastBit};
+    else
+      append(byteExpr);
+  }
+  finishRun();
 
-                           return little_endian
-                                      ? _sym_concat_helper(byteExpr, result)
-                                      : _sym_concat_helper(result, byteExpr);
-                         });
+  return result;
 }
 
 void _sym_write_memory(uint8_t *addr, size_t length, SymExpr expr,
@@ -175,18 +243,25 @@ void _sym_write_memory(uint8_t *addr, size_t length, SymExpr expr,
   if (expr == nullptr && isConcrete(addr, length))
     return;
 
+  auto address = reinterpret_cast<uintptr_t>(addr);
+  if (isWordAccess(address, length, little_endian)) {
+    storeWord(address, length, expr);
+    return;
+  }
+
   ReadWriteShadow shadow(addr, length);
   if (expr == nullptr) {
     std::fill(shadow.begin(), shadow.end(), nullptr);
   } else {
-    size_t i = 0;
-    for (SymExpr &byteShadow : shadow) {
-      byteShadow = little_endian
-                       ? _sym_extract_helper(expr, 8 * (i + 1) - 1, 8 * i)
-                       : _sym_extract_helper(expr, (length - i) * 8 - 1,
-                                             (length - i - 1) * 8);
+    std::generate(shadow.begin(), shadow.end(), [&, i = size_t(0)]() mutable {
+      auto byteExpr =
+          little_endian
+              ? _sym_extract_helper(expr, 8 * (i + 1) - 1, 8 * i)
+              : _sym_extract_helper(expr, (length - i) * 8 - 1,
+                                    (length - i - 1) * 8);
       i++;
-    }
+      return byteExpr;
+    });
   }
 }
 
@@ -195,28 +270,15 @@ SymExpr _sym_build_extract(SymExpr expr, uint64_t offset, uint64_t length,
   size_t totalBits = _sym_bits_helper(expr);
   assert((totalBits % 8 == 0) && "Aggregate type contains partial bytes");
 
-  SymExpr result;
-  if (little_endian) {
-    result = _sym_extract_helper(expr, totalBits - offset * 8 - 1,
-                                 totalBits - offset * 8 - 8);
-    for (size_t i = 1; i < length; i++) {
-      result = _sym_concat_helper(
-          _sym_extract_helper(expr, totalBits - (offset + i) * 8 - 1,
-                              totalBits - (offset + i + 1) * 8),
-          result);
-    }
-  } else {
-    result = _sym_extract_helper(expr, totalBits - offset * 8 - 1,
-                                 totalBits - (offset + length) * 8);
-  }
-
-  return result;
+  auto *result = _sym_extract_helper(expr, totalBits - offset * 8 - 1,
+                                     totalBits - (offset + length) * 8);
+  return (little_endian && length > 1) ? _sym_bswap_helper(result) : result;
 }
 
 SymExpr _sym_build_bswap(SymExpr expr) {
-  size_t bits = _sym_bits_helper(expr);
+  [[maybe_unused]] size_t bits = _sym_bits_helper(expr);
   assert((bits % 16 == 0) && "bswap is not applicable");
-  return _sym_build_extract(expr, 0, bits / 8, true);
+  return _sym_bswap_helper(expr);
 }
 
 SymExpr _sym_build_insert(SymExpr target, SymExpr to_insert, uint64_t offset,
@@ -251,17 +313,6 @@ SymExpr _sym_build_insert(SymExpr target, SymExpr to_insert, uint64_t offset,
   return result;
 }
 
-SymExpr _sym_build_zero_bytes(size_t length) {
-  auto zero_byte = _sym_build_integer(0, 8);
-
-  auto result = zero_byte;
-  for (size_t i = 1; i < length; i++) {
-    result = _sym_concat_helper(result, zero_byte);
-  }
-
-  return result;
-}
-
 SymExpr _sym_build_sadd_sat(SymExpr a, SymExpr b) {
   size_t bits = _sym_bits_helper(a);
   SymExpr min = buildMinSignedInt(bits);
@@ -457,6 +508,144 @@ SymExpr _sym_build_abs(SymExpr expr) {
       _sym_build_sub(_sym_build_integer(0, bits), expr));
 }
 
+namespace {
+
+/// The check kinds of the site table (see kCheckKinds in compiler/Sites.cpp).
+enum CheckKind : uint8_t {
+  kIntOverflow = 1,
+  kIntDividedByZero = 2,
+  kIntSignedValue = 3,
+  kIntUnsignedValue = 4,
+  kIntSignedMinusValue = 8,
+  kIntMaxValue = 9,
+  kIntMinValue = 10,
+  kIntSignedMaxValue = 11,
+  kIntSignedMinValue = 12,
+};
+
+} // namespace
+
+void _sym_check_arith(uint32_t kind_mask, SymExpr lhs, SymExpr rhs,
+                      SymExpr result, uint64_t lhs_value, uint64_t rhs_value,
+                      uint64_t result_value, int32_t threshold,
+                      int32_t tolerance, uintptr_t site_id) {
+  size_t bits = _sym_bits_helper(result);
+  assert(bits > 0 && bits <= 64 &&
+         "Arithmetic checks on integers wider than 64 bits");
+
+  // The concrete outcome of each check must agree with its predicate, so we
+  // evaluate them on the same bits. Shifting the operands to the top of a
+  // 64-bit integer turns overflow of N bits into overflow of 64 bits.
+  unsigned shift = 64 - bits;
+  uint64_t mask = ~uint64_t(0) >> shift;
+  lhs_value &= mask;
+  rhs_value &= mask;
+  result_value &= mask;
+  auto toSigned = [shift](uint64_t value) {
+    return static_cast<int64_t>(value << shift) >> shift;
+  };
+
+  auto push = [site_id](SymExpr constraint, bool taken, CheckKind kind) {
+    _sym_push_check_constraint(constraint, taken, site_id, kind);
+  };
+
+  if (kind_mask & SYMCC_CHECK_ADD_OVERFLOW) {
+    int64_t signedSum;
+    uint64_t unsignedSum;
+    bool taken =
+        __builtin_add_overflow(static_cast<int64_t>(lhs_value << shift),
+                               static_cast<int64_t>(rhs_value << shift),
+                               &signedSum) ||
+        __builtin_add_overflow(lhs_value << shift, rhs_value << shift,
+                               &unsignedSum);
+    push(_sym_build_bool_or(
+             _sym_build_not_equal(_sym_build_add(_sym_build_sext(lhs, 1),
+                                                 _sym_build_sext(rhs, 1)),
+                                  _sym_build_sext(result, 1)),
+             _sym_build_unsigned_less_than(result, lhs)),
+         taken, kIntOverflow);
+  }
+
+  if (kind_mask & SYMCC_CHECK_SUB_OVERFLOW) {
+    int64_t signedDifference;
+    bool taken =
+        __builtin_sub_overflow(static_cast<int64_t>(lhs_value << shift),
+                               static_cast<int64_t>(rhs_value << shift),
+                               &signedDifference) ||
+        lhs_value < rhs_value;
+    push(_sym_build_bool_or(
+             _sym_build_not_equal(_sym_build_sub(_sym_build_sext(lhs, 1),
+                                                 _sym_build_sext(rhs, 1)),
+                                  _sym_build_sext(result, 1)),
+             _sym_build_unsigned_less_than(lhs, rhs)),
+         taken, kIntOverflow);
+  }
+
+  if (kind_mask & SYMCC_CHECK_MUL_OVERFLOW) {
+    // Only one factor is shifted, so the product is shifted once as well.
+    int64_t signedProduct;
+    uint64_t unsignedProduct;
+    bool taken =
+        __builtin_mul_overflow(static_cast<int64_t>(lhs_value << shift),
+                               toSigned(rhs_value), &signedProduct) ||
+        __builtin_mul_overflow(lhs_value << shift, rhs_value, &unsignedProduct);
+    push(_sym_build_bool_or(
+             _sym_build_not_equal(_sym_build_mul(_sym_build_sext(lhs, bits),
+                                                 _sym_build_sext(rhs, bits)),
+                                  _sym_build_sext(result, bits)),
+             _sym_build_not_equal(_sym_build_mul(_sym_build_zext(lhs, bits),
+                                                 _sym_build_zext(rhs, bits)),
+                                  _sym_build_zext(result, bits))),
+         taken, kIntOverflow);
+  }
+
+  if (kind_mask & SYMCC_CHECK_DIVISION_BY_ZERO) {
+    push(_sym_build_equal(rhs, _sym_build_integer(0, bits)),
+         rhs_value == 0, kIntDividedByZero);
+  }
+
+  // The bounds are computed modulo 2^64 and then truncated, like constants of
+  // the operation's type in the compiler.
+  auto checkBound = [&](uint32_t check, CheckKind kind, bool isSigned,
+                        bool greater, uint64_t bound) {
+    if (!(kind_mask & check))
+      return;
+
+    bound &= mask;
+    bool taken;
+    SymExpr constraint;
+    auto boundExpr = _sym_build_integer(bound, bits);
+    if (isSigned) {
+      taken = greater ? toSigned(result_value) > toSigned(bound)
+                      : toSigned(result_value) < toSigned(bound);
+      constraint = greater ? _sym_build_signed_greater_than(result, boundExpr)
+                           : _sym_build_signed_less_than(result, boundExpr);
+    } else {
+      taken = greater ? result_value > bound : result_value < bound;
+      constraint = greater ? _sym_build_unsigned_greater_than(result, boundExpr)
+                           : _sym_build_unsigned_less_than(result, boundExpr);
+    }
+    push(constraint, taken, kind);
+  };
+
+  auto threshold64 = static_cast<uint64_t>(static_cast<int64_t>(threshold));
+  auto tolerance64 = static_cast<uint64_t>(static_cast<int64_t>(tolerance));
+  uint64_t signedMax = mask >> 1;
+  checkBound(SYMCC_CHECK_SIGNED_BOUND, kIntSignedValue, true, true,
+             threshold64);
+  checkBound(SYMCC_CHECK_UNSIGNED_BOUND, kIntUnsignedValue, false, true,
+             threshold64);
+  checkBound(SYMCC_CHECK_SIGNED_MINUS_BOUND, kIntSignedMinusValue, true, false,
+             -threshold64);
+  checkBound(SYMCC_CHECK_MAX_BOUND, kIntMaxValue, false, true,
+             mask - 1 - tolerance64);
+  checkBound(SYMCC_CHECK_MIN_BOUND, kIntMinValue, false, false, tolerance64);
+  checkBound(SYMCC_CHECK_SIGNED_MAX_BOUND, kIntSignedMaxValue, true, true,
+             signedMax - 1 - tolerance64);
+  checkBound(SYMCC_CHECK_SIGNED_MIN_BOUND, kIntSignedMinValue, true, false,
+             -signedMax + tolerance64);
+}
+
 void _sym_register_expression_region(SymExpr *start, size_t length) {
   registerExpressionRegion({start, length});
 }
@@ -499,9 +688,9 @@ void symcc_make_symbolic(const void *start, size_t byte_length) {
     throw std::runtime_error{"Calls to symcc_make_symbolic aren't allowed when "
                              "SYMCC_MEMORY_INPUT isn't set"};
 
-  static size_t inputOffset = 0; // track the offset across calls
-  _sym_make_symbolic(start, byte_length, inputOffset);
-  inputOffset += byte_length;
+  // Track the offset across calls (which may come from several threads).
+  static std::atomic<size_t> inputOffset = 0;
+  _sym_make_symbolic(start, byte_length, inputOffset.fetch_add(byte_length));
 }
 
 void symcc_make_symbolic_with_type(const void *start, size_t byte_length, 
@@ -510,9 +699,11 @@ void symcc_make_symbolic_with_type(const void *start, size_t byte_length,
     throw std::runtime_error{"Calls to symcc_make_symbolic aren't allowed when "
                              "SYMCC_MEMORY_INPUT isn't set"};
 
-  static size_t inputOffset = 0; // track the offset across calls
-  _sym_make_symbolic_with_type(start, byte_length, inputOffset, prefix, type_name);
-  inputOffset += byte_length;
+  // Track the offset across calls (which may come from several threads).
+  static std::atomic<size_t> inputOffset = 0;
+  _sym_make_symbolic_with_type(start, byte_length,
+                               inputOffset.fetch_add(byte_length), prefix,
+                               type_name);
 }
 
 void symcc_make_symbolic_with_prefix(const void *start, size_t byte_length, const char * prefix) {
@@ -520,9 +711,10 @@ void symcc_make_symbolic_with_prefix(const void *start, size_t byte_length, cons
     throw std::runtime_error{"Calls to symcc_make_symbolic aren't allowed when "
                              "SYMCC_MEMORY_INPUT isn't set"};
 
-  static size_t inputOffset = 0; // track the offset across calls
-  _sym_make_symbolic_with_prefix(start, byte_length, inputOffset, prefix);
-  inputOffset += byte_length;
+  // Track the offset across calls (which may come from several threads).
+  static std::atomic<size_t> inputOffset = 0;
+  _sym_make_symbolic_with_prefix(start, byte_length,
+                                 inputOffset.fetch_add(byte_length), prefix);
 }
 
 SymExpr _sym_build_bit_to_bool(SymExpr expr) {
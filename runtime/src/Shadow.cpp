@@ -15,4 +15,350 @@
 
 #include "Shadow.h"
 
-std::map<uintptr_t, SymExpr *> g_shadow_pages;
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/mman.h>
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SYMCC_ASAN 1
+#endif
+#elif defined(__SANITIZE_ADDRESS__)
+#define SYMCC_ASAN 1
+#endif
+
+#ifdef SYMCC_ASAN
+#include <sanitizer/lsan_interface.h>
+#endif
+
+ShadowPages g_shadow_pages;
+DirtyCards g_dirty_cards;
+
+namespace {
+
+/// Allocate zero-filled memory that is only committed when it is touched, and
+/// abort if that fails.
+void *allocateLazily(size_t bytes, const char *what) {
+  void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (memory == MAP_FAILED) {
+    perror(what);
+    abort();
+  }
+  return memory;
+}
+
+} // namespace
+
+void storeWord(uintptr_t address, size_t length, SymExpr expr) {
+  assert(isWordAccess(address, length, true) && "Not a word access");
+  assert((reinterpret_cast<uintptr_t>(expr) & kWordTagMask) == 0 &&
+         "Expressions must be aligned for word records");
+
+  auto page = g_shadow_pages.findPage(pageStart(address));
+  if (page.shadow == nullptr) {
+    if (expr == nullptr)
+      return;
+    page = g_shadow_pages.create(pageStart(address));
+  }
+
+  // A larger word that contains this one keeps its other bytes; smaller words
+  // are overwritten completely.
+  auto *shadow = page.shadow + pageOffset(address);
+  if (isWordSlot(*shadow) && wordSize(*shadow) > length)
+    splitWord(address, shadow, page.dirtyCards);
+
+  auto slot = expr == nullptr
+                  ? nullptr
+                  : reinterpret_cast<SymExpr>(
+                        reinterpret_cast<uintptr_t>(expr) |
+                        uintptr_t(__builtin_ctz(length)));
+  int delta = 0;
+  for (size_t i = 0; i < length; i++) {
+    if ((shadow[i] != nullptr) != (slot != nullptr))
+      delta += slot != nullptr ? 1 : -1;
+    shadow[i] = slot;
+  }
+
+  addShared(*page.symbolicBytes, uint16_t(delta));
+  if (slot != nullptr)
+    g_dirty_cards.mark(address, page.dirtyCards);
+}
+
+ShadowPage ShadowPageDirectory::create(uintptr_t page) {
+  assert(pageOffset(page) == 0 && "Shadows are per page");
+  auto pageNumber = page / kPageSize;
+  if (pageNumber >= kNumPages)
+    return createHigh(page);
+
+  auto *leaf = getOrCreateLeaf(pageNumber >> kLeafBits);
+  auto index = pageNumber & (kLeafSize - 1);
+
+  std::lock_guard<RuntimeMutex> lock(
+      createMutexes_[pageNumber % kCreateStripes]);
+  if (auto *existing = loadShared(leaf->shadows[index]))
+    return {existing, &leaf->symbolicBytes[index], &leaf->dirtyCards[index]};
+
+  // Shadows only leave the directory when they have no symbolic bytes, so the
+  // count is zero already, and so are the cards.
+  auto *shadow = allocateShadow();
+  storeShared(leaf->shadows[index], shadow);
+  addShared(size_, size_t(1));
+  return {shadow, &leaf->symbolicBytes[index], &leaf->dirtyCards[index]};
+}
+
+ShadowPage ShadowPageDirectory::createHigh(uintptr_t page) {
+  std::lock_guard<RuntimeMutex> lock(highPagesMutex_);
+  auto &highPage = highPages_[page];
+  if (highPage.shadow == nullptr) {
+    highPage = {allocateShadow(), 0, 0};
+    addShared(size_, size_t(1));
+  }
+  return {highPage.shadow, &highPage.symbolicBytes, &highPage.dirtyCards};
+}
+
+ShadowPageDirectory::Leaf *
+ShadowPageDirectory::getOrCreateLeaf(size_t directoryIndex) {
+  if (auto *leaf = loadShared(directory_[directoryIndex]))
+    return leaf;
+
+  std::lock_guard<RuntimeMutex> lock(leafMutex_);
+  if (auto *leaf = loadShared(directory_[directoryIndex]))
+    return leaf;
+
+  // Anonymous mappings are zero-filled and only use memory once they are
+  // touched, so sparse leaves are cheap.
+  void *memory = allocateLazily(
+      sizeof(Leaf), "Failed to allocate a shadow page directory leaf");
+#ifdef SYMCC_ASAN
+  // The leaves hold the only pointers to the shadows, but LeakSanitizer
+  // doesn't scan mappings on its own.
+  __lsan_register_root_region(memory, sizeof(Leaf));
+#endif
+  auto *leaf = static_cast<Leaf *>(memory);
+  leaves_.push_back(directoryIndex);
+  storeShared(directory_[directoryIndex], leaf);
+  return leaf;
+}
+
+SymExpr *ShadowPageDirectory::allocateShadow() {
+  // The pool is only filled by the single-threaded runtime (see recycle).
+  if (pooled_ > 0)
+    return pool_[--pooled_];
+
+  return static_cast<SymExpr *>(calloc(kPageSize, sizeof(SymExpr)));
+}
+
+size_t ShadowPageDirectory::releaseConcretePages() {
+#ifdef SYMCC_THREAD_SAFE
+  return 0;
+#else
+  size_t released = 0;
+  for (auto directoryIndex : leaves_) {
+    auto *leaf = directory_[directoryIndex];
+    for (size_t i = 0; i < kLeafSize; i++) {
+      if (leaf->shadows[i] != nullptr && leaf->symbolicBytes[i] == 0) {
+        pool(leaf->shadows[i]);
+        leaf->shadows[i] = nullptr;
+        leaf->dirtyCards[i] = 0;
+        released++;
+      }
+    }
+  }
+
+  for (auto it = highPages_.begin(); it != highPages_.end();) {
+    if (it->second.symbolicBytes == 0) {
+      pool(it->second.shadow);
+      it = highPages_.erase(it);
+      released++;
+    } else {
+      ++it;
+    }
+  }
+
+  size_ -= released;
+  return released;
+#endif
+}
+
+void ShadowPageDirectory::recycle([[maybe_unused]] uintptr_t page) {
+#ifndef SYMCC_THREAD_SAFE
+  auto pageNumber = page / kPageSize;
+  if (pageNumber >= kNumPages) {
+    auto it = highPages_.find(page);
+    if (it == highPages_.end() || it->second.symbolicBytes != 0)
+      return;
+
+    pool(it->second.shadow);
+    highPages_.erase(it);
+    size_--;
+    return;
+  }
+
+  auto *leaf = directory_[pageNumber >> kLeafBits];
+  if (leaf == nullptr)
+    return;
+
+  auto index = pageNumber & (kLeafSize - 1);
+  if (leaf->shadows[index] == nullptr || leaf->symbolicBytes[index] != 0)
+    return;
+
+  pool(leaf->shadows[index]);
+  leaf->shadows[index] = nullptr;
+  leaf->dirtyCards[index] = 0;
+  size_--;
+#endif
+}
+
+void ShadowPageDirectory::pool(SymExpr *shadow) {
+  if (pooled_ < kPoolSize)
+    pool_[pooled_++] = shadow;
+  else
+    free(shadow);
+}
+
+ShadowPage ShadowPageDirectory::findHigh(uintptr_t page) {
+  std::lock_guard<RuntimeMutex> lock(highPagesMutex_);
+  auto it = highPages_.find(page);
+  if (it == highPages_.end())
+    return {nullptr, nullptr, nullptr};
+
+  return {it->second.shadow, &it->second.symbolicBytes,
+          &it->second.dirtyCards};
+}
+
+#ifdef SYMCC_HAVE_DIRECT_SHADOW
+
+// Not defined by older C libraries.
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+ShadowPage DirectShadowMap::create(uintptr_t page) {
+  assert(pageOffset(page) == 0 && "Shadows are per page");
+  auto index = pageIndex(page);
+  if (index == kNoIndex) {
+    std::lock_guard<RuntimeMutex> lock(outsidePagesMutex_);
+    auto &outsidePage = outsidePages_[page];
+    if (outsidePage.shadow == nullptr)
+      outsidePage = {static_cast<SymExpr *>(allocateLazily(
+                         kPageSize * sizeof(SymExpr),
+                         "Failed to allocate a shadow page")),
+                     0, 0};
+    return {outsidePage.shadow, &outsidePage.symbolicBytes,
+            &outsidePage.dirtyCards};
+  }
+
+  auto *bitmap = loadShared(bitmap_);
+  if (bitmap == nullptr)
+    bitmap = reserve();
+
+  // The shadow slot is there already; we just mark it as used. Released
+  // shadows have no symbolic bytes, so the count and the cards are zero.
+  auto bit = uint64_t(1) << (index % 64);
+  if ((fetchOrShared(bitmap[index / 64], bit) & bit) == 0) {
+    std::lock_guard<RuntimeMutex> lock(pagesMutex_);
+    pages_.push_back(static_cast<uint32_t>(index));
+  }
+  return {shadowOf(index), &symbolicBytes_[index], &dirtyCards_[index]};
+}
+
+size_t DirectShadowMap::releaseConcretePages() {
+#ifdef SYMCC_THREAD_SAFE
+  return 0;
+#else
+  auto kept = std::remove_if(pages_.begin(), pages_.end(), [&](uint32_t index) {
+    if (symbolicBytes_[index] != 0)
+      return false;
+
+    // The shadow is all null already, so the kernel's zero pages can take its
+    // place.
+    madvise(shadowOf(index), kPageSize * sizeof(SymExpr), MADV_DONTNEED);
+    bitmap_[index / 64] &= ~(uint64_t(1) << (index % 64));
+    dirtyCards_[index] = 0;
+    return true;
+  });
+  size_t released = pages_.end() - kept;
+  pages_.erase(kept, pages_.end());
+
+  for (auto it = outsidePages_.begin(); it != outsidePages_.end();) {
+    if (it->second.symbolicBytes == 0) {
+      munmap(it->second.shadow, kPageSize * sizeof(SymExpr));
+      it = outsidePages_.erase(it);
+      released++;
+    } else {
+      ++it;
+    }
+  }
+
+  return released;
+#endif
+}
+
+uintptr_t DirectShadowMap::addressOf(size_t index) {
+  for (const auto &range : kRanges) {
+    if (index < range.size / kPageSize)
+      return range.start + index * kPageSize;
+    index -= range.size / kPageSize;
+  }
+
+  assert(false && "Invalid shadow index");
+  return 0;
+}
+
+ShadowPage DirectShadowMap::findOutside(uintptr_t page) {
+  std::lock_guard<RuntimeMutex> lock(outsidePagesMutex_);
+  auto it = outsidePages_.find(page);
+  if (it == outsidePages_.end())
+    return {nullptr, nullptr, nullptr};
+
+  return {it->second.shadow, &it->second.symbolicBytes,
+          &it->second.dirtyCards};
+}
+
+void DirectShadowMap::recycleOutside(uintptr_t page) {
+  auto it = outsidePages_.find(page);
+  if (it == outsidePages_.end() || it->second.symbolicBytes != 0)
+    return;
+
+  munmap(it->second.shadow, kPageSize * sizeof(SymExpr));
+  outsidePages_.erase(it);
+}
+
+uint64_t *DirectShadowMap::reserve() {
+  std::lock_guard<RuntimeMutex> lock(reserveMutex_);
+  if (auto *bitmap = loadShared(bitmap_))
+    return bitmap;
+
+  // The region is far larger than physical memory, so we rely on the kernel
+  // to only commit the pages that we touch. MAP_FIXED_NOREPLACE fails instead
+  // of clobbering an existing mapping; older kernels treat it as a hint, so
+  // we check the address as well.
+  void *shadow = mmap(reinterpret_cast<void *>(kShadowBase), kShadowSize,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                          MAP_FIXED_NOREPLACE,
+                      -1, 0);
+  if (shadow != reinterpret_cast<void *>(kShadowBase)) {
+    if (shadow == MAP_FAILED)
+      perror("Failed to reserve the shadow region");
+    else
+      fprintf(stderr, "Failed to reserve the shadow region at %p\n",
+              reinterpret_cast<void *>(kShadowBase));
+    abort();
+  }
+
+  symbolicBytes_ = static_cast<uint16_t *>(
+      allocateLazily(kNumPages * sizeof(uint16_t),
+                     "Failed to allocate the shadow page counts"));
+  dirtyCards_ = static_cast<uint8_t *>(allocateLazily(
+      kNumPages, "Failed to allocate the shadow page cards"));
+  auto *bitmap = static_cast<uint64_t *>(
+      allocateLazily(kNumPages / 8, "Failed to allocate the shadow bitmap"));
+  storeShared(bitmap_, bitmap);
+  return bitmap;
+}
+
+#endif
@@ -0,0 +1,113 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "Sites.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <Concurrency.h>
+#include <Runtime.h>
+#include <RuntimeCommon.h>
+
+namespace {
+
+struct SiteRegistry {
+  /// The tables that have been registered since the last lookup.
+  std::vector<const SymSiteTable *> pending;
+
+  std::unordered_map<uint64_t, SiteInfo> sites;
+
+  RuntimeMutex mutex;
+
+  void merge(const SymSiteTable *table) {
+    if (table->version != SYMCC_SITE_TABLE_VERSION) {
+      fprintf(stderr,
+              "Warning: ignoring a site table of unknown version %u (the "
+              "program and the runtime don't match)\n",
+              table->version);
+      return;
+    }
+
+    auto *records = reinterpret_cast<const SymSite *>(table + 1);
+    auto *strings = reinterpret_cast<const char *>(records + table->num_sites);
+    auto *module = strings + table->module;
+    sites.reserve(sites.size() + table->num_sites);
+    for (uint32_t i = 0; i < table->num_sites; i++) {
+      const auto &record = records[i];
+      SiteInfo info{strings + record.file,
+                    record.line,
+                    record.column,
+                    module,
+                    strings + record.function,
+                    record.position,
+                    record.check_kind,
+                    (record.flags & SYMCC_SITE_LOOP) != 0};
+      auto [it, inserted] = sites.emplace(record.site_id, info);
+      if (!inserted && !sameSite(it->second, info))
+        reportCollision(record.site_id, it->second, info);
+    }
+  }
+
+  /// Whether two records describe the same site, e.g., because the same
+  /// module is linked into the program and into a library.
+  static bool sameSite(const SiteInfo &a, const SiteInfo &b) {
+    return a.position == b.position && strcmp(a.module, b.module) == 0 &&
+           strcmp(a.function, b.function) == 0;
+  }
+
+  static void reportCollision(uint64_t siteId, const SiteInfo &first,
+                              const SiteInfo &second) {
+    fprintf(stderr,
+            "Warning: site ID %016" PRIx64 " describes both %s:%s+%u and "
+            "%s:%s+%u; queries from the latter are attributed to the former "
+            "(see util/site_map.py)\n",
+            siteId, first.module, first.function, first.position,
+            second.module, second.function, second.position);
+  }
+};
+
+/// Modules register their tables from constructors, which may run before the
+/// runtime's global objects are initialized; a function-local static is
+/// constructed on first use.
+SiteRegistry &registry() {
+  static SiteRegistry instance;
+  return instance;
+}
+
+} // namespace
+
+void _sym_register_sites(const SymSiteTable *table) {
+  auto &reg = registry();
+  std::lock_guard<RuntimeMutex> lock(reg.mutex);
+  reg.pending.push_back(table);
+}
+
+const SiteInfo *findSite(uintptr_t siteId) {
+  auto &reg = registry();
+  std::lock_guard<RuntimeMutex> lock(reg.mutex);
+  if (!reg.pending.empty()) {
+    for (auto *table : reg.pending)
+      reg.merge(table);
+    reg.pending.clear();
+  }
+
+  auto it = reg.sites.find(siteId);
+  return it != reg.sites.end() ? &it->second : nullptr;
+}
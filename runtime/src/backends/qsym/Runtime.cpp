@@ -29,13 +29,16 @@
 #error "We need either <filesystem> or the older <experimental/filesystem>."
 #endif
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <iterator>
-#include <map>
+#include <memory>
 #include <unordered_set>
 #include <variant>
+#include <vector>
 
 #if HAVE_FILESYSTEM
 #include <filesystem>
@@ -43,10 +46,6 @@
 #include <experimental/filesystem>
 #endif
 
-#ifdef DEBUG_RUNTIME
-#include <chrono>
-#endif
-
 // C
 #include <cstdint>
 #include <cstdio>
@@ -80,27 +79,85 @@ namespace {
 /// Indicate whether the runtime has been initialized.
 std::atomic_flag g_initialized = ATOMIC_FLAG_INIT;
 
-/// A mapping of all expressions that we have ever received from QSYM to the
-/// corresponding shared pointers on the heap.
-///
-/// We can't expect C clients to handle std::shared_ptr, so we maintain a single
-/// copy per expression in order to keep the expression alive. The garbage
-/// collector decides when to release our shared pointer.
+/// The handles of all expressions that we have passed to client code.
 ///
-/// std::map seems to perform slightly better than std::unordered_map on our
-/// workload.
-std::map<SymExpr, qsym::ExprRef> allocatedExpressions;
+/// We can't expect C clients to handle std::shared_ptr, so each handle holds a
+/// copy that keeps the expression alive until the garbage collector releases
+/// the handle. Handles live in chunks that never move, so pointers to them
+/// remain valid, and released handles are reused. Looking up an operand is
+/// thus a single memory access, and the garbage collector sweeps the table
+/// linearly (using the indices of the handles as their IDs).
+class HandleTable {
+public:
+  /// Return a new handle for the expression.
+  SymExpr allocate(const qsym::ExprRef &expr) {
+    SymExpr handle;
+    if (!free_.empty()) {
+      handle = free_.back();
+      free_.pop_back();
+    } else {
+      if (capacity_ % kChunkSize == 0)
+        chunks_.push_back(std::make_unique<ExprHandle[]>(kChunkSize));
+      handle = &chunks_.back()[capacity_ % kChunkSize];
+      handle->index = capacity_++;
+    }
 
-SymExpr registerExpression(const qsym::ExprRef &expr) {
-  SymExpr rawExpr = expr.get();
+    handle->expr = expr;
+    live_++;
+    return handle;
+  }
+
+  /// Drop the handle's reference and keep the handle for reuse.
+  void release(SymExpr handle) {
+    handle->expr.reset();
+    free_.push_back(handle);
+    live_--;
+  }
 
-  if (allocatedExpressions.count(rawExpr) == 0) {
-    // We don't know this expression yet. Create a copy of the shared pointer to
-    // keep the expression alive.
-    allocatedExpressions[rawExpr] = expr;
+  /// The handle with the given index, which may be released.
+  SymExpr at(size_t index) {
+    return &chunks_[index / kChunkSize][index % kChunkSize];
   }
 
-  return rawExpr;
+  /// The number of handles in use.
+  size_t size() const { return live_; }
+
+  /// The number of handles that we have ever allocated, i.e., the bound of
+  /// the indices.
+  size_t capacity() const { return capacity_; }
+
+private:
+  static constexpr size_t kChunkSize = 4096;
+
+  std::vector<std::unique_ptr<ExprHandle[]>> chunks_;
+  std::vector<SymExpr> free_;
+  size_t capacity_ = 0;
+  size_t live_ = 0;
+};
+
+HandleTable allocatedExpressions;
+
+/// The handles that we have allocated since the last garbage collection.
+std::vector<SymExpr> youngExpressions;
+
+/// Recently allocated handles by expression. QSYM's expression builder often
+/// returns the same expression for repeated requests (e.g., constants or the
+/// same computation in a loop), which would otherwise use up a new handle
+/// each time. Entries may refer to released or reused handles, so we check
+/// the expression on lookup.
+constexpr size_t kRecentHandles = 1024;
+SymExpr recentHandles[kRecentHandles];
+
+SymExpr registerExpression(const qsym::ExprRef &expr) {
+  auto &recent = recentHandles[(reinterpret_cast<uintptr_t>(expr.get()) >> 4) %
+                               kRecentHandles];
+  if (recent != nullptr && recent->expr == expr)
+    return recent;
+
+  auto *handle = allocatedExpressions.allocate(expr);
+  youngExpressions.push_back(handle);
+  recent = handle;
+  return handle;
 }
 
 /// The user-provided test case handler, if any.
@@ -217,6 +274,13 @@ SymExpr _sym_build_integer128(uint64_t high, uint64_t low) {
   return registerExpression(g_expr_builder->createConstant({128, words}, 128));
 }
 
+SymExpr _sym_build_zero_bytes(size_t length) {
+  // There are no empty bit vectors, so zero-length requests (e.g., for
+  // undefined empty structs) get a single byte.
+  unsigned bits = 8 * std::max<size_t>(length, 1);
+  return registerExpression(g_expr_builder->createConstant({bits, 0}, bits));
+}
+
 SymExpr _sym_build_integer_from_buffer(void *buffer, unsigned num_bits) {
   assert(num_bits % 64 == 0);
   return registerExpression(g_expr_builder->createConstant(
@@ -242,8 +306,8 @@ SymExpr _sym_build_bool(bool value) {
 
 #define DEF_BINARY_EXPR_BUILDER(name, qsymName)                                \
   SymExpr _sym_build_##name(SymExpr a, SymExpr b) {                            \
-    return registerExpression(g_expr_builder->create##qsymName(                \
-        allocatedExpressions.at(a), allocatedExpressions.at(b)));              \
+    return registerExpression(                                                 \
+        g_expr_builder->create##qsymName(a->expr, b->expr));                   \
   }
 
 DEF_BINARY_EXPR_BUILDER(add, Add)
@@ -279,43 +343,39 @@ DEF_BINARY_EXPR_BUILDER(xor, Xor)
 #undef DEF_BINARY_EXPR_BUILDER
 
 SymExpr _sym_build_neg(SymExpr expr) {
-  return registerExpression(
-      g_expr_builder->createNeg(allocatedExpressions.at(expr)));
+  return registerExpression(g_expr_builder->createNeg(expr->expr));
 }
 
 SymExpr _sym_build_not(SymExpr expr) {
-  return registerExpression(
-      g_expr_builder->createNot(allocatedExpressions.at(expr)));
+  return registerExpression(g_expr_builder->createNot(expr->expr));
 }
 
 SymExpr _sym_build_ite(SymExpr cond, SymExpr a, SymExpr b) {
-  return registerExpression(g_expr_builder->createIte(
-      allocatedExpressions.at(cond), allocatedExpressions.at(a),
-      allocatedExpressions.at(b)));
+  return registerExpression(
+      g_expr_builder->createIte(cond->expr, a->expr, b->expr));
 }
 
 SymExpr _sym_build_sext(SymExpr expr, uint8_t bits) {
   if (expr == nullptr)
     return nullptr;
 
-  return registerExpression(g_expr_builder->createSExt(
-      allocatedExpressions.at(expr), bits + expr->bits()));
+  return registerExpression(
+      g_expr_builder->createSExt(expr->expr, bits + expr->expr->bits()));
 }
 
 SymExpr _sym_build_zext(SymExpr expr, uint8_t bits) {
   if (expr == nullptr)
     return nullptr;
 
-  return registerExpression(g_expr_builder->createZExt(
-      allocatedExpressions.at(expr), bits + expr->bits()));
+  return registerExpression(
+      g_expr_builder->createZExt(expr->expr, bits + expr->expr->bits()));
 }
 
 SymExpr _sym_build_trunc(SymExpr expr, uint8_t bits) {
   if (expr == nullptr)
     return nullptr;
 
-  return registerExpression(
-      g_expr_builder->createTrunc(allocatedExpressions.at(expr), bits));
+  return registerExpression(g_expr_builder->createTrunc(expr->expr, bits));
 }
 
 void _sym_push_path_constraint(SymExpr constraint, int taken,
@@ -323,7 +383,13 @@ void _sym_push_path_constraint(SymExpr constraint, int taken,
   if (constraint == nullptr)
     return;
 
-  g_solver->addJcc(allocatedExpressions.at(constraint), taken != 0, site_id);
+  g_solver->addJcc(constraint->expr, taken != 0, site_id);
+}
+
+void _sym_push_check_constraint(SymExpr constraint, int taken,
+                                uintptr_t site_id, uint8_t check_kind) {
+  // QSYM tracks its branch coverage by site, so each check gets its own.
+  _sym_push_path_constraint(constraint, taken, site_id + check_kind);
 }
 
 SymExpr _sym_get_input_byte(size_t offset, uint8_t value) {
@@ -337,23 +403,55 @@ SymExpr _sym_get_input_byte_with_prefix(const char * prefix, size_t offset, uint
 }
 
 SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
-  return registerExpression(g_expr_builder->createConcat(
-      allocatedExpressions.at(a), allocatedExpressions.at(b)));
+  return registerExpression(g_expr_builder->createConcat(a->expr, b->expr));
 }
 
 SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit) {
   return registerExpression(g_expr_builder->createExtract(
-      allocatedExpressions.at(expr), last_bit, first_bit - last_bit + 1));
+      expr->expr, last_bit, first_bit - last_bit + 1));
+}
+
+size_t _sym_bits_helper(SymExpr expr) { return expr->expr->bits(); }
+
+SymExpr _sym_extract_source_helper(SymExpr expr, size_t *first_bit,
+                                   size_t *last_bit) {
+  if (expr->expr->kind() != Extract)
+    return nullptr;
+
+  auto *extract = static_cast<ExtractExpr *>(expr->expr.get());
+  *last_bit = extract->index();
+  *first_bit = extract->index() + extract->bits() - 1;
+  return registerExpression(extract->getChild(0));
 }
 
-size_t _sym_bits_helper(SymExpr expr) { return expr->bits(); }
+SymExpr _sym_bswap_helper(SymExpr expr) {
+  auto bits = expr->expr->bits();
+  if (bits == 8)
+    return expr;
+
+  // Take the bytes of an extract from its argument, so that we don't nest
+  // extracts.
+  auto source = expr->expr;
+  size_t low = 0;
+  if (source->kind() == Extract) {
+    auto *extract = static_cast<ExtractExpr *>(source.get());
+    low = extract->index();
+    source = extract->getChild(0);
+  }
+
+  // Only the result needs a handle.
+  auto result = g_expr_builder->createExtract(source, low, 8);
+  for (size_t i = 8; i < bits; i += 8)
+    result = g_expr_builder->createConcat(
+        result, g_expr_builder->createExtract(source, low + i, 8));
+  return registerExpression(result);
+}
 
 SymExpr _sym_build_bool_to_bit(SymExpr expr) {
   if (expr == nullptr)
     return nullptr;
 
-  return registerExpression(
-      g_expr_builder->boolToBit(allocatedExpressions.at(expr), 1));
+  return registerExpression(g_expr_builder->boolToBit(expr->expr, 1));
 }
 
 //
@@ -432,7 +530,7 @@ void _sym_notify_basic_block(uintptr_t site_id) {
 const char *_sym_expr_to_string(SymExpr expr) {
   static char buffer[4096];
 
-  auto expr_string = expr->toString();
+  auto expr_string = expr->expr->toString();
   auto copied = expr_string.copy(
       buffer, std::min(expr_string.length(), sizeof(buffer) - 1));
   buffer[copied] = '\0';
@@ -441,10 +539,10 @@ const char *_sym_expr_to_string(SymExpr expr) {
 }
 
 bool _sym_feasible(SymExpr expr) {
-  expr->simplify();
+  expr->expr->simplify();
 
   g_solver->push();
-  g_solver->add(expr->toZ3Expr());
+  g_solver->add(expr->expr->toZ3Expr());
   bool feasible = (g_solver->check() == z3::sat);
   g_solver->pop();
 
@@ -456,31 +554,44 @@ bool _sym_feasible(SymExpr expr) {
 //
 
 void _sym_collect_garbage() {
-  if (allocatedExpressions.size() < g_config.garbageCollectionThreshold)
+  auto kind = scheduleGarbageCollection(allocatedExpressions.size(),
+                                        youngExpressions.size());
+  if (kind == CollectionKind::None)
     return;
 
-#ifdef DEBUG_RUNTIME
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-
-  auto reachableExpressions = collectReachableExpressions();
-  for (auto expr_it = allocatedExpressions.begin();
-       expr_it != allocatedExpressions.end();) {
-    if (reachableExpressions.count(expr_it->first) == 0) {
-      expr_it = allocatedExpressions.erase(expr_it);
-    } else {
-      ++expr_it;
+  auto start = std::chrono::steady_clock::now();
+
+  releaseConcreteShadows();
+  auto reachableExpressions = markReachableExpressions(
+      [](SymExpr expr) -> size_t { return expr->index; }, kind);
+  size_t reclaimed = 0;
+  auto sweep = [&](SymExpr handle) {
+    if (handle->expr != nullptr &&
+        !reachableExpressions.isMarked(handle->index)) {
+      allocatedExpressions.release(handle);
+      reclaimed++;
     }
+  };
+
+  if (kind == CollectionKind::Full) {
+    for (size_t i = 0; i < allocatedExpressions.capacity(); i++)
+      sweep(allocatedExpressions.at(i));
+  } else {
+    for (auto *handle : youngExpressions)
+      sweep(handle);
   }
+  youngExpressions.clear();
 
-#ifdef DEBUG_RUNTIME
-  auto end = std::chrono::high_resolution_clock::now();
+  auto pause = std::chrono::steady_clock::now() - start;
+  reportGarbageCollection(kind, allocatedExpressions.size(), reclaimed, pause);
 
-  std::cerr << "After garbage collection: " << allocatedExpressions.size()
+#ifdef DEBUG_RUNTIME
+  std::cerr << "After "
+            << (kind == CollectionKind::Full ? "full" : "minor")
+            << " garbage collection: " << allocatedExpressions.size()
             << " expressions remain" << std::endl
             << "\t(collection took "
-            << std::chrono::duration_cast<std::chrono::milliseconds>(end -
-                                                                     start)
+            << std::chrono::duration_cast<std::chrono::milliseconds>(pause)
                    .count()
             << " milliseconds)" << std::endl;
 #endif
@@ -16,9 +16,20 @@
 #ifndef RUNTIME_H
 #define RUNTIME_H
 
+#include <cstdint>
+
 #include "expr.h"
 
-typedef qsym::Expr *SymExpr;
+/// C clients refer to expressions by pointers to handles, which the backend
+/// keeps in a table (see Runtime.cpp). A handle owns a reference to the QSYM
+/// expression, and its index in the table identifies it for the garbage
+/// collector.
+struct ExprHandle {
+  qsym::ExprRef expr;
+  uint32_t index;
+};
+
+typedef ExprHandle *SymExpr;
 #include <RuntimeCommon.h>
 
 #endif
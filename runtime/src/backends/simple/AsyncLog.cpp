@@ -0,0 +1,319 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "AsyncLog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+/// The smallest ring buffer that we use.
+constexpr size_t kMinCapacity = 4096;
+
+/// The signals after which we try to save the pending log records.
+constexpr int kFatalSignals[] = {SIGABRT, SIGBUS,  SIGFPE, SIGILL,
+                                 SIGINT,  SIGSEGV, SIGTERM};
+
+/// Write the entire buffer, retrying on partial writes.
+void writeAll(int fd, iovec *iov, int iovcnt) {
+  while (iovcnt > 0) {
+    auto written = writev(fd, iov, iovcnt);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+
+    while (iovcnt > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+class AsyncLog {
+public:
+  AsyncLog(int fd, bool dropWhenFull, size_t capacity)
+      : fd_(fd), dropWhenFull_(dropWhenFull), capacity_(capacity),
+        wakeUpLevel_(capacity / 4), buffer_(new char[capacity]) {
+    cookie_io_functions_t functions{};
+    functions.write = cookieWrite;
+    stream_ = fopencookie(this, "w", functions);
+    setvbuf(stream_, nullptr, _IOFBF, 64 << 10);
+
+    writer_ = std::thread(&AsyncLog::writerLoop, this);
+  }
+
+  FILE *stream() const { return stream_; }
+
+  /// Hand everything that was written to the stream since the last commit to
+  /// the writer thread as a single record. Only droppable records are dropped
+  /// when the buffer is full.
+  void commit(bool droppable) {
+    fflush(stream_);
+    if (staged_.empty())
+      return;
+
+    if (synchronous_) {
+      iovec iov{staged_.data(), staged_.size()};
+      writeAll(fd_, &iov, 1);
+    } else {
+      push(staged_.data(), staged_.size(), droppable);
+    }
+    staged_.clear();
+  }
+
+  /// Write all pending records and stop the writer thread; any records that
+  /// are committed afterwards are written synchronously.
+  void shutDown() {
+    if (synchronous_)
+      return;
+
+    commit(false);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wakeUp_.notify_one();
+    writer_.join();
+    synchronous_ = true;
+  }
+
+  /// Wait (for a bounded time) until the writer thread has written all
+  /// committed records. Only uses async-signal-safe functions.
+  void drainFromSignalHandler() {
+    if (synchronous_)
+      return;
+
+    timespec delay{0, 1000000};
+    for (int i = 0; i < 1000; i++) {
+      if (tail_.load(std::memory_order_acquire) ==
+          head_.load(std::memory_order_acquire))
+        return;
+      nanosleep(&delay, nullptr);
+    }
+  }
+
+  /// Switch to synchronous mode in a forked child, which doesn't inherit the
+  /// writer thread. The parent's writer takes care of the pending records.
+  void forgetWriterAfterFork() {
+    tail_.store(head_.load());
+    synchronous_ = true;
+  }
+
+  AsyncLogStats stats() const {
+    return {dropped_.load(std::memory_order_relaxed),
+            blocked_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  static ssize_t cookieWrite(void *cookie, const char *data, size_t size) {
+    static_cast<AsyncLog *>(cookie)->staged_.append(data, size);
+    return size;
+  }
+
+  void push(const char *data, size_t size, bool droppable) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (size > capacity_) {
+      // The record will never fit; write it directly once everything before
+      // it has been written.
+      blocked_.fetch_add(1, std::memory_order_relaxed);
+      while (tail_.load(std::memory_order_acquire) != head) {
+        wakeUp_.notify_one();
+        std::this_thread::yield();
+      }
+      iovec iov{const_cast<char *>(data), size};
+      writeAll(fd_, &iov, 1);
+      return;
+    }
+
+    if (capacity_ - (head - tail_.load(std::memory_order_acquire)) < size) {
+      if (dropWhenFull_ && droppable) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      blocked_.fetch_add(1, std::memory_order_relaxed);
+      do {
+        wakeUp_.notify_one();
+        std::this_thread::yield();
+      } while (capacity_ - (head - tail_.load(std::memory_order_acquire)) <
+               size);
+    }
+
+    auto offset = head & (capacity_ - 1);
+    auto first = std::min<size_t>(size, capacity_ - offset);
+    std::memcpy(&buffer_[offset], data, first);
+    std::memcpy(&buffer_[0], data + first, size - first);
+    head_.store(head + size, std::memory_order_release);
+
+    // Waking up the writer costs a system call, so we let it sleep until its
+    // timeout unless the buffer is filling up.
+    if (head + size - tail_.load(std::memory_order_relaxed) >= wakeUpLevel_ &&
+        writerSleeping_.load(std::memory_order_acquire))
+      wakeUp_.notify_one();
+  }
+
+  void writerLoop() {
+    while (true) {
+      auto tail = tail_.load(std::memory_order_relaxed);
+      auto head = head_.load(std::memory_order_acquire);
+      if (head == tail) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stop_)
+          return;
+
+        // Producers only notify us while we sleep and the buffer is filling
+        // up; otherwise, we drain the buffer when the timeout expires.
+        writerSleeping_.store(true, std::memory_order_release);
+        wakeUp_.wait_for(lock, std::chrono::milliseconds(10), [&] {
+          return stop_ || head_.load(std::memory_order_acquire) != tail;
+        });
+        writerSleeping_.store(false, std::memory_order_release);
+        continue;
+      }
+
+      auto offset = tail & (capacity_ - 1);
+      auto length = head - tail;
+      auto first = std::min<size_t>(length, capacity_ - offset);
+      iovec iov[2] = {{&buffer_[offset], first}, {&buffer_[0], length - first}};
+      writeAll(fd_, iov, length > first ? 2 : 1);
+      tail_.store(head, std::memory_order_release);
+    }
+  }
+
+  int fd_;
+  bool dropWhenFull_;
+  FILE *stream_;
+
+  /// The size of the ring buffer in bytes (a power of two).
+  size_t capacity_;
+  /// The amount of pending data at which we wake up the writer.
+  size_t wakeUpLevel_;
+
+  /// The current record, not yet visible to the writer.
+  std::string staged_;
+
+  /// The ring buffer. Head and tail count the bytes that have ever been
+  /// committed and written, respectively; only the producer moves the head,
+  /// and only the writer moves the tail.
+  std::unique_ptr<char[]> buffer_;
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> tail_{0};
+
+  std::thread writer_;
+  std::mutex mutex_;
+  std::condition_variable wakeUp_;
+  std::atomic<bool> writerSleeping_{false};
+  bool stop_ = false;
+
+  /// Set once there is no writer thread anymore.
+  std::atomic<bool> synchronous_{false};
+
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> blocked_{0};
+};
+
+AsyncLog *g_async_log = nullptr;
+
+struct sigaction g_previous_actions[sizeof(kFatalSignals) / sizeof(int)];
+
+void handleFatalSignal(int signal) {
+  g_async_log->drainFromSignalHandler();
+
+  // Reinstate the previous disposition; the signal is delivered again as soon
+  // as we return.
+  for (size_t i = 0; i < sizeof(kFatalSignals) / sizeof(int); i++) {
+    if (kFatalSignals[i] == signal)
+      sigaction(signal, &g_previous_actions[i], nullptr);
+  }
+  raise(signal);
+}
+
+void shutDownAsyncLog() {
+  g_async_log->shutDown();
+
+  auto stats = g_async_log->stats();
+  if (stats.droppedRecords != 0 || stats.blockedRecords != 0)
+    fprintf(stderr,
+            "[symcc] Asynchronous log: %lu records dropped, %lu records had "
+            "to wait for the writer\n",
+            static_cast<unsigned long>(stats.droppedRecords),
+            static_cast<unsigned long>(stats.blockedRecords));
+}
+
+} // namespace
+
+FILE *startAsyncLog(FILE *file, bool dropWhenFull, size_t bufferSize) {
+  size_t capacity = kMinCapacity;
+  while (capacity < bufferSize)
+    capacity *= 2;
+
+  fflush(file);
+  g_async_log = new AsyncLog(fileno(file), dropWhenFull, capacity);
+
+  atexit(shutDownAsyncLog);
+  pthread_atfork(nullptr, nullptr,
+                 [] { g_async_log->forgetWriterAfterFork(); });
+
+  struct sigaction action {};
+  action.sa_handler = handleFatalSignal;
+  sigemptyset(&action.sa_mask);
+  for (size_t i = 0; i < sizeof(kFatalSignals) / sizeof(int); i++)
+    sigaction(kFatalSignals[i], &action, &g_previous_actions[i]);
+
+  return g_async_log->stream();
+}
+
+void commitLogRecord(FILE *log) {
+  if (g_async_log != nullptr && log == g_async_log->stream())
+    g_async_log->commit(true);
+  else
+    fflush(log);
+}
+
+void commitLogDefinitions(FILE *log) {
+  if (g_async_log != nullptr && log == g_async_log->stream())
+    g_async_log->commit(false);
+  else
+    fflush(log);
+}
+
+AsyncLogStats asyncLogStats() {
+  if (g_async_log == nullptr)
+    return {0, 0};
+  return g_async_log->stats();
+}
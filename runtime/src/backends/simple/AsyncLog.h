@@ -0,0 +1,56 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef ASYNCLOG_H
+#define ASYNCLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+//
+// Asynchronous log output. Log writers format their records into a stream as
+// usual and end each record with commitLogRecord(), or with
+// commitLogDefinitions() if later records refer to it. With the asynchronous
+// log enabled, committing copies the record into a single-producer ring
+// buffer, and a background thread drains the buffer into the log file with
+// large writes; the instrumented program doesn't make a system call per record.
+// Pending records are written out on exit, on abort and on fatal signals.
+//
+
+/// Start the asynchronous writer for the given file and return the stream that
+/// log records should be written to. The ring buffer holds at least bufferSize
+/// bytes. If it is full, we either drop records or wait for the writer,
+/// depending on dropWhenFull.
+FILE *startAsyncLog(FILE *file, bool dropWhenFull, size_t bufferSize);
+
+/// End a log record: hand it to the writer thread if the log is asynchronous,
+/// or flush it otherwise.
+void commitLogRecord(FILE *log);
+
+/// End log records that later records refer to (e.g., the definitions of
+/// expressions). Unlike commitLogRecord(), this never drops the records.
+void commitLogDefinitions(FILE *log);
+
+struct AsyncLogStats {
+  /// Records that were dropped because the ring buffer was full.
+  uint64_t droppedRecords;
+  /// Records that had to wait for space in the ring buffer.
+  uint64_t blockedRecords;
+};
+
+AsyncLogStats asyncLogStats();
+
+#endif
@@ -0,0 +1,285 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "BinaryLog.h"
+
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "AsyncLog.h"
+
+using namespace binlog;
+
+namespace {
+
+template <typename T> void appendStruct(std::vector<uint32_t> &words, T value) {
+  static_assert(sizeof(T) % sizeof(uint32_t) == 0,
+                "Records must consist of full words");
+  auto offset = words.size();
+  words.resize(offset + sizeof(T) / sizeof(uint32_t));
+  std::memcpy(&words[offset], &value, sizeof(T));
+}
+
+void appendUInt64(std::vector<uint32_t> &words, uint64_t value) {
+  words.push_back(static_cast<uint32_t>(value));
+  words.push_back(static_cast<uint32_t>(value >> 32));
+}
+
+} // namespace
+
+BinaryLogWriter::BinaryLogWriter(Z3_context context, FILE *log)
+    : context_(context), log_(log) {
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  fwrite(&header, sizeof(header), 1, log_);
+  commitLogDefinitions(log_);
+}
+
+BinaryLogWriter::~BinaryLogWriter() {
+  for (auto *node : loggedNodes_)
+    Z3_dec_ref(context_, node);
+  for (auto *sort : loggedSorts_)
+    Z3_dec_ref(context_, Z3_sort_to_ast(context_, sort));
+}
+
+void BinaryLogWriter::logQuery(Z3_solver solver, uint64_t site_id,
+                               int check_kind, int taken, const char *filename,
+                               int line, int thread_id) {
+  auto *assertions = Z3_solver_get_assertions(context_, solver);
+  Z3_ast_vector_inc_ref(context_, assertions);
+
+  auto numAssertions = Z3_ast_vector_size(context_, assertions);
+  std::vector<uint32_t> roots;
+  roots.reserve(numAssertions);
+  for (unsigned i = 0; i < numAssertions; i++) {
+    auto root = internNode(Z3_ast_vector_get(context_, assertions, i));
+    if (!root)
+      break;
+    roots.push_back(*root);
+  }
+  Z3_ast_vector_dec_ref(context_, assertions);
+  auto filenameId = internString(filename);
+
+  // Node IDs are positional, so the records that we've just added must reach
+  // the log even if the query itself is dropped.
+  commitLogDefinitions(log_);
+
+  if (roots.size() != numAssertions) {
+    unloggedQueries_++;
+    return;
+  }
+
+  QueryRecord query{};
+  query.siteLow = uint32_t(site_id);
+  query.siteHigh = uint32_t(site_id >> 32);
+  query.checkKind = check_kind;
+  query.context = thread_id;
+  query.taken = taken;
+  query.filename = filenameId;
+  query.line = line;
+  query.numAssertions = numAssertions;
+
+  payload_.clear();
+  appendStruct(payload_, query);
+  payload_.insert(payload_.end(), roots.begin(), roots.end());
+  writeRecord(RecordType::Query, payload_);
+  commitLogRecord(log_);
+}
+
+std::optional<uint32_t> BinaryLogWriter::internNode(Z3_ast expr) {
+  if (auto it = nodeIds_.find(Z3_get_ast_id(context_, expr));
+      it != nodeIds_.end())
+    return it->second;
+
+  // Expressions can be very deep (think of long chains of concatenations), so
+  // we use an explicit stack for the post-order traversal. The flag indicates
+  // whether the arguments of the node have been pushed already.
+  std::vector<std::pair<Z3_ast, bool>> stack{{expr, false}};
+  while (!stack.empty()) {
+    auto [node, expanded] = stack.back();
+    if (nodeIds_.count(Z3_get_ast_id(context_, node)) != 0) {
+      stack.pop_back();
+      continue;
+    }
+
+    assert(Z3_get_ast_kind(context_, node) == Z3_APP_AST ||
+           Z3_get_ast_kind(context_, node) == Z3_NUMERAL_AST);
+    auto *app = Z3_to_app(context_, node);
+    if (expanded) {
+      stack.pop_back();
+      if (!writeNode(app))
+        return std::nullopt;
+      continue;
+    }
+
+    stack.back().second = true;
+    for (unsigned i = Z3_get_app_num_args(context_, app); i > 0; i--) {
+      auto *arg = Z3_get_app_arg(context_, app, i - 1);
+      if (nodeIds_.count(Z3_get_ast_id(context_, arg)) == 0)
+        stack.emplace_back(arg, false);
+    }
+  }
+
+  return nodeIds_.at(Z3_get_ast_id(context_, expr));
+}
+
+bool BinaryLogWriter::writeNode(Z3_app app) {
+  auto *expr = Z3_app_to_ast(context_, app);
+  auto *decl = Z3_get_app_decl(context_, app);
+  auto kind = Z3_get_decl_kind(context_, decl);
+  auto *sort = Z3_get_sort(context_, expr);
+
+  std::vector<uint32_t> params, args;
+  switch (kind) {
+  case Z3_OP_BNUM: {
+    auto bits = Z3_get_bv_sort_size(context_, sort);
+    uint64_t value;
+    if (bits <= 64 && Z3_get_numeral_uint64(context_, expr, &value)) {
+      appendUInt64(params, value);
+    } else {
+      // The binary string has the most significant bit first and no leading
+      // zeros.
+      std::string binary = Z3_get_numeral_binary_string(context_, expr);
+      params.assign((bits + 31) / 32, 0);
+      for (size_t i = 0; i < binary.size(); i++) {
+        if (binary[binary.size() - 1 - i] == '1')
+          params[i / 32] |= 1u << (i % 32);
+      }
+    }
+    break;
+  }
+  case Z3_OP_ANUM: {
+    int64_t value;
+    if (Z3_get_numeral_int64(context_, expr, &value))
+      appendUInt64(params, static_cast<uint64_t>(value));
+    else
+      params.push_back(internString(Z3_get_numeral_string(context_, expr)));
+    break;
+  }
+  case Z3_OP_FPA_NUM: {
+    // Store the components as bit vectors, which the reader can recombine
+    // without loss (including subnormal numbers).
+    Z3_ast components[3];
+    components[0] = Z3_fpa_get_numeral_sign_bv(context_, expr);
+    Z3_inc_ref(context_, components[0]);
+    components[1] = Z3_fpa_get_numeral_exponent_bv(context_, expr, true);
+    Z3_inc_ref(context_, components[1]);
+    components[2] = Z3_fpa_get_numeral_significand_bv(context_, expr);
+    Z3_inc_ref(context_, components[2]);
+    // Bit-vector numerals can always be logged.
+    for (auto *component : components) {
+      args.push_back(*internNode(component));
+      Z3_dec_ref(context_, component);
+    }
+    break;
+  }
+  case Z3_OP_UNINTERPRETED: {
+    auto symbol = Z3_get_decl_name(context_, decl);
+    params.push_back(internString(
+        Z3_get_symbol_kind(context_, symbol) == Z3_STRING_SYMBOL
+            ? std::string(Z3_get_symbol_string(context_, symbol))
+            : std::to_string(Z3_get_symbol_int(context_, symbol))));
+    break;
+  }
+  default: {
+    // The format only has room for integer parameters, so we can't log
+    // declarations with other kinds of parameters.
+    auto numParams = Z3_get_decl_num_parameters(context_, decl);
+    for (unsigned i = 0; i < numParams; i++) {
+      if (Z3_get_decl_parameter_kind(context_, decl, i) != Z3_PARAMETER_INT)
+        return false;
+      params.push_back(Z3_get_decl_int_parameter(context_, decl, i));
+    }
+    break;
+  }
+  }
+
+  if (kind != Z3_OP_FPA_NUM) {
+    auto numArgs = Z3_get_app_num_args(context_, app);
+    for (unsigned i = 0; i < numArgs; i++)
+      args.push_back(nodeIds_.at(
+          Z3_get_ast_id(context_, Z3_get_app_arg(context_, app, i))));
+  }
+
+  NodeRecord node{};
+  node.kind = kind;
+  node.sort = internSort(sort);
+  node.numParams = params.size();
+  node.numArgs = args.size();
+
+  payload_.clear();
+  appendStruct(payload_, node);
+  payload_.insert(payload_.end(), params.begin(), params.end());
+  payload_.insert(payload_.end(), args.begin(), args.end());
+  writeRecord(RecordType::Node, payload_);
+
+  uint32_t id = nodeIds_.size();
+  nodeIds_.emplace(Z3_get_ast_id(context_, expr), id);
+  Z3_inc_ref(context_, expr);
+  loggedNodes_.push_back(expr);
+  return true;
+}
+
+uint32_t BinaryLogWriter::internSort(Z3_sort sort) {
+  auto [it, inserted] = sortIds_.try_emplace(Z3_get_sort_id(context_, sort),
+                                             sortIds_.size());
+  if (!inserted)
+    return it->second;
+
+  SortRecord record{};
+  record.kind = Z3_get_sort_kind(context_, sort);
+  switch (record.kind) {
+  case Z3_BV_SORT:
+    record.size[0] = Z3_get_bv_sort_size(context_, sort);
+    break;
+  case Z3_FLOATING_POINT_SORT:
+    record.size[0] = Z3_fpa_get_ebits(context_, sort);
+    record.size[1] = Z3_fpa_get_sbits(context_, sort);
+    break;
+  default:
+    break;
+  }
+
+  std::vector<uint32_t> words;
+  appendStruct(words, record);
+  writeRecord(RecordType::Sort, words);
+
+  Z3_inc_ref(context_, Z3_sort_to_ast(context_, sort));
+  loggedSorts_.push_back(sort);
+  return it->second;
+}
+
+uint32_t BinaryLogWriter::internString(const std::string &str) {
+  auto [it, inserted] = stringIds_.try_emplace(str, stringIds_.size());
+  if (!inserted)
+    return it->second;
+
+  std::vector<uint32_t> words;
+  appendStruct(words, StringRecord{static_cast<uint32_t>(str.size())});
+  auto offset = words.size();
+  words.resize(offset + (str.size() + 3) / 4, 0);
+  std::memcpy(&words[offset], str.data(), str.size());
+  writeRecord(RecordType::String, words);
+  return it->second;
+}
+
+void BinaryLogWriter::writeRecord(RecordType type,
+                                  const std::vector<uint32_t> &words) {
+  RecordHeader header{type, static_cast<uint32_t>(words.size())};
+  fwrite(&header, sizeof(header), 1, log_);
+  fwrite(words.data(), sizeof(uint32_t), words.size(), log_);
+}
@@ -0,0 +1,84 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BINARYLOG_H
+#define BINARYLOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <z3.h>
+
+#include "BinaryLogFormat.h"
+
+/// Writer for the binary log (see BinaryLogFormat.h for the format).
+class BinaryLogWriter {
+public:
+  BinaryLogWriter(Z3_context context, FILE *log);
+  ~BinaryLogWriter();
+
+  BinaryLogWriter(const BinaryLogWriter &) = delete;
+  BinaryLogWriter &operator=(const BinaryLogWriter &) = delete;
+
+  /// Log the query that is currently in the solver, on behalf of the given
+  /// thread.
+  void logQuery(Z3_solver solver, uint64_t site_id, int check_kind, int taken,
+                const char *filename, int line, int thread_id);
+
+  /// The number of queries that we couldn't log because they contain
+  /// expressions that the format can't represent.
+  uint64_t unloggedQueries() const { return unloggedQueries_; }
+
+private:
+  /// Return the ID of the expression, writing records for all of its
+  /// sub-expressions that the log doesn't contain yet; nothing if the
+  /// expression can't be logged.
+  std::optional<uint32_t> internNode(Z3_ast expr);
+
+  /// Write the record of a single node whose arguments have been interned;
+  /// false if the format can't represent the node.
+  bool writeNode(Z3_app app);
+
+  uint32_t internSort(Z3_sort sort);
+  uint32_t internString(const std::string &str);
+
+  void writeRecord(binlog::RecordType type, const std::vector<uint32_t> &words);
+
+  Z3_context context_;
+  FILE *log_;
+
+  /// Mapping from Z3 AST IDs to node IDs. We hold a reference to each logged
+  /// expression, so the AST IDs can't be reused.
+  std::unordered_map<unsigned, uint32_t> nodeIds_;
+  std::vector<Z3_ast> loggedNodes_;
+
+  /// Mapping from Z3 sort IDs to sort IDs.
+  std::unordered_map<unsigned, uint32_t> sortIds_;
+  std::vector<Z3_sort> loggedSorts_;
+
+  std::map<std::string, uint32_t> stringIds_;
+
+  /// A buffer for record payloads, reused to avoid allocations.
+  std::vector<uint32_t> payload_;
+
+  uint64_t unloggedQueries_ = 0;
+};
+
+#endif
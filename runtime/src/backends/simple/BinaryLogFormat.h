@@ -0,0 +1,110 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BINARYLOGFORMAT_H
+#define BINARYLOGFORMAT_H
+
+#include <cstdint>
+
+//
+// The binary log is meant to be consumed without parsing: a reader maps the
+// file into memory and walks the records. It starts with a FileHeader and
+// continues with a sequence of records, each consisting of a RecordHeader and
+// a payload of 32-bit words in host byte order. Strings, sorts and expression
+// nodes are numbered in the order in which they appear (starting at 0), and
+// records only ever refer to items that were written before them. Since every
+// node is written exactly once, the expression DAG is shared between all
+// queries in the log.
+//
+// Node kinds are Z3_decl_kind values, so the reader needs a Z3 version that
+// agrees with the writer's on the numbering.
+//
+
+namespace binlog {
+
+constexpr char kMagic[8] = {'S', 'Y', 'M', 'C', 'C', 'L', 'O', 'G'};
+constexpr uint32_t kVersion = 2;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+enum class RecordType : uint32_t {
+  /// A StringRecord followed by the characters, padded to a full word.
+  String = 1,
+  /// A SortRecord.
+  Sort = 2,
+  /// A NodeRecord followed by the parameter words and the argument node IDs.
+  Node = 3,
+  /// A QueryRecord followed by the node IDs of the assertions.
+  Query = 4,
+};
+
+struct RecordHeader {
+  RecordType type;
+  /// The size of the payload in 32-bit words.
+  uint32_t words;
+};
+
+struct StringRecord {
+  uint32_t length;
+};
+
+struct SortRecord {
+  /// The Z3_sort_kind of the sort.
+  uint32_t kind;
+  /// The bit width of bit-vector sorts, or exponent and significand bits of
+  /// floating-point sorts.
+  uint32_t size[2];
+};
+
+struct NodeRecord {
+  /// The Z3_decl_kind of the node's function declaration.
+  uint32_t kind;
+  uint32_t sort;
+  /// The integer parameters of the declaration, except for numerals and
+  /// uninterpreted symbols: bit-vector and integer numerals store their value
+  /// as little-endian words (arithmetic numerals that don't fit 64 bits store
+  /// the string ID of their decimal representation instead), and
+  /// uninterpreted symbols store the string ID of their name. Floating-point
+  /// numerals have no parameters; their arguments are the sign, the biased
+  /// exponent and the significand as bit vectors. Declarations with other
+  /// than integer parameters can't be logged.
+  uint32_t numParams;
+  uint32_t numArgs;
+};
+
+struct QueryRecord {
+  /// The site ID, split into words because the payload is only aligned to
+  /// 32 bits.
+  uint32_t siteLow;
+  uint32_t siteHigh;
+  /// The kind of check that the branch implements (0 for ordinary branches).
+  int32_t checkKind;
+  /// The ID of the thread that made the query (0 unless the runtime is
+  /// thread-safe).
+  int32_t context;
+  int32_t taken;
+  /// The string ID of the file name.
+  uint32_t filename;
+  int32_t line;
+  uint32_t numAssertions;
+};
+
+} // namespace binlog
+
+#endif
@@ -0,0 +1,615 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "BinaryLogReader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace binlog;
+
+namespace {
+
+const uint32_t *params(const NodeRecord &record) {
+  return reinterpret_cast<const uint32_t *>(&record + 1);
+}
+
+const uint32_t *args(const NodeRecord &record) {
+  return params(record) + record.numParams;
+}
+
+uint64_t uint64Param(const NodeRecord &record) {
+  return params(record)[0] | (static_cast<uint64_t>(params(record)[1]) << 32);
+}
+
+/// The number of integer parameters that applyKind reads for the given kind.
+uint32_t numRequiredParams(Z3_decl_kind kind) {
+  switch (kind) {
+  case Z3_OP_EXTRACT:
+    return 2;
+  case Z3_OP_SIGN_EXT:
+  case Z3_OP_ZERO_EXT:
+  case Z3_OP_REPEAT:
+  case Z3_OP_ROTATE_LEFT:
+  case Z3_OP_ROTATE_RIGHT:
+  case Z3_OP_INT2BV:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/// Z3 only has API functions for division operators with SMT-LIB semantics;
+/// the internal variants can only occur when the divisor is known to be
+/// non-zero, so the two are equivalent.
+Z3_decl_kind publicKind(Z3_decl_kind kind) {
+  switch (kind) {
+  case Z3_OP_BSDIV_I:
+    return Z3_OP_BSDIV;
+  case Z3_OP_BUDIV_I:
+    return Z3_OP_BUDIV;
+  case Z3_OP_BSREM_I:
+    return Z3_OP_BSREM;
+  case Z3_OP_BUREM_I:
+    return Z3_OP_BUREM;
+  case Z3_OP_BSMOD_I:
+    return Z3_OP_BSMOD;
+  default:
+    return kind;
+  }
+}
+
+/// Build an expression of the given kind with the Z3 API. N-ary operators that
+/// the API only offers in binary form are built as left-nested chains.
+Z3_ast applyKind(Z3_context c, Z3_decl_kind kind, const uint32_t *p,
+                 const std::vector<Z3_ast> &x, Z3_sort sort) {
+  auto fold = [&](Z3_ast (*op)(Z3_context, Z3_ast, Z3_ast)) {
+    auto *result = x.at(0);
+    for (size_t i = 1; i < x.size(); i++)
+      result = op(c, result, x[i]);
+    return result;
+  };
+  unsigned n = x.size();
+
+  switch (kind) {
+  case Z3_OP_TRUE:
+    return Z3_mk_true(c);
+  case Z3_OP_FALSE:
+    return Z3_mk_false(c);
+  case Z3_OP_EQ:
+    return Z3_mk_eq(c, x.at(0), x.at(1));
+  case Z3_OP_DISTINCT:
+    return Z3_mk_distinct(c, n, x.data());
+  case Z3_OP_ITE:
+    return Z3_mk_ite(c, x.at(0), x.at(1), x.at(2));
+  case Z3_OP_AND:
+    return Z3_mk_and(c, n, x.data());
+  case Z3_OP_OR:
+    return Z3_mk_or(c, n, x.data());
+  case Z3_OP_IFF:
+    return Z3_mk_iff(c, x.at(0), x.at(1));
+  case Z3_OP_XOR:
+    return fold(Z3_mk_xor);
+  case Z3_OP_NOT:
+    return Z3_mk_not(c, x.at(0));
+  case Z3_OP_IMPLIES:
+    return Z3_mk_implies(c, x.at(0), x.at(1));
+
+  case Z3_OP_LE:
+    return Z3_mk_le(c, x.at(0), x.at(1));
+  case Z3_OP_GE:
+    return Z3_mk_ge(c, x.at(0), x.at(1));
+  case Z3_OP_LT:
+    return Z3_mk_lt(c, x.at(0), x.at(1));
+  case Z3_OP_GT:
+    return Z3_mk_gt(c, x.at(0), x.at(1));
+  case Z3_OP_ADD:
+    return Z3_mk_add(c, n, x.data());
+  case Z3_OP_SUB:
+    return Z3_mk_sub(c, n, x.data());
+  case Z3_OP_UMINUS:
+    return Z3_mk_unary_minus(c, x.at(0));
+  case Z3_OP_MUL:
+    return Z3_mk_mul(c, n, x.data());
+  case Z3_OP_DIV:
+  case Z3_OP_IDIV:
+    return Z3_mk_div(c, x.at(0), x.at(1));
+  case Z3_OP_REM:
+    return Z3_mk_rem(c, x.at(0), x.at(1));
+  case Z3_OP_MOD:
+    return Z3_mk_mod(c, x.at(0), x.at(1));
+  case Z3_OP_TO_REAL:
+    return Z3_mk_int2real(c, x.at(0));
+  case Z3_OP_TO_INT:
+    return Z3_mk_real2int(c, x.at(0));
+
+  case Z3_OP_BNEG:
+    return Z3_mk_bvneg(c, x.at(0));
+  case Z3_OP_BADD:
+    return fold(Z3_mk_bvadd);
+  case Z3_OP_BSUB:
+    return fold(Z3_mk_bvsub);
+  case Z3_OP_BMUL:
+    return fold(Z3_mk_bvmul);
+  case Z3_OP_BSDIV:
+  case Z3_OP_BSDIV_I:
+    return Z3_mk_bvsdiv(c, x.at(0), x.at(1));
+  case Z3_OP_BUDIV:
+  case Z3_OP_BUDIV_I:
+    return Z3_mk_bvudiv(c, x.at(0), x.at(1));
+  case Z3_OP_BSREM:
+  case Z3_OP_BSREM_I:
+    return Z3_mk_bvsrem(c, x.at(0), x.at(1));
+  case Z3_OP_BUREM:
+  case Z3_OP_BUREM_I:
+    return Z3_mk_bvurem(c, x.at(0), x.at(1));
+  case Z3_OP_BSMOD:
+  case Z3_OP_BSMOD_I:
+    return Z3_mk_bvsmod(c, x.at(0), x.at(1));
+  case Z3_OP_ULEQ:
+    return Z3_mk_bvule(c, x.at(0), x.at(1));
+  case Z3_OP_SLEQ:
+    return Z3_mk_bvsle(c, x.at(0), x.at(1));
+  case Z3_OP_UGEQ:
+    return Z3_mk_bvuge(c, x.at(0), x.at(1));
+  case Z3_OP_SGEQ:
+    return Z3_mk_bvsge(c, x.at(0), x.at(1));
+  case Z3_OP_ULT:
+    return Z3_mk_bvult(c, x.at(0), x.at(1));
+  case Z3_OP_SLT:
+    return Z3_mk_bvslt(c, x.at(0), x.at(1));
+  case Z3_OP_UGT:
+    return Z3_mk_bvugt(c, x.at(0), x.at(1));
+  case Z3_OP_SGT:
+    return Z3_mk_bvsgt(c, x.at(0), x.at(1));
+  case Z3_OP_BAND:
+    return fold(Z3_mk_bvand);
+  case Z3_OP_BOR:
+    return fold(Z3_mk_bvor);
+  case Z3_OP_BNOT:
+    return Z3_mk_bvnot(c, x.at(0));
+  case Z3_OP_BXOR:
+    return fold(Z3_mk_bvxor);
+  case Z3_OP_BNAND:
+    return Z3_mk_bvnand(c, x.at(0), x.at(1));
+  case Z3_OP_BNOR:
+    return Z3_mk_bvnor(c, x.at(0), x.at(1));
+  case Z3_OP_BXNOR:
+    return Z3_mk_bvxnor(c, x.at(0), x.at(1));
+  case Z3_OP_CONCAT:
+    return fold(Z3_mk_concat);
+  case Z3_OP_SIGN_EXT:
+    return Z3_mk_sign_ext(c, p[0], x.at(0));
+  case Z3_OP_ZERO_EXT:
+    return Z3_mk_zero_ext(c, p[0], x.at(0));
+  case Z3_OP_EXTRACT:
+    return Z3_mk_extract(c, p[0], p[1], x.at(0));
+  case Z3_OP_REPEAT:
+    return Z3_mk_repeat(c, p[0], x.at(0));
+  case Z3_OP_BREDOR:
+    return Z3_mk_bvredor(c, x.at(0));
+  case Z3_OP_BREDAND:
+    return Z3_mk_bvredand(c, x.at(0));
+  case Z3_OP_BSHL:
+    return Z3_mk_bvshl(c, x.at(0), x.at(1));
+  case Z3_OP_BLSHR:
+    return Z3_mk_bvlshr(c, x.at(0), x.at(1));
+  case Z3_OP_BASHR:
+    return Z3_mk_bvashr(c, x.at(0), x.at(1));
+  case Z3_OP_ROTATE_LEFT:
+    return Z3_mk_rotate_left(c, p[0], x.at(0));
+  case Z3_OP_ROTATE_RIGHT:
+    return Z3_mk_rotate_right(c, p[0], x.at(0));
+  case Z3_OP_EXT_ROTATE_LEFT:
+    return Z3_mk_ext_rotate_left(c, x.at(0), x.at(1));
+  case Z3_OP_EXT_ROTATE_RIGHT:
+    return Z3_mk_ext_rotate_right(c, x.at(0), x.at(1));
+  case Z3_OP_INT2BV:
+    return Z3_mk_int2bv(c, p[0], x.at(0));
+  case Z3_OP_BV2INT:
+    return Z3_mk_bv2int(c, x.at(0), false);
+
+  case Z3_OP_FPA_RM_NEAREST_TIES_TO_EVEN:
+    return Z3_mk_fpa_rne(c);
+  case Z3_OP_FPA_RM_NEAREST_TIES_TO_AWAY:
+    return Z3_mk_fpa_rna(c);
+  case Z3_OP_FPA_RM_TOWARD_POSITIVE:
+    return Z3_mk_fpa_rtp(c);
+  case Z3_OP_FPA_RM_TOWARD_NEGATIVE:
+    return Z3_mk_fpa_rtn(c);
+  case Z3_OP_FPA_RM_TOWARD_ZERO:
+    return Z3_mk_fpa_rtz(c);
+  case Z3_OP_FPA_PLUS_INF:
+    return Z3_mk_fpa_inf(c, sort, false);
+  case Z3_OP_FPA_MINUS_INF:
+    return Z3_mk_fpa_inf(c, sort, true);
+  case Z3_OP_FPA_NAN:
+    return Z3_mk_fpa_nan(c, sort);
+  case Z3_OP_FPA_PLUS_ZERO:
+    return Z3_mk_fpa_zero(c, sort, false);
+  case Z3_OP_FPA_MINUS_ZERO:
+    return Z3_mk_fpa_zero(c, sort, true);
+  case Z3_OP_FPA_ADD:
+    return Z3_mk_fpa_add(c, x.at(0), x.at(1), x.at(2));
+  case Z3_OP_FPA_SUB:
+    return Z3_mk_fpa_sub(c, x.at(0), x.at(1), x.at(2));
+  case Z3_OP_FPA_NEG:
+    return Z3_mk_fpa_neg(c, x.at(0));
+  case Z3_OP_FPA_MUL:
+    return Z3_mk_fpa_mul(c, x.at(0), x.at(1), x.at(2));
+  case Z3_OP_FPA_DIV:
+    return Z3_mk_fpa_div(c, x.at(0), x.at(1), x.at(2));
+  case Z3_OP_FPA_REM:
+    return Z3_mk_fpa_rem(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_ABS:
+    return Z3_mk_fpa_abs(c, x.at(0));
+  case Z3_OP_FPA_MIN:
+    return Z3_mk_fpa_min(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_MAX:
+    return Z3_mk_fpa_max(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_FMA:
+    return Z3_mk_fpa_fma(c, x.at(0), x.at(1), x.at(2), x.at(3));
+  case Z3_OP_FPA_SQRT:
+    return Z3_mk_fpa_sqrt(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_ROUND_TO_INTEGRAL:
+    return Z3_mk_fpa_round_to_integral(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_EQ:
+    return Z3_mk_fpa_eq(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_LT:
+    return Z3_mk_fpa_lt(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_GT:
+    return Z3_mk_fpa_gt(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_LE:
+    return Z3_mk_fpa_leq(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_GE:
+    return Z3_mk_fpa_geq(c, x.at(0), x.at(1));
+  case Z3_OP_FPA_IS_NAN:
+    return Z3_mk_fpa_is_nan(c, x.at(0));
+  case Z3_OP_FPA_IS_INF:
+    return Z3_mk_fpa_is_infinite(c, x.at(0));
+  case Z3_OP_FPA_IS_ZERO:
+    return Z3_mk_fpa_is_zero(c, x.at(0));
+  case Z3_OP_FPA_IS_NORMAL:
+    return Z3_mk_fpa_is_normal(c, x.at(0));
+  case Z3_OP_FPA_IS_SUBNORMAL:
+    return Z3_mk_fpa_is_subnormal(c, x.at(0));
+  case Z3_OP_FPA_IS_NEGATIVE:
+    return Z3_mk_fpa_is_negative(c, x.at(0));
+  case Z3_OP_FPA_IS_POSITIVE:
+    return Z3_mk_fpa_is_positive(c, x.at(0));
+  case Z3_OP_FPA_FP:
+    return Z3_mk_fpa_fp(c, x.at(0), x.at(1), x.at(2));
+  case Z3_OP_FPA_TO_FP: {
+    if (n == 1)
+      return Z3_mk_fpa_to_fp_bv(c, x[0], sort);
+    switch (Z3_get_sort_kind(c, Z3_get_sort(c, x.at(1)))) {
+    case Z3_FLOATING_POINT_SORT:
+      return Z3_mk_fpa_to_fp_float(c, x[0], x[1], sort);
+    case Z3_REAL_SORT:
+      return Z3_mk_fpa_to_fp_real(c, x[0], x[1], sort);
+    default:
+      return Z3_mk_fpa_to_fp_signed(c, x[0], x[1], sort);
+    }
+  }
+  case Z3_OP_FPA_TO_FP_UNSIGNED:
+    return Z3_mk_fpa_to_fp_unsigned(c, x.at(0), x.at(1), sort);
+  case Z3_OP_FPA_TO_UBV:
+    return Z3_mk_fpa_to_ubv(c, x.at(0), x.at(1), p[0]);
+  case Z3_OP_FPA_TO_SBV:
+    return Z3_mk_fpa_to_sbv(c, x.at(0), x.at(1), p[0]);
+  case Z3_OP_FPA_TO_REAL:
+    return Z3_mk_fpa_to_real(c, x.at(0));
+  case Z3_OP_FPA_TO_IEEE_BV:
+    return Z3_mk_fpa_to_ieee_bv(c, x.at(0));
+
+  default:
+    throw std::runtime_error("Unsupported expression kind " +
+                             std::to_string(kind) + " in binary log");
+  }
+}
+
+} // namespace
+
+BinaryLogReader::BinaryLogReader(Z3_context context, const char *path)
+    : context_(context) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error(std::string("Failed to open ") + path + ": " +
+                             strerror(errno));
+
+  struct stat fileInfo;
+  if (fstat(fd, &fileInfo) != 0 ||
+      static_cast<size_t>(fileInfo.st_size) < sizeof(FileHeader)) {
+    close(fd);
+    throw std::runtime_error(std::string(path) + " is not a binary SymCC log");
+  }
+
+  size_ = fileInfo.st_size;
+  auto *mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    throw std::runtime_error(std::string("Failed to map ") + path + ": " +
+                             strerror(errno));
+  data_ = static_cast<const char *>(mapping);
+
+  auto *header = reinterpret_cast<const FileHeader *>(data_);
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion) {
+    munmap(const_cast<char *>(data_), size_);
+    throw std::runtime_error(std::string(path) +
+                             " is not a binary SymCC log of version " +
+                             std::to_string(kVersion));
+  }
+
+  indexRecords();
+}
+
+BinaryLogReader::~BinaryLogReader() {
+  for (auto *node : nodes_)
+    Z3_dec_ref(context_, node);
+  for (auto &[key, decl] : declarations_)
+    Z3_dec_ref(context_, Z3_func_decl_to_ast(context_, decl));
+  for (auto *sort : sorts_)
+    Z3_dec_ref(context_, Z3_sort_to_ast(context_, sort));
+  munmap(const_cast<char *>(data_), size_);
+}
+
+void BinaryLogReader::indexRecords() {
+  size_t offset = sizeof(FileHeader);
+  while (offset + sizeof(RecordHeader) <= size_) {
+    auto *header = reinterpret_cast<const RecordHeader *>(data_ + offset);
+    auto *payload = data_ + offset + sizeof(RecordHeader);
+    size_t payloadSize = header->words * sizeof(uint32_t);
+
+    // The log may end with a partial record if the program crashed while
+    // writing it.
+    if (offset + sizeof(RecordHeader) + payloadSize > size_)
+      break;
+    offset += sizeof(RecordHeader) + payloadSize;
+
+    switch (header->type) {
+    case RecordType::String: {
+      auto *record = reinterpret_cast<const StringRecord *>(payload);
+      if (sizeof(StringRecord) + record->length > payloadSize)
+        throw std::runtime_error("Malformed string record in binary log");
+      strings_.emplace_back(payload + sizeof(StringRecord), record->length);
+      break;
+    }
+    case RecordType::Sort: {
+      auto *record = reinterpret_cast<const SortRecord *>(payload);
+      if (sizeof(SortRecord) > payloadSize)
+        throw std::runtime_error("Malformed sort record in binary log");
+
+      Z3_sort sort;
+      switch (record->kind) {
+      case Z3_BOOL_SORT:
+        sort = Z3_mk_bool_sort(context_);
+        break;
+      case Z3_INT_SORT:
+        sort = Z3_mk_int_sort(context_);
+        break;
+      case Z3_REAL_SORT:
+        sort = Z3_mk_real_sort(context_);
+        break;
+      case Z3_BV_SORT:
+        sort = Z3_mk_bv_sort(context_, record->size[0]);
+        break;
+      case Z3_FLOATING_POINT_SORT:
+        sort = Z3_mk_fpa_sort(context_, record->size[0], record->size[1]);
+        break;
+      case Z3_ROUNDING_MODE_SORT:
+        sort = Z3_mk_fpa_rounding_mode_sort(context_);
+        break;
+      default:
+        throw std::runtime_error("Unsupported sort kind " +
+                                 std::to_string(record->kind) +
+                                 " in binary log");
+      }
+      Z3_inc_ref(context_, Z3_sort_to_ast(context_, sort));
+      sorts_.push_back(sort);
+      break;
+    }
+    case RecordType::Node: {
+      auto *record = reinterpret_cast<const NodeRecord *>(payload);
+      if (sizeof(NodeRecord) > payloadSize ||
+          sizeof(NodeRecord) +
+                  (size_t(record->numParams) + record->numArgs) *
+                      sizeof(uint32_t) >
+              payloadSize ||
+          record->sort >= sorts_.size())
+        throw std::runtime_error("Malformed node record in binary log");
+      for (uint32_t i = 0; i < record->numArgs; i++) {
+        if (args(*record)[i] >= nodeRecords_.size())
+          throw std::runtime_error("Malformed node record in binary log");
+      }
+      nodeRecords_.push_back(record);
+      break;
+    }
+    case RecordType::Query: {
+      auto *record = reinterpret_cast<const QueryRecord *>(payload);
+      if (sizeof(QueryRecord) > payloadSize ||
+          sizeof(QueryRecord) + record->numAssertions * sizeof(uint32_t) >
+              payloadSize ||
+          record->filename >= strings_.size())
+        throw std::runtime_error("Malformed query record in binary log");
+      queries_.push_back(record);
+      break;
+    }
+    default:
+      throw std::runtime_error("Unknown record type in binary log");
+    }
+  }
+}
+
+BinaryLogReader::Query BinaryLogReader::query(size_t index) {
+  auto *record = queries_.at(index);
+  auto *roots = reinterpret_cast<const uint32_t *>(record + 1);
+
+  Query result{uint64_t(record->siteHigh) << 32 | record->siteLow,
+               record->checkKind,
+               record->context,
+               record->taken,
+               strings_[record->filename],
+               record->line,
+               {}};
+  for (uint32_t i = 0; i < record->numAssertions; i++)
+    result.assertions.push_back(node(roots[i]));
+  return result;
+}
+
+Z3_ast BinaryLogReader::node(uint32_t id) {
+  if (id >= nodeRecords_.size())
+    throw std::runtime_error("Reference to unknown node " + std::to_string(id) +
+                             " in binary log");
+
+  // Nodes only refer to nodes with smaller IDs, so building them in order
+  // means that the arguments of each node are always available.
+  while (nodes_.size() <= id) {
+    auto *expr = buildNode(*nodeRecords_[nodes_.size()]);
+    Z3_inc_ref(context_, expr);
+    nodes_.push_back(expr);
+  }
+
+  return nodes_[id];
+}
+
+Z3_ast BinaryLogReader::buildNode(const NodeRecord &record) {
+  auto *sort = sorts_[record.sort];
+  auto kind = static_cast<Z3_decl_kind>(record.kind);
+
+  switch (kind) {
+  case Z3_OP_BNUM: {
+    auto bits = Z3_get_bv_sort_size(context_, sort);
+    if (bits <= 64) {
+      if (record.numParams != 2)
+        throw std::runtime_error("Malformed bit-vector numeral in binary log");
+      return Z3_mk_unsigned_int64(context_, uint64Param(record), sort);
+    }
+
+    if (record.numParams != (bits + 31) / 32)
+      throw std::runtime_error("Malformed bit-vector numeral in binary log");
+    std::unique_ptr<bool[]> bitValues(new bool[bits]);
+    for (unsigned i = 0; i < bits; i++)
+      bitValues[i] = (params(record)[i / 32] >> (i % 32)) & 1;
+    return Z3_mk_bv_numeral(context_, bits, bitValues.get());
+  }
+  case Z3_OP_ANUM:
+    // Numerals that don't fit 64 bits are stored as decimal strings.
+    if (record.numParams == 2)
+      return Z3_mk_int64(context_, static_cast<int64_t>(uint64Param(record)),
+                         sort);
+    if (record.numParams == 1 && params(record)[0] < strings_.size())
+      return Z3_mk_numeral(context_, strings_[params(record)[0]].c_str(),
+                           sort);
+    throw std::runtime_error("Malformed arithmetic numeral in binary log");
+  case Z3_OP_FPA_NUM:
+    if (record.numArgs != 3)
+      throw std::runtime_error(
+          "Malformed floating-point numeral in binary log");
+    // Let the simplifier turn the components into a numeral.
+    return Z3_simplify(context_,
+                       Z3_mk_fpa_fp(context_, nodes_[args(record)[0]],
+                                    nodes_[args(record)[1]],
+                                    nodes_[args(record)[2]]));
+  default:
+    break;
+  }
+
+  std::vector<Z3_ast> arguments;
+  for (uint32_t i = 0; i < record.numArgs; i++)
+    arguments.push_back(nodes_[args(record)[i]]);
+  return Z3_mk_app(context_, declaration(record), arguments.size(),
+                   arguments.data());
+}
+
+Z3_func_decl BinaryLogReader::declaration(const NodeRecord &record) {
+  std::vector<uint32_t> sorts{record.sort};
+  std::vector<Z3_sort> argSorts;
+  for (uint32_t i = 0; i < record.numArgs; i++) {
+    sorts.push_back(nodeRecords_[args(record)[i]]->sort);
+    argSorts.push_back(sorts_[sorts.back()]);
+  }
+
+  auto key = std::make_tuple(
+      record.kind,
+      std::vector<uint32_t>(params(record),
+                            params(record) + record.numParams),
+      std::move(sorts));
+  if (auto it = declarations_.find(key); it != declarations_.end())
+    return it->second;
+
+  auto kind = static_cast<Z3_decl_kind>(record.kind);
+  auto *sort = sorts_[record.sort];
+  Z3_func_decl decl;
+  if (kind == Z3_OP_UNINTERPRETED) {
+    if (record.numParams < 1 || params(record)[0] >= strings_.size())
+      throw std::runtime_error("Malformed symbol in binary log");
+    auto symbol =
+        Z3_mk_string_symbol(context_, strings_[params(record)[0]].c_str());
+    decl = Z3_mk_func_decl(context_, symbol, argSorts.size(), argSorts.data(),
+                           sort);
+    Z3_inc_ref(context_, Z3_func_decl_to_ast(context_, decl));
+  } else {
+    if (record.numParams < numRequiredParams(kind))
+      throw std::runtime_error("Missing parameters of expression kind " +
+                               std::to_string(kind) + " in binary log");
+
+    // There is no API for creating interpreted declarations directly, so we
+    // build an expression over fresh constants and take its declaration.
+    std::vector<Z3_ast> sample;
+    for (auto *argSort : argSorts) {
+      sample.push_back(Z3_mk_fresh_const(context_, "arg", argSort));
+      Z3_inc_ref(context_, sample.back());
+    }
+    auto *expr = applyKind(context_, kind, params(record), sample, sort);
+    Z3_inc_ref(context_, expr);
+    for (auto *arg : sample)
+      Z3_dec_ref(context_, arg);
+
+    // The API builds n-ary operators from binary ones, but the simplifier
+    // flattens them.
+    if (Z3_get_app_num_args(context_, Z3_to_app(context_, expr)) !=
+        argSorts.size()) {
+      auto *simplified = Z3_simplify(context_, expr);
+      Z3_inc_ref(context_, simplified);
+      Z3_dec_ref(context_, expr);
+      expr = simplified;
+    }
+
+    auto *app = Z3_to_app(context_, expr);
+    decl = Z3_get_app_decl(context_, app);
+    Z3_inc_ref(context_, Z3_func_decl_to_ast(context_, decl));
+    bool matches = Z3_get_decl_kind(context_, decl) == publicKind(kind) &&
+                   Z3_get_app_num_args(context_, app) == argSorts.size();
+    Z3_dec_ref(context_, expr);
+    if (!matches) {
+      Z3_dec_ref(context_, Z3_func_decl_to_ast(context_, decl));
+      throw std::runtime_error("Can't rebuild expression kind " +
+                               std::to_string(kind) + " with " +
+                               std::to_string(argSorts.size()) +
+                               " arguments from binary log");
+    }
+  }
+
+  declarations_.emplace(std::move(key), decl);
+  return decl;
+}
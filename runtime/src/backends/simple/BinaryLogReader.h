@@ -0,0 +1,89 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BINARYLOGREADER_H
+#define BINARYLOGREADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <z3.h>
+
+#include "BinaryLogFormat.h"
+
+/// Reader for the binary log (see BinaryLogFormat.h for the format).
+///
+/// The log is mapped into memory, and expressions are rebuilt in the given Z3
+/// context directly from the node table. Each node is built at most once, so
+/// sub-expressions that queries share are shared in the result as well. All
+/// errors are reported as std::runtime_error.
+class BinaryLogReader {
+public:
+  struct Query {
+    uint64_t siteId;
+    int checkKind;
+    int context;
+    int taken;
+    std::string filename;
+    int line;
+    /// The assertions of the query; the reader holds a reference to each.
+    std::vector<Z3_ast> assertions;
+  };
+
+  BinaryLogReader(Z3_context context, const char *path);
+  ~BinaryLogReader();
+
+  BinaryLogReader(const BinaryLogReader &) = delete;
+  BinaryLogReader &operator=(const BinaryLogReader &) = delete;
+
+  size_t numQueries() const { return queries_.size(); }
+  Query query(size_t index);
+
+private:
+  /// Return the expression with the given node ID, building it (and all nodes
+  /// before it) if necessary.
+  Z3_ast node(uint32_t id);
+
+  Z3_ast buildNode(const binlog::NodeRecord &record);
+
+  /// Return the function declaration of an interpreted node, i.e., one that
+  /// isn't a numeral or an uninterpreted symbol.
+  Z3_func_decl declaration(const binlog::NodeRecord &record);
+
+  void indexRecords();
+
+  Z3_context context_;
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+
+  std::vector<std::string> strings_;
+  std::vector<Z3_sort> sorts_;
+  std::vector<const binlog::NodeRecord *> nodeRecords_;
+  std::vector<const binlog::QueryRecord *> queries_;
+
+  /// Expressions for the node IDs that have been built so far.
+  std::vector<Z3_ast> nodes_;
+
+  /// Declarations by kind, parameters, and result and argument sorts.
+  std::map<std::tuple<uint32_t, std::vector<uint32_t>, std::vector<uint32_t>>,
+           Z3_func_decl>
+      declarations_;
+};
+
+#endif
@@ -0,0 +1,198 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "ConstraintSlicer.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+/// Statistics across the slicers of all threads.
+std::atomic<uint64_t> g_queries{0};
+std::atomic<uint64_t> g_reused{0};
+std::atomic<uint64_t> g_dropped{0};
+
+} // namespace
+
+ConstraintSlicer::ConstraintSlicer(Z3_context context) : context_(context) {
+  sliced_ = Z3_mk_solver(context_);
+  Z3_solver_inc_ref(context_, sliced_);
+}
+
+ConstraintSlicer::~ConstraintSlicer() {
+  reset();
+  Z3_solver_dec_ref(context_, sliced_);
+}
+
+Z3_solver ConstraintSlicer::slice(Z3_solver solver) {
+  auto *assertions = Z3_solver_get_assertions(context_, solver);
+  Z3_ast_vector_inc_ref(context_, assertions);
+
+  auto numAssertions = Z3_ast_vector_size(context_, assertions);
+  if (numAssertions <= 1) {
+    Z3_ast_vector_dec_ref(context_, assertions);
+    return solver;
+  }
+
+  // If the known prefix isn't a prefix of the solver's assertions anymore
+  // (e.g., because the solver has been reset or has popped a scope), we have
+  // to start over. Since Z3 shares structurally equal expressions, comparing
+  // pointers is enough; it costs about as much as fetching the assertions.
+  unsigned prefixLength = numAssertions - 1;
+  bool known = prefix_.size() <= prefixLength;
+  for (size_t i = 0; known && i < prefix_.size(); i++)
+    known = Z3_ast_vector_get(context_, assertions, i) == prefix_[i];
+  if (!known)
+    reset();
+
+  g_queries++;
+  if (!prefix_.empty())
+    g_reused++;
+
+  for (auto i = prefix_.size(); i < prefixLength; i++)
+    addPathConstraint(Z3_ast_vector_get(context_, assertions, i));
+
+  auto *constraint = Z3_ast_vector_get(context_, assertions, prefixLength);
+  Z3_inc_ref(context_, constraint);
+  Z3_ast_vector_dec_ref(context_, assertions);
+
+  std::vector<unsigned> variables;
+  collectVariables(constraint, variables);
+  std::vector<unsigned> roots;
+  for (auto variable : variables) {
+    auto it = classes_.find(variable);
+    if (it != classes_.end())
+      roots.push_back(find(it->second));
+  }
+  std::sort(roots.begin(), roots.end());
+  roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+
+  std::vector<size_t> selected = groundConstraints_;
+  for (auto root : roots)
+    selected.insert(selected.end(), constraints_[root].begin(),
+                    constraints_[root].end());
+
+  g_dropped += prefixLength - selected.size();
+  if (selected.size() == prefixLength) {
+    Z3_dec_ref(context_, constraint);
+    return solver;
+  }
+
+  std::sort(selected.begin(), selected.end());
+  Z3_solver_reset(context_, sliced_);
+  for (auto index : selected)
+    Z3_solver_assert(context_, sliced_, prefix_[index]);
+  Z3_solver_assert(context_, sliced_, constraint);
+  Z3_dec_ref(context_, constraint);
+  return sliced_;
+}
+
+ConstraintSlicer::Stats ConstraintSlicer::stats() {
+  return {g_queries.load(), g_reused.load(), g_dropped.load()};
+}
+
+void ConstraintSlicer::addPathConstraint(Z3_ast constraint) {
+  Z3_inc_ref(context_, constraint);
+  auto index = prefix_.size();
+  prefix_.push_back(constraint);
+
+  std::vector<unsigned> variables;
+  collectVariables(constraint, variables);
+  if (variables.empty()) {
+    groundConstraints_.push_back(index);
+    return;
+  }
+
+  auto root = classOf(variables.front());
+  for (auto variable : variables)
+    root = unite(root, classOf(variable));
+  constraints_[root].push_back(index);
+}
+
+void ConstraintSlicer::reset() {
+  for (auto *constraint : prefix_)
+    Z3_dec_ref(context_, constraint);
+  prefix_.clear();
+  groundConstraints_.clear();
+  classes_.clear();
+  parent_.clear();
+  size_.clear();
+  constraints_.clear();
+}
+
+void ConstraintSlicer::collectVariables(Z3_ast expr,
+                                        std::vector<unsigned> &variables) {
+  visited_.clear();
+  stack_.assign(1, expr);
+  while (!stack_.empty()) {
+    auto *node = stack_.back();
+    stack_.pop_back();
+    if (!visited_.insert(Z3_get_ast_id(context_, node)).second ||
+        Z3_get_ast_kind(context_, node) != Z3_APP_AST)
+      continue;
+
+    auto *app = Z3_to_app(context_, node);
+    auto numArgs = Z3_get_app_num_args(context_, app);
+    auto *decl = Z3_get_app_decl(context_, app);
+    if (numArgs == 0 &&
+        Z3_get_decl_kind(context_, decl) == Z3_OP_UNINTERPRETED) {
+      variables.push_back(Z3_get_ast_id(context_, node));
+      continue;
+    }
+
+    for (unsigned i = 0; i < numArgs; i++)
+      stack_.push_back(Z3_get_app_arg(context_, app, i));
+  }
+}
+
+unsigned ConstraintSlicer::classOf(unsigned variable) {
+  auto [it, inserted] = classes_.try_emplace(variable, parent_.size());
+  if (inserted) {
+    parent_.push_back(it->second);
+    size_.push_back(1);
+    constraints_.emplace_back();
+  }
+  return it->second;
+}
+
+unsigned ConstraintSlicer::find(unsigned cls) {
+  while (parent_[cls] != cls) {
+    parent_[cls] = parent_[parent_[cls]];
+    cls = parent_[cls];
+  }
+  return cls;
+}
+
+unsigned ConstraintSlicer::unite(unsigned a, unsigned b) {
+  a = find(a);
+  b = find(b);
+  if (a == b)
+    return a;
+
+  if (size_[a] < size_[b])
+    std::swap(a, b);
+  parent_[b] = a;
+  size_[a] += size_[b];
+
+  auto &absorbed = constraints_[b];
+  if (constraints_[a].size() < absorbed.size())
+    std::swap(constraints_[a], absorbed);
+  constraints_[a].insert(constraints_[a].end(), absorbed.begin(),
+                         absorbed.end());
+  absorbed.clear();
+  absorbed.shrink_to_fit();
+  return a;
+}
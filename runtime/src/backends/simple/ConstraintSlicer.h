@@ -0,0 +1,108 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CONSTRAINTSLICER_H
+#define CONSTRAINTSLICER_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <z3.h>
+
+//
+// Constraint independence slicing. A query only needs the path constraints
+// that share variables with the new constraint, directly or through other
+// path constraints; all others are satisfied by the current input anyway.
+//
+// We partition the variables of the path prefix with a union-find structure,
+// where each class also knows the path constraints that mention its
+// variables. The prefix in the solver only grows between queries (the new
+// constraint is pushed and popped each time), so we extend the partition
+// incrementally and start over only if the prefix has changed otherwise
+// (e.g., when the solver is reset). The runtime keeps a path prefix in the
+// solver only if SYMCC_KEEP_PATH_PREFIX is set; otherwise, each query
+// consists of the new constraint alone and there is nothing to slice.
+//
+
+class ConstraintSlicer {
+public:
+  explicit ConstraintSlicer(Z3_context context);
+  ~ConstraintSlicer();
+
+  ConstraintSlicer(const ConstraintSlicer &) = delete;
+  ConstraintSlicer &operator=(const ConstraintSlicer &) = delete;
+
+  /// Return a solver that contains the last assertion of the given solver,
+  /// preceded by the path constraints that it depends on (in their original
+  /// order). If it depends on all of them, we return the given solver.
+  Z3_solver slice(Z3_solver solver);
+
+  struct Stats {
+    /// Queries with a path prefix.
+    uint64_t queries;
+    /// Queries that extended the partition of an earlier query instead of
+    /// starting over.
+    uint64_t reused;
+    /// Path constraints that we removed from queries.
+    uint64_t dropped;
+  };
+
+  /// Return the statistics of all slicers.
+  static Stats stats();
+
+private:
+  /// Add the path constraint to the partition.
+  void addPathConstraint(Z3_ast constraint);
+
+  /// Forget the prefix.
+  void reset();
+
+  /// Collect the IDs of the variables in the expression.
+  void collectVariables(Z3_ast expr, std::vector<unsigned> &variables);
+
+  /// Return the class of the variable, creating a new class if necessary.
+  unsigned classOf(unsigned variable);
+  unsigned find(unsigned cls);
+  unsigned unite(unsigned a, unsigned b);
+
+  Z3_context context_;
+
+  /// The solver that receives sliced queries.
+  Z3_solver sliced_;
+
+  /// The path prefix that the partition describes (each with a reference).
+  std::vector<Z3_ast> prefix_;
+
+  /// Indices into prefix_ of the path constraints without variables, which
+  /// every query needs.
+  std::vector<size_t> groundConstraints_;
+
+  /// Classes by variable AST ID.
+  std::unordered_map<unsigned, unsigned> classes_;
+
+  /// The union-find forest, with the size of each tree and the indices of
+  /// the path constraints that each root's class constrains.
+  std::vector<unsigned> parent_;
+  std::vector<unsigned> size_;
+  std::vector<std::vector<size_t>> constraints_;
+
+  /// Scratch space for traversals.
+  std::vector<Z3_ast> stack_;
+  std::unordered_set<unsigned> visited_;
+};
+
+#endif
@@ -0,0 +1,132 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "DeltaLog.h"
+
+#include "AsyncLog.h"
+
+#include <cinttypes>
+#include <sstream>
+
+DeltaLogWriter::DeltaLogWriter(Z3_context context, FILE *log)
+    : context_(context), log_(log) {
+  printer_ = Z3_mk_simple_solver(context_);
+  Z3_solver_inc_ref(context_, printer_);
+
+  fprintf(log_, "Format:delta\n");
+  commitLogDefinitions(log_);
+}
+
+DeltaLogWriter::~DeltaLogWriter() {
+  for (auto *assertion : loggedAssertions_)
+    Z3_dec_ref(context_, assertion);
+  Z3_solver_dec_ref(context_, printer_);
+}
+
+void DeltaLogWriter::logQuery(Z3_solver solver, uint64_t site_id,
+                              int check_kind, int taken, const char *filename,
+                              int line, int thread_id) {
+  auto *assertions = Z3_solver_get_assertions(context_, solver);
+  Z3_ast_vector_inc_ref(context_, assertions);
+
+  auto numAssertions = Z3_ast_vector_size(context_, assertions);
+  if (numAssertions == 0) {
+    Z3_ast_vector_dec_ref(context_, assertions);
+    return;
+  }
+
+  auto prefixId = internPrefix(assertions, numAssertions - 1);
+  auto smt = renderAssertion(
+      Z3_ast_vector_get(context_, assertions, numAssertions - 1));
+  Z3_ast_vector_dec_ref(context_, assertions);
+
+  // Later queries refer to the declarations, assertions and prefixes that we
+  // have just written, so they must reach the log even if this query doesn't.
+  commitLogDefinitions(log_);
+
+  fprintf(log_,
+          "Trying to solve:\nLocation:%016" PRIx64
+          ".%d.%ld.%d.%s.%d\nPrefix:%zu\nSMT:%s\n====end of smt====\n",
+          site_id, check_kind, static_cast<long>(thread_id), taken, filename,
+          line, prefixId, smt.c_str());
+  commitLogRecord(log_);
+}
+
+size_t DeltaLogWriter::internPrefix(Z3_ast_vector assertions,
+                                    unsigned length) {
+  // Most of the time, the prefix of a query extends the prefix of the previous
+  // query, so we only need to look at the assertions that differ.
+  unsigned common = 0;
+  while (common < length && common < currentPrefix_.size() &&
+         currentPrefix_[common].first ==
+             Z3_get_ast_id(context_,
+                           Z3_ast_vector_get(context_, assertions, common)))
+    common++;
+  currentPrefix_.resize(common);
+
+  for (unsigned i = common; i < length; i++) {
+    auto *assertion = Z3_ast_vector_get(context_, assertions, i);
+    size_t parentId = currentPrefix_.empty() ? 0 : currentPrefix_.back().second;
+    auto assertionId = internAssertion(assertion);
+
+    auto [prefixIt, inserted] = prefixIds_.try_emplace(
+        {parentId, assertionId}, prefixIds_.size() + 1);
+    if (inserted)
+      fprintf(log_, "PathPrefix:%zu.%zu.%zu\n", prefixIt->second, parentId,
+              assertionId);
+
+    currentPrefix_.emplace_back(Z3_get_ast_id(context_, assertion),
+                                prefixIt->second);
+  }
+
+  return currentPrefix_.empty() ? 0 : currentPrefix_.back().second;
+}
+
+size_t DeltaLogWriter::internAssertion(Z3_ast assertion) {
+  auto [assertionIt, inserted] = assertionIds_.try_emplace(
+      Z3_get_ast_id(context_, assertion), assertionIds_.size());
+  if (!inserted)
+    return assertionIt->second;
+
+  Z3_inc_ref(context_, assertion);
+  loggedAssertions_.push_back(assertion);
+
+  auto smt = renderAssertion(assertion);
+  fprintf(log_, "Assertion:%zu\n%s\n====end of smt====\n", assertionIt->second,
+          smt.c_str());
+  return assertionIt->second;
+}
+
+std::string DeltaLogWriter::renderAssertion(Z3_ast assertion) {
+  Z3_solver_reset(context_, printer_);
+  Z3_solver_assert(context_, printer_, assertion);
+
+  // Z3 prints the declarations first, one per line, followed by the assertion.
+  std::istringstream rendered(Z3_solver_to_string(context_, printer_));
+  std::string smt, line;
+  while (std::getline(rendered, line)) {
+    if (line.rfind("(declare-", 0) == 0) {
+      if (declarations_.insert(line).second)
+        fprintf(log_, "Declare:%s\n", line.c_str());
+      continue;
+    }
+
+    if (!smt.empty())
+      smt += '\n';
+    smt += line;
+  }
+
+  return smt;
+}
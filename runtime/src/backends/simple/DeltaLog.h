@@ -0,0 +1,103 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef DELTALOG_H
+#define DELTALOG_H
+
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <z3.h>
+
+//
+// The delta log is an alternative to dumping the entire solver on every
+// query. Declarations and the constraints that make up the path prefix are
+// written only once, each with an ID; a query then names its prefix and adds
+// the single new constraint. The log consists of the following records:
+//
+//   Declare:<declaration>
+//   Assertion:<assertion id>
+//   <SMT-LIB assert command>
+//   ====end of smt====
+//   PathPrefix:<prefix id>.<parent prefix id>.<assertion id>
+//   Trying to solve:
+//   Location:<site>.<check>.<context>.<taken>.<file>.<line>
+//   Prefix:<prefix id>
+//   SMT:<SMT-LIB assert command>
+//   ====end of smt====
+//
+// Prefix 0 is the empty prefix. A prefix is its parent followed by one more
+// assertion, so any query can be rebuilt by following the chain of parents
+// (see util/rebuild_query.py). The site is the 16-digit hexadecimal site ID,
+// and the check is the kind of check that the branch implements (0 for
+// ordinary branches). The context is the ID of the thread that made the
+// query, which is always 0 unless the runtime is thread-safe; prefixes are
+// shared between threads.
+//
+
+class DeltaLogWriter {
+public:
+  DeltaLogWriter(Z3_context context, FILE *log);
+  ~DeltaLogWriter();
+
+  DeltaLogWriter(const DeltaLogWriter &) = delete;
+  DeltaLogWriter &operator=(const DeltaLogWriter &) = delete;
+
+  /// Log the query that is currently in the solver.
+  ///
+  /// The last assertion is the new constraint of the query; everything before
+  /// it is the path prefix. The thread ID goes into the context field.
+  void logQuery(Z3_solver solver, uint64_t site_id, int check_kind, int taken,
+                const char *filename, int line, int thread_id);
+
+private:
+  /// Return the ID of the prefix consisting of the first "length" assertions,
+  /// writing any prefix and assertion records that are still missing.
+  size_t internPrefix(Z3_ast_vector assertions, unsigned length);
+
+  /// Return the ID of the assertion, writing its record if necessary.
+  size_t internAssertion(Z3_ast assertion);
+
+  /// Render the assertion as an SMT-LIB command, writing declarations for any
+  /// constants that the log doesn't know about yet.
+  std::string renderAssertion(Z3_ast assertion);
+
+  Z3_context context_;
+  FILE *log_;
+
+  /// A solver that we use for printing single assertions in the same way that
+  /// the SMT log prints the whole solver.
+  Z3_solver printer_;
+
+  /// Declarations that have been written already.
+  std::set<std::string> declarations_;
+
+  /// Mapping from Z3 AST IDs to assertion IDs. We hold a reference to each
+  /// logged assertion, so the AST IDs can't be reused.
+  std::map<unsigned, size_t> assertionIds_;
+  std::vector<Z3_ast> loggedAssertions_;
+
+  /// Mapping from (parent prefix, assertion) to prefix IDs.
+  std::map<std::pair<size_t, size_t>, size_t> prefixIds_;
+
+  /// The prefix of the last query as (AST ID, prefix ID) for each assertion.
+  std::vector<std::pair<unsigned, size_t>> currentPrefix_;
+};
+
+#endif
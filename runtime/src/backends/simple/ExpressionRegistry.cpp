@@ -0,0 +1,86 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "ExpressionRegistry.h"
+
+namespace {
+
+/// The number of index bits of the smallest table.
+constexpr unsigned kInitialBits = 12;
+
+} // namespace
+
+ExpressionRegistry::ExpressionRegistry()
+    : slots_(size_t(1) << kInitialBits), shift_(64 - kInitialBits) {}
+
+void ExpressionRegistry::grow() {
+  std::vector<Z3_ast> old(slots_.size() * 2);
+  old.swap(slots_);
+  shift_--;
+
+  for (auto *expr : old) {
+    if (expr != nullptr)
+      place(expr);
+  }
+}
+
+bool ExpressionRegistry::erase(Z3_ast expr) {
+  auto mask = slots_.size() - 1;
+  auto index = slotOf(expr);
+  while (slots_[index] != expr) {
+    if (slots_[index] == nullptr)
+      return false;
+    index = (index + 1) & mask;
+  }
+
+  // Move later entries of the probe sequence into the gap, so that lookups
+  // don't stop at it; an entry can fill the gap unless its home slot lies
+  // (cyclically) between the gap and the entry.
+  auto gap = index;
+  for (auto next = (gap + 1) & mask; slots_[next] != nullptr;
+       next = (next + 1) & mask) {
+    auto home = slotOf(slots_[next]);
+    if (((next - home) & mask) >= ((next - gap) & mask)) {
+      slots_[gap] = slots_[next];
+      gap = next;
+    }
+  }
+
+  slots_[gap] = nullptr;
+  used_--;
+  return true;
+}
+
+void ExpressionRegistry::rebuild(const std::vector<Z3_ast> &exprs) {
+  // Keep the load at or below a quarter, so that the table doesn't grow again
+  // right away.
+  unsigned bits = kInitialBits;
+  while ((size_t(1) << bits) < exprs.size() * 4)
+    bits++;
+
+  slots_.assign(size_t(1) << bits, nullptr);
+  shift_ = 64 - bits;
+  used_ = exprs.size();
+
+  for (auto *expr : exprs)
+    place(expr);
+}
+
+void ExpressionRegistry::place(Z3_ast expr) {
+  auto index = slotOf(expr);
+  while (slots_[index] != nullptr)
+    index = (index + 1) & (slots_.size() - 1);
+  slots_[index] = expr;
+}
@@ -0,0 +1,114 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef EXPRESSIONREGISTRY_H
+#define EXPRESSIONREGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <z3.h>
+
+//
+// The set of expressions that we have passed to client code, each of which
+// holds a reference. Every call to an expression builder checks whether its
+// result is in the set already, so the check is on the hottest path of the
+// runtime.
+//
+// Z3 hash-conses expressions, so equal expressions are the same pointer, and
+// a set of pointers is all we need. We use an open-addressing table with
+// linear probing: a lookup is a multiplication, a shift and usually a single
+// probe, and an entry takes 8 bytes (16 at the maximum load factor) instead
+// of the 40-byte node of a search tree. Minor garbage collections delete
+// individual expressions; full collections sweep the whole set anyway, so
+// they rebuild the table with the expressions that survive, which also
+// shrinks it.
+//
+
+class ExpressionRegistry {
+public:
+  ExpressionRegistry();
+
+  /// Add the expression, returning false if it was present already.
+  bool insert(Z3_ast expr) {
+    for (auto index = slotOf(expr);;
+         index = (index + 1) & (slots_.size() - 1)) {
+      auto *slot = slots_[index];
+      if (slot == expr)
+        return false;
+
+      if (slot == nullptr) {
+        if ((used_ + 1) * 2 > slots_.size()) {
+          grow();
+          return insert(expr);
+        }
+
+        slots_[index] = expr;
+        used_++;
+        return true;
+      }
+    }
+  }
+
+  /// Remove the expression, returning false if it wasn't present.
+  bool erase(Z3_ast expr);
+
+  /// The number of expressions in the set.
+  size_t size() const { return used_; }
+
+  /// Remove the expressions for which the predicate returns true, and return
+  /// their number.
+  template <typename F> size_t removeIf(F &&predicate) {
+    std::vector<Z3_ast> kept;
+    kept.reserve(used_);
+    for (auto *expr : slots_) {
+      if (expr != nullptr && !predicate(expr))
+        kept.push_back(expr);
+    }
+
+    auto removed = used_ - kept.size();
+    rebuild(kept);
+    return removed;
+  }
+
+private:
+  size_t slotOf(Z3_ast expr) const {
+    // Multiplying by an odd constant is a bijection, and the high bits of the
+    // product depend on all bits of the pointer (including the low ones that
+    // alignment keeps constant).
+    return (uint64_t(reinterpret_cast<uintptr_t>(expr)) *
+            0x9e3779b97f4a7c15ULL) >>
+           shift_;
+  }
+
+  /// Double the size of the table.
+  void grow();
+
+  /// Fill a table of suitable size with the given expressions.
+  void rebuild(const std::vector<Z3_ast> &exprs);
+
+  /// Insert an expression that isn't in the table, without checking the load.
+  void place(Z3_ast expr);
+
+  /// The table, with a power-of-two size; we use the top bits of the hash as
+  /// the index, so shift_ is 64 minus the number of index bits. Null marks an
+  /// empty slot.
+  std::vector<Z3_ast> slots_;
+  unsigned shift_;
+  size_t used_ = 0;
+};
+
+#endif
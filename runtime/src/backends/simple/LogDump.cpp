@@ -0,0 +1,66 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+//
+// Print a binary log in the text format of the simple backend, i.e., exactly
+// the log that the program would have written with SYMCC_LOG_FORMAT=smt.
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <exception>
+
+#include <z3.h>
+
+#include "BinaryLogReader.h"
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <binary log>\n", argv[0]);
+    return 1;
+  }
+
+  auto *config = Z3_mk_config();
+  auto *context = Z3_mk_context_rc(config);
+  Z3_del_config(config);
+
+  int result = 0;
+  try {
+    BinaryLogReader reader(context, argv[1]);
+
+    auto *solver = Z3_mk_solver(context);
+    Z3_solver_inc_ref(context, solver);
+    for (size_t i = 0; i < reader.numQueries(); i++) {
+      auto query = reader.query(i);
+
+      Z3_solver_reset(context, solver);
+      for (auto *assertion : query.assertions)
+        Z3_solver_assert(context, solver, assertion);
+
+      printf("Trying to solve:\nLocation:%016" PRIx64
+             ".%d.%ld.%d.%s.%d\nSMT:%s\n====end of smt====\n",
+             query.siteId, query.checkKind, static_cast<long>(query.context),
+             query.taken, query.filename.c_str(), query.line,
+             Z3_solver_to_string(context, solver));
+    }
+    Z3_solver_dec_ref(context, solver);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+    result = 1;
+  }
+
+  Z3_del_context(context);
+  return result;
+}
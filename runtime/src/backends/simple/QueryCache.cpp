@@ -0,0 +1,344 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "QueryCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'Y', 'M', 'Q', 'C', 'A', 'C', '1'};
+
+/// The number of slots in a new table (a power of two).
+constexpr uint64_t kInitialCapacity = 1 << 16;
+
+/// Tags that keep different kinds of nodes from hashing alike.
+enum NodeTag : uint64_t { kApplication = 1, kConstant, kLeaf };
+
+/// The finalizer of MurmurHash3, which mixes all input bits into all output
+/// bits.
+uint64_t fmix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace
+
+QueryCache::QueryCache(const std::string &fileName) {
+  if (fileName.empty()) {
+    map(kInitialCapacity);
+    std::memcpy(header_->magic, kMagic, sizeof(kMagic));
+    header_->capacity = kInitialCapacity;
+    return;
+  }
+
+  fd_ = open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    perror("Failed to open the query cache");
+    exit(-1);
+  }
+
+  lock();
+  struct stat fileStat;
+  if (fstat(fd_, &fileStat) != 0) {
+    perror("Failed to open the query cache");
+    exit(-1);
+  }
+
+  if (fileStat.st_size == 0) {
+    if (ftruncate(fd_, tableBytes(kInitialCapacity)) != 0) {
+      perror("Failed to create the query cache");
+      exit(-1);
+    }
+    map(kInitialCapacity);
+    std::memcpy(header_->magic, kMagic, sizeof(kMagic));
+    header_->capacity = kInitialCapacity;
+  } else {
+    Header header;
+    if (pread(fd_, &header, sizeof(header), 0) != sizeof(header) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.capacity == 0 ||
+        (header.capacity & (header.capacity - 1)) != 0 ||
+        static_cast<uint64_t>(fileStat.st_size) <
+            tableBytes(header.capacity)) {
+      std::cerr << "Error: " << fileName << " is not a query cache"
+                << std::endl;
+      exit(-1);
+    }
+    map(header.capacity);
+  }
+  unlock();
+}
+
+QueryCache::~QueryCache() {
+  unmap();
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool QueryCache::checkAndInsert(Z3_context context, Z3_solver solver) {
+  auto key = hashQuery(context, solver);
+
+  lock();
+  if (header_->capacity != mappedCapacity_) {
+    // Another process has grown the table.
+    auto capacity = header_->capacity;
+    unmap();
+    map(capacity);
+  }
+  bool inserted = insert(key);
+  unlock();
+
+  if (inserted)
+    misses_++;
+  else
+    hits_++;
+  return !inserted;
+}
+
+QueryCache::Key QueryCache::hashQuery(Z3_context context, Z3_solver solver) {
+  auto *assertions = Z3_solver_get_assertions(context, solver);
+  Z3_ast_vector_inc_ref(context, assertions);
+
+  auto numAssertions = Z3_ast_vector_size(context, assertions);
+  Key key{fmix(numAssertions), fmix(~uint64_t(numAssertions))};
+  for (unsigned i = 0; i < numAssertions; i++) {
+    auto assertionKey =
+        hashExpression(context, Z3_ast_vector_get(context, assertions, i));
+    key = {fmix(key.lo ^ assertionKey.lo), fmix(key.hi + assertionKey.hi)};
+  }
+  Z3_ast_vector_dec_ref(context, assertions);
+  expressionHashes_.clear();
+
+  // The empty key marks free slots.
+  if (key.lo == 0 && key.hi == 0)
+    key.lo = 1;
+  return key;
+}
+
+QueryCache::Key QueryCache::hashExpression(Z3_context context, Z3_ast expr) {
+  // Two independent lanes of 64 bits each.
+  auto update = [](Key &key, uint64_t value) {
+    key.lo = fmix(key.lo ^ value);
+    key.hi = fmix(key.hi + value * 0x9e3779b97f4a7c15ULL);
+  };
+  auto updateString = [&](Key &key, const char *str) {
+    size_t length = std::strlen(str);
+    update(key, length);
+    for (size_t i = 0; i < length; i += sizeof(uint64_t)) {
+      uint64_t chunk = 0;
+      std::memcpy(&chunk, str + i, std::min(length - i, sizeof(uint64_t)));
+      update(key, chunk);
+    }
+  };
+  auto updateSort = [&](Key &key, Z3_sort sort) {
+    auto kind = Z3_get_sort_kind(context, sort);
+    update(key, kind);
+    if (kind == Z3_BV_SORT) {
+      update(key, Z3_get_bv_sort_size(context, sort));
+    } else if (kind == Z3_FLOATING_POINT_SORT) {
+      update(key, Z3_fpa_get_ebits(context, sort));
+      update(key, Z3_fpa_get_sbits(context, sort));
+    }
+  };
+
+  // Expressions can be very deep, so we use an explicit stack for the
+  // post-order traversal. The flag indicates whether the arguments of the node
+  // have been pushed already.
+  std::vector<std::pair<Z3_ast, bool>> stack{{expr, false}};
+  while (!stack.empty()) {
+    auto [node, expanded] = stack.back();
+    auto id = Z3_get_ast_id(context, node);
+    if (expressionHashes_.count(id) != 0) {
+      stack.pop_back();
+      continue;
+    }
+
+    Key key{0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL};
+    if (Z3_get_ast_kind(context, node) != Z3_APP_AST ||
+        Z3_get_app_num_args(context, Z3_to_app(context, node)) == 0) {
+      auto *decl = Z3_get_ast_kind(context, node) == Z3_APP_AST
+                       ? Z3_get_app_decl(context, Z3_to_app(context, node))
+                       : nullptr;
+      if (decl != nullptr &&
+          Z3_get_decl_kind(context, decl) == Z3_OP_UNINTERPRETED) {
+        // Z3 prints constants with unusual names in quotes, so we use the
+        // name directly.
+        auto symbol = Z3_get_decl_name(context, decl);
+        update(key, kConstant);
+        if (Z3_get_symbol_kind(context, symbol) == Z3_STRING_SYMBOL)
+          updateString(key, Z3_get_symbol_string(context, symbol));
+        else
+          update(key, Z3_get_symbol_int(context, symbol));
+      } else {
+        // Numerals and other leaves are short when printed.
+        update(key, kLeaf);
+        updateString(key, Z3_ast_to_string(context, node));
+      }
+      updateSort(key, Z3_get_sort(context, node));
+      expressionHashes_.emplace(id, key);
+      stack.pop_back();
+      continue;
+    }
+
+    auto *app = Z3_to_app(context, node);
+    auto numArgs = Z3_get_app_num_args(context, app);
+    if (!expanded) {
+      stack.back().second = true;
+      for (unsigned i = numArgs; i > 0; i--) {
+        auto *arg = Z3_get_app_arg(context, app, i - 1);
+        if (expressionHashes_.count(Z3_get_ast_id(context, arg)) == 0)
+          stack.emplace_back(arg, false);
+      }
+      continue;
+    }
+
+    stack.pop_back();
+    auto *decl = Z3_get_app_decl(context, app);
+    auto kind = Z3_get_decl_kind(context, decl);
+    update(key, kApplication);
+    update(key, kind);
+    if (kind == Z3_OP_UNINTERPRETED)
+      updateString(key, Z3_func_decl_to_string(context, decl));
+    auto numParams = Z3_get_decl_num_parameters(context, decl);
+    for (unsigned i = 0; i < numParams; i++) {
+      if (Z3_get_decl_parameter_kind(context, decl, i) == Z3_PARAMETER_INT)
+        update(key, Z3_get_decl_int_parameter(context, decl, i));
+    }
+    updateSort(key, Z3_get_sort(context, node));
+    update(key, numArgs);
+    for (unsigned i = 0; i < numArgs; i++) {
+      const auto &argKey = expressionHashes_.at(
+          Z3_get_ast_id(context, Z3_get_app_arg(context, app, i)));
+      update(key, argKey.lo);
+      update(key, argKey.hi);
+    }
+    expressionHashes_.emplace(id, key);
+  }
+
+  return expressionHashes_.at(Z3_get_ast_id(context, expr));
+}
+
+bool QueryCache::insert(Key key) {
+  if ((header_->size + 1) * 2 > header_->capacity)
+    grow();
+
+  auto mask = header_->capacity - 1;
+  auto *table = slots();
+  for (auto index = key.lo & mask;; index = (index + 1) & mask) {
+    if (table[index] == key)
+      return false;
+
+    if (table[index].lo == 0 && table[index].hi == 0) {
+      table[index] = key;
+      header_->size++;
+      return true;
+    }
+  }
+}
+
+void QueryCache::grow() {
+  std::vector<Key> keys;
+  keys.reserve(header_->size);
+  for (uint64_t i = 0; i < header_->capacity; i++) {
+    if (slots()[i].lo != 0 || slots()[i].hi != 0)
+      keys.push_back(slots()[i]);
+  }
+
+  auto capacity = header_->capacity * 2;
+  unmap();
+  if (fd_ >= 0 && ftruncate(fd_, tableBytes(capacity)) != 0) {
+    perror("Failed to grow the query cache");
+    exit(-1);
+  }
+  map(capacity);
+
+  std::memcpy(header_->magic, kMagic, sizeof(kMagic));
+  header_->capacity = capacity;
+  header_->size = 0;
+  std::memset(slots(), 0, capacity * sizeof(Key));
+  for (const auto &key : keys) {
+    [[maybe_unused]] bool inserted = insert(key);
+    assert(inserted && "Keys in the old table must be unique");
+  }
+}
+
+size_t QueryCache::tableBytes(uint64_t capacity) {
+  return sizeof(Header) + capacity * sizeof(Key);
+}
+
+void QueryCache::map(uint64_t capacity) {
+  void *memory =
+      fd_ >= 0 ? mmap(nullptr, tableBytes(capacity), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd_, 0)
+               : mmap(nullptr, tableBytes(capacity), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    perror("Failed to map the query cache");
+    exit(-1);
+  }
+
+  header_ = static_cast<Header *>(memory);
+  mappedCapacity_ = capacity;
+}
+
+void QueryCache::unmap() {
+  if (header_ == nullptr)
+    return;
+
+  munmap(header_, tableBytes(mappedCapacity_));
+  header_ = nullptr;
+  mappedCapacity_ = 0;
+}
+
+void QueryCache::lock() {
+  if (fd_ < 0)
+    return;
+
+  // Record locks (unlike flock) aren't shared with forked children, so
+  // processes of the same family exclude each other too.
+  struct flock lock {};
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  while (fcntl(fd_, F_SETLKW, &lock) != 0 && errno == EINTR)
+    ;
+}
+
+void QueryCache::unlock() {
+  if (fd_ < 0)
+    return;
+
+  struct flock lock {};
+  lock.l_type = F_UNLCK;
+  lock.l_whence = SEEK_SET;
+  fcntl(fd_, F_SETLK, &lock);
+}
@@ -0,0 +1,113 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <z3.h>
+
+//
+// A cache of the queries that we have already emitted, so that we don't log
+// or solve the same query again when a program executes the same branch over
+// and over (e.g., in loops). Queries are identified by a 128-bit structural
+// hash of all assertions in the solver, which doesn't depend on Z3's internal
+// IDs and is therefore stable across executions.
+//
+// The keys live in an open-addressing hash table with linear probing. The
+// table is either anonymous memory or a file that is mapped into memory, in
+// which case it survives the execution and can be shared by all executions of
+// a campaign; processes lock the file while they access the table.
+//
+
+class QueryCache {
+public:
+  /// Create an in-memory cache if the file name is empty, or use the cache
+  /// stored in the file otherwise (creating it if necessary).
+  explicit QueryCache(const std::string &fileName);
+  ~QueryCache();
+
+  QueryCache(const QueryCache &) = delete;
+  QueryCache &operator=(const QueryCache &) = delete;
+
+  /// Check whether we have seen the query that is currently in the solver,
+  /// and remember it if we haven't.
+  bool checkAndInsert(Z3_context context, Z3_solver solver);
+
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+  Stats stats() const { return {hits_, misses_}; }
+
+private:
+  struct Key {
+    uint64_t lo;
+    uint64_t hi;
+
+    bool operator==(const Key &other) const {
+      return lo == other.lo && hi == other.hi;
+    }
+  };
+
+  /// The beginning of the table; the slots follow immediately.
+  struct Header {
+    char magic[8];
+    uint64_t capacity;
+    uint64_t size;
+  };
+
+  Key hashQuery(Z3_context context, Z3_solver solver);
+  Key hashExpression(Z3_context context, Z3_ast expr);
+
+  /// Insert the key, returning false if it was present already.
+  bool insert(Key key);
+
+  /// Double the capacity of the table.
+  void grow();
+
+  /// Map the table with the given capacity, backed by the file if we have
+  /// one.
+  void map(uint64_t capacity);
+  void unmap();
+
+  static size_t tableBytes(uint64_t capacity);
+
+  void lock();
+  void unlock();
+
+  Key *slots() const { return reinterpret_cast<Key *>(header_ + 1); }
+
+  /// The cache file, or -1 if the cache is in memory.
+  int fd_ = -1;
+
+  Header *header_ = nullptr;
+  /// The capacity of the current mapping; another process may have grown the
+  /// table in the meantime.
+  uint64_t mappedCapacity_ = 0;
+
+  /// Hashes of the subexpressions of the current query, by AST ID.
+  std::unordered_map<unsigned, Key> expressionHashes_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+#endif
@@ -18,29 +18,38 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cinttypes>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
-#include <set>
+#include <mutex>
 #include <vector>
 
-#ifndef NDEBUG
-#include <chrono>
-#endif
+#include <pthread.h>
+#include <sys/stat.h>
 
+#include "AsyncLog.h"
+#include "BinaryLog.h"
+#include "Concurrency.h"
 #include "Config.h"
+#include "ConstraintSlicer.h"
+#include "DeltaLog.h"
+#include "ExpressionRegistry.h"
 #include "GarbageCollection.h"
 #include "LibcWrappers.h"
+#include "QueryCache.h"
 #include "Shadow.h"
+#include "SiteBudget.h"
+#include "Sites.h"
+#include "SolverPool.h"
 
 #ifndef NDEBUG
 // Helper to print pointers properly.
 #define P(ptr) reinterpret_cast<void *>(ptr)
 #endif
 
-#define FSORT(is_double)                                                       \
-  ((is_double) ? Z3_mk_fpa_sort_double(g_context)                              \
-               : Z3_mk_fpa_sort_single(g_context))
+#define FSORT(is_double) ((is_double) ? g_double_sort : g_float_sort)
 
 /* TODO Eventually we'll want to inline as much of this as possible. I'm keeping
    it in C for now because that makes it easier to experiment with new features,
@@ -58,24 +67,91 @@ Z3_context g_context;
 /// The global floating-point rounding mode.
 Z3_ast g_rounding_mode;
 
-/// The global Z3 solver.
-Z3_solver g_solver; // TODO make thread-local
+/// The floating-point sorts, and the bit-vector sorts by width (created on
+/// demand). We hold a reference to each, so the builders can use them without
+/// asking Z3 to look them up every time.
+Z3_sort g_float_sort, g_double_sort;
+Z3_sort g_bv_sorts[256];
+
+Z3_sort bvSort(uint8_t bits) {
+  auto &sort = g_bv_sorts[bits];
+  if (sort == nullptr) {
+    sort = Z3_mk_bv_sort(g_context, bits);
+    Z3_inc_ref(g_context, Z3_sort_to_ast(g_context, sort));
+  }
+  return sort;
+}
+
+/// If the expression is an extract, return its argument and store the bounds;
+/// otherwise, return null.
+Z3_ast extractSource(Z3_ast expr, unsigned *first_bit, unsigned *last_bit) {
+  if (Z3_get_ast_kind(g_context, expr) != Z3_APP_AST)
+    return nullptr;
+
+  auto *app = Z3_to_app(g_context, expr);
+  auto *decl = Z3_get_app_decl(g_context, app);
+  if (Z3_get_decl_kind(g_context, decl) != Z3_OP_EXTRACT)
+    return nullptr;
+
+  *first_bit = Z3_get_decl_int_parameter(g_context, decl, 0);
+  *last_bit = Z3_get_decl_int_parameter(g_context, decl, 1);
+  return Z3_get_app_arg(g_context, app, 0);
+}
+
+/// Z3 contexts aren't thread-safe, so threads take turns in the backend. The
+/// builders call each other, hence the recursive mutex.
+RecursiveRuntimeMutex g_backend_mutex;
+
+#define LOCK_BACKEND()                                                         \
+  std::lock_guard<RecursiveRuntimeMutex> backendLock(g_backend_mutex)
+
+/// The Z3 solver with the path constraints of the current thread; each thread
+/// follows its own path.
+SYMCC_THREAD_LOCAL Z3_solver g_solver;
+
+/// The number of the current thread, which tags its queries in the log, and
+/// the number of the next thread that uses the solver.
+SYMCC_THREAD_LOCAL int g_thread_id;
+std::atomic<int> g_next_thread_id{0};
 
 // Some global constants for efficiency.
 Z3_ast g_null_pointer, g_true, g_false;
 
-std::vector<Z3_ast> string_eq_constraints;
-std::vector<Z3_ast> string_not_eq_constraints;
-bool string_taken;
+SYMCC_THREAD_LOCAL std::vector<Z3_ast> string_eq_constraints;
+SYMCC_THREAD_LOCAL std::vector<Z3_ast> string_not_eq_constraints;
+SYMCC_THREAD_LOCAL bool string_taken;
 
 FILE *g_log = stderr;
 
+/// The writer for the delta log format, if enabled.
+DeltaLogWriter *g_delta_log = nullptr;
+
+/// The writer for the binary log format, if enabled. It owns the log file,
+/// and g_log remains available for diagnostics.
+BinaryLogWriter *g_binary_log = nullptr;
+
+/// The per-site query limit, if enabled.
+SiteBudget *g_site_budget = nullptr;
+
+/// The slicer that removes independent path constraints from queries, if we
+/// keep a path prefix but don't log all of it. It follows the solver of the
+/// current thread.
+SYMCC_THREAD_LOCAL ConstraintSlicer *g_slicer = nullptr;
+
+/// The cache of queries that we have emitted already, if enabled.
+QueryCache *g_query_cache = nullptr;
+
+/// The background solver threads, if enabled. They replace the query log.
+SolverPool *g_solver_pool = nullptr;
+
 #ifndef NDEBUG
 [[maybe_unused]] void dump_known_regions() {
   std::cerr << "Known regions:" << std::endl;
-  for (const auto &[page, shadow] : g_shadow_pages) {
-    std::cerr << "  " << P(page) << " shadowed by " << P(shadow) << std::endl;
-  }
+  g_shadow_pages.forEach([](uintptr_t page, ShadowPage shadowPage) {
+    std::cerr << "  " << P(page) << " shadowed by " << P(shadowPage.shadow)
+              << " (" << *shadowPage.symbolicBytes << " symbolic bytes)"
+              << std::endl;
+  });
 }
 
 const char *g_last_z3_call = "(none)";
@@ -83,18 +159,15 @@ const char *g_last_z3_call = "(none)";
 void handle_z3_error(Z3_context c [[maybe_unused]], Z3_error_code e) {
   std::fprintf(g_log, "[Z3] ERROR raised at call=%s code=%d msg=%s\n",
                g_last_z3_call, e, Z3_get_error_msg(c, e));
-  std::fflush(g_log);
+  commitLogRecord(g_log);
   // assert(!"Z3 error");
 }
 #endif
 
 SymExpr build_variable(const char *name, uint8_t bits) {
   Z3_symbol sym = Z3_mk_string_symbol(g_context, name);
-  auto *sort = Z3_mk_bv_sort(g_context, bits);
-  Z3_inc_ref(g_context, (Z3_ast)sort);
-  Z3_ast result = Z3_mk_const(g_context, sym, sort);
+  Z3_ast result = Z3_mk_const(g_context, sym, bvSort(bits));
   Z3_inc_ref(g_context, result);
-  Z3_dec_ref(g_context, (Z3_ast)sort);
   return result;
 }
 
@@ -109,20 +182,117 @@ SymExpr build_variable_int(const char *name) {
   return result;
 }
 
+#ifdef SYMCC_THREAD_SAFE
+/// Release the solver state of a thread when the thread exits.
+struct ThreadStateReleaser {
+  ~ThreadStateReleaser() {
+    LOCK_BACKEND();
+    delete g_slicer;
+    g_slicer = nullptr;
+    Z3_solver_dec_ref(g_context, g_solver);
+    g_solver = nullptr;
+  }
+};
+
+thread_local ThreadStateReleaser g_thread_state_releaser;
+#endif
+
+/// Create the solver state of the current thread, unless it exists already.
+void initializeThread() {
+  if (g_solver != nullptr)
+    return;
+
+  g_thread_id = g_next_thread_id++;
+  g_solver = Z3_mk_solver(g_context);
+  Z3_solver_inc_ref(g_context, g_solver);
+
+  if (g_config.keepPathPrefix && !g_config.fullPathPrefix)
+    g_slicer = new ConstraintSlicer(g_context);
+
+#ifdef SYMCC_THREAD_SAFE
+  // Thread-local objects are constructed on first use, and only then are
+  // they destroyed at thread exit.
+  (void)&g_thread_state_releaser;
+#endif
+}
+
+/// Log the query that is currently in the solver, i.e., the path constraints
+/// followed by the constraint that we just pushed. Unless configured
+/// otherwise, we only keep the path constraints that the new one depends on.
+void logQuery(uint64_t site_id, int check_kind, int taken, const char *filename,
+              int line) {
+  auto *solver = g_slicer != nullptr ? g_slicer->slice(g_solver) : g_solver;
+
+  if (g_query_cache != nullptr &&
+      g_query_cache->checkAndInsert(g_context, solver))
+    return;
+
+  if (g_solver_pool != nullptr) {
+    g_solver_pool->submit(solver);
+    return;
+  }
+
+  if (g_delta_log != nullptr) {
+    g_delta_log->logQuery(solver, site_id, check_kind, taken, filename, line,
+                          g_thread_id);
+    return;
+  }
+
+  if (g_binary_log != nullptr) {
+    g_binary_log->logQuery(solver, site_id, check_kind, taken, filename, line,
+                           g_thread_id);
+    return;
+  }
+
+  fprintf(g_log,
+          "Trying to solve:\nLocation:%016" PRIx64
+          ".%d.%ld.%d.%s.%d\nSMT:%s\n====end of smt====\n",
+          site_id, check_kind, static_cast<long>(g_thread_id), taken, filename,
+          line,
+          Z3_solver_to_string(g_context, solver));
+  commitLogRecord(g_log);
+}
+
 /// The set of all expressions we have ever passed to client code.
-std::set<SymExpr> allocatedExpressions;
+ExpressionRegistry allocatedExpressions;
+
+/// The expressions that we have added to the set since the last garbage
+/// collection. The thread-safe runtime doesn't collect garbage, so it doesn't
+/// keep track of them.
+std::vector<SymExpr> youngExpressions;
 
 SymExpr registerExpression(SymExpr expr) {
-  if (allocatedExpressions.count(expr) == 0) {
-    // We don't know this expression yet. Record it and increase the reference
-    // counter.
-    allocatedExpressions.insert(expr);
+  if (allocatedExpressions.insert(expr)) {
+    // We didn't know this expression yet, so it needs a reference.
     Z3_inc_ref(g_context, expr);
+#ifndef SYMCC_THREAD_SAFE
+    youngExpressions.push_back(expr);
+#endif
   }
 
   return expr;
 }
 
+/// A direct-mapped cache of integer constants. The instrumentation creates an
+/// expression for every concrete operand of a symbolic computation, every
+/// time the computation runs, and most of them are small numbers like 0, 1 or
+/// byte values. Each entry holds a reference, so the expressions stay valid
+/// until they are evicted.
+struct ConstantCache {
+  static constexpr unsigned kBits = 10;
+
+  static size_t slotOf(uint64_t value, uint8_t bits) {
+    return ((value ^ (uint64_t(bits) << 56)) * 0x9e3779b97f4a7c15ULL) >>
+           (64 - kBits);
+  }
+
+  uint64_t value;
+  uint8_t bits;
+  Z3_ast expr;
+};
+
+ConstantCache g_constants[size_t(1) << ConstantCache::kBits];
+
 } // namespace
 
 void _sym_initialize(void) {
@@ -154,79 +324,191 @@ void _sym_initialize(void) {
 
   g_rounding_mode = Z3_mk_fpa_round_nearest_ties_to_even(g_context);
   Z3_inc_ref(g_context, g_rounding_mode);
+  g_float_sort = Z3_mk_fpa_sort_single(g_context);
+  Z3_inc_ref(g_context, Z3_sort_to_ast(g_context, g_float_sort));
+  g_double_sort = Z3_mk_fpa_sort_double(g_context);
+  Z3_inc_ref(g_context, Z3_sort_to_ast(g_context, g_double_sort));
 
-  g_solver = Z3_mk_solver(g_context);
-  Z3_solver_inc_ref(g_context, g_solver);
+  initializeThread();
 
-  auto *pointerSort = Z3_mk_bv_sort(g_context, 8 * sizeof(void *));
-  Z3_inc_ref(g_context, (Z3_ast)pointerSort);
-  g_null_pointer = Z3_mk_int(g_context, 0, pointerSort);
+  g_null_pointer = Z3_mk_int(g_context, 0, bvSort(8 * sizeof(void *)));
   Z3_inc_ref(g_context, g_null_pointer);
-  Z3_dec_ref(g_context, (Z3_ast)pointerSort);
   g_true = Z3_mk_true(g_context);
   Z3_inc_ref(g_context, g_true);
   g_false = Z3_mk_false(g_context);
   Z3_inc_ref(g_context, g_false);
 
-  if (g_config.logFile.empty()) {
+  FILE *logFile = stderr;
+  if (!g_config.logFile.empty()) {
+    logFile = fopen(g_config.logFile.c_str(),
+                    g_config.logFormat == LogFormat::Binary ? "wb" : "w");
+  }
+
+  if (g_config.asyncLog)
+    logFile = startAsyncLog(logFile, g_config.asyncLogDropWhenFull,
+                            g_config.asyncLogBufferSize);
+
+  if (g_config.logFormat == LogFormat::Binary) {
+    // Keep diagnostics out of the binary log.
     g_log = stderr;
+    g_binary_log = new BinaryLogWriter(g_context, logFile);
+    atexit([] {
+      if (auto unlogged = g_binary_log->unloggedQueries(); unlogged > 0)
+        fprintf(stderr,
+                "[symcc] Binary log: %lu queries with unsupported expressions "
+                "not logged\n",
+                static_cast<unsigned long>(unlogged));
+    });
   } else {
-    g_log = fopen(g_config.logFile.c_str(), "w");
+    g_log = logFile;
+  }
+
+  if (g_config.logFormat == LogFormat::Delta)
+    g_delta_log = new DeltaLogWriter(g_context, g_log);
+
+  if (g_config.siteBudget > 0) {
+    g_site_budget =
+        new SiteBudget(g_config.siteBudget, g_config.siteBudgetContext);
+    atexit([] {
+      fprintf(stderr, "[symcc] Site budget: %lu queries suppressed\n",
+              static_cast<unsigned long>(g_site_budget->suppressed()));
+    });
+  }
+
+  if (g_config.keepPathPrefix && !g_config.fullPathPrefix) {
+    atexit([] {
+      auto stats = ConstraintSlicer::stats();
+      fprintf(stderr,
+              "[symcc] Constraint slicer: %lu queries, %lu reused the "
+              "partition, %lu path constraints dropped\n",
+              static_cast<unsigned long>(stats.queries),
+              static_cast<unsigned long>(stats.reused),
+              static_cast<unsigned long>(stats.dropped));
+    });
+  }
+
+  if (g_config.queryCache) {
+    g_query_cache = new QueryCache(g_config.queryCacheFile);
+    atexit([] {
+      auto stats = g_query_cache->stats();
+      fprintf(stderr,
+              "[symcc] Query cache: %lu duplicate queries skipped, %lu new "
+              "queries\n",
+              static_cast<unsigned long>(stats.hits),
+              static_cast<unsigned long>(stats.misses));
+    });
+  }
+
+  if (g_config.solverThreads > 0) {
+    struct stat outputDir;
+    if (stat(g_config.outputDir.c_str(), &outputDir) != 0 ||
+        !S_ISDIR(outputDir.st_mode)) {
+      std::cerr << "Error: the output directory " << g_config.outputDir
+                << " (configurable via SYMCC_OUTPUT_DIR) does not exist."
+                << std::endl;
+      exit(-1);
+    }
+
+    g_solver_pool = new SolverPool(
+        g_context, g_config.outputDir, g_config.solverThreads,
+        g_config.solverQueueSize, g_config.solverQueueDropWhenFull);
+    atexit([] {
+      g_solver_pool->shutDown();
+      auto stats = g_solver_pool->stats();
+      fprintf(stderr,
+              "[symcc] Solver pool: %lu queries, %lu test cases, %lu queries "
+              "dropped\n",
+              static_cast<unsigned long>(stats.queries),
+              static_cast<unsigned long>(stats.testCases),
+              static_cast<unsigned long>(stats.dropped));
+    });
+    pthread_atfork([] { g_solver_pool->prepareFork(); },
+                   [] { g_solver_pool->resumeAfterFork(); },
+                   [] { g_solver_pool->forgetWorkersAfterFork(); });
   }
 }
 
 Z3_ast _sym_build_integer(uint64_t value, uint8_t bits) {
-  auto *sort = Z3_mk_bv_sort(g_context, bits);
-  Z3_inc_ref(g_context, (Z3_ast)sort);
-  auto *result =
-      registerExpression(Z3_mk_unsigned_int64(g_context, value, sort));
-  Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  LOCK_BACKEND();
+  auto &cached = g_constants[ConstantCache::slotOf(value, bits)];
+  if (cached.expr == nullptr || cached.value != value || cached.bits != bits) {
+    if (cached.expr != nullptr)
+      Z3_dec_ref(g_context, cached.expr);
+    cached = {value, bits,
+              Z3_mk_unsigned_int64(g_context, value, bvSort(bits))};
+    Z3_inc_ref(g_context, cached.expr);
+  }
+
+  // The garbage collector may have dropped the expression from the registry
+  // since we cached it.
+  return registerExpression(cached.expr);
 }
 
 Z3_ast _sym_build_integer128(uint64_t high, uint64_t low) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_concat(
       g_context, _sym_build_integer(high, 64), _sym_build_integer(low, 64)));
 }
 
+Z3_ast _sym_build_zero_bytes(size_t length) {
+  LOCK_BACKEND();
+  // There are no empty bit vectors, so zero-length requests (e.g., for
+  // undefined empty structs) get a single byte.
+  auto bits = 8 * std::max<size_t>(length, 1);
+  return registerExpression(Z3_mk_int(
+      g_context, 0,
+      bits <= UINT8_MAX ? bvSort(bits) : Z3_mk_bv_sort(g_context, bits)));
+}
+
 Z3_ast _sym_build_float(double value, int is_double) {
-  auto *sort = FSORT(is_double);
-  Z3_inc_ref(g_context, (Z3_ast)sort);
-  auto *result =
-      registerExpression(Z3_mk_fpa_numeral_double(g_context, value, sort));
-  Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  LOCK_BACKEND();
+  return registerExpression(
+      Z3_mk_fpa_numeral_double(g_context, value, FSORT(is_double)));
 }
 
-Z3_ast _sym_get_input_byte(size_t offset, uint8_t) {
+Z3_ast _sym_get_input_byte(size_t offset, uint8_t value) {
+  LOCK_BACKEND();
+  // Input bytes don't necessarily arrive in order (e.g., when several threads
+  // make memory symbolic), so the vector may have gaps that we fill later.
   static std::vector<SymExpr> stdinBytes;
 
-  if (offset < stdinBytes.size())
+  if (offset < stdinBytes.size() && stdinBytes[offset] != nullptr)
     return stdinBytes[offset];
 
-  auto varName = "stdin" + std::to_string(stdinBytes.size());
+  auto varName = "stdin" + std::to_string(offset);
   auto *var = build_variable(varName.c_str(), 8);
+  if (g_solver_pool != nullptr)
+    g_solver_pool->registerInputByte(offset, value, varName);
 
-  stdinBytes.resize(offset);
-  stdinBytes.push_back(var);
+  if (offset >= stdinBytes.size())
+    stdinBytes.resize(offset + 1);
+  stdinBytes[offset] = var;
 
   return var;
 }
 
-Z3_ast _sym_get_integer(const char *name) { return build_variable_int(name); }
+Z3_ast _sym_get_integer(const char *name) {
+  LOCK_BACKEND();
+  return build_variable_int(name);
+}
 
 Z3_ast _sym_get_input_byte_with_prefix(const char *prefix, size_t offset,
-                                       uint8_t) {
+                                       uint8_t value) {
+  LOCK_BACKEND();
   static std::vector<SymExpr> stdinBytes;
 
-  if (offset < stdinBytes.size())
+  if (offset < stdinBytes.size() && stdinBytes[offset] != nullptr)
     return stdinBytes[offset];
 
-  auto varName = std::string(prefix) + "__" + std::to_string(stdinBytes.size());
+  auto varName = std::string(prefix) + "__" + std::to_string(offset);
   auto *var = build_variable(varName.c_str(), 8);
+  // The solver pool finds the offset of the byte by its variable's name.
+  if (g_solver_pool != nullptr)
+    g_solver_pool->registerInputByte(offset, value, varName);
 
-  stdinBytes.resize(offset);
-  stdinBytes.push_back(var);
+  if (offset >= stdinBytes.size())
+    stdinBytes.resize(offset + 1);
+  stdinBytes[offset] = var;
 
   return var;
 }
@@ -237,6 +519,7 @@ Z3_ast _sym_build_false(void) { return g_false; }
 Z3_ast _sym_build_bool(bool value) { return value ? g_true : g_false; }
 
 Z3_ast _sym_build_neg(Z3_ast expr) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_bvneg(g_context, expr));
 }
 
@@ -245,6 +528,7 @@ Z3_ast _sym_build_neg(Z3_ast expr) {
 
 #define DEF_BINARY_EXPR_BUILDER(name, z3_name)                                 \
   SymExpr _sym_build_##name(SymExpr a, SymExpr b) {                            \
+    LOCK_BACKEND();                                                            \
     return registerExpression(Z3_mk_##z3_name(g_context, a, b));               \
   }
 
@@ -285,6 +569,7 @@ DEF_BINARY_EXPR_BUILDER(float_ordered_equal, fpa_eq)
 // TODO handling signed/unsigned both
 #define DEF_INT_NARY_EXPR_BUILDER(name, z3_func)                               \
   SymExpr _sym_build_##name##_int(SymExpr a, SymExpr b) {                      \
+    LOCK_BACKEND();                                                            \
     auto a_int = _sym_build_bits_to_int(a, 0);                                 \
     auto b_int = _sym_build_bits_to_int(b, 0);                                 \
     Z3_ast args[2] = {a_int, b_int};                                           \
@@ -301,6 +586,7 @@ DEF_INT_NARY_EXPR_BUILDER(or, or)
 
 #define DEF_INT_BINARY_EXPR_BUILDER(name, z3_func, is_signed)                  \
   SymExpr _sym_build_##name##_int(SymExpr a, SymExpr b) {                      \
+    LOCK_BACKEND();                                                            \
     auto a_int = _sym_build_bits_to_int(a, is_signed);                         \
     auto b_int = _sym_build_bits_to_int(b, is_signed);                         \
     return registerExpression(Z3_mk_##z3_func(g_context, a_int, b_int));       \
@@ -330,66 +616,81 @@ DEF_INT_BINARY_EXPR_BUILDER(bool_xor, xor, 0)
 #undef DEF_INT_BINARY_EXPR_BUILDER
 
 Z3_ast _sym_build_ite(Z3_ast cond, Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_ite(g_context, cond, a, b));
 }
 
 Z3_ast _sym_build_fp_add(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_add(g_context, g_rounding_mode, a, b));
 }
 
 Z3_ast _sym_build_fp_sub(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_sub(g_context, g_rounding_mode, a, b));
 }
 
 Z3_ast _sym_build_fp_mul(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_mul(g_context, g_rounding_mode, a, b));
 }
 
 Z3_ast _sym_build_fp_div(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_div(g_context, g_rounding_mode, a, b));
 }
 
 Z3_ast _sym_build_fp_rem(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_rem(g_context, a, b));
 }
 
 Z3_ast _sym_build_fp_abs(Z3_ast a) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_abs(g_context, a));
 }
 
 Z3_ast _sym_build_fp_neg(Z3_ast a) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_neg(g_context, a));
 }
 
 Z3_ast _sym_build_not(Z3_ast expr) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_bvnot(g_context, expr));
 }
 
 Z3_ast _sym_build_not_equal(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_not(g_context, Z3_mk_eq(g_context, a, b)));
 }
 
 Z3_ast _sym_build_bool_and(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   Z3_ast operands[] = {a, b};
   return registerExpression(Z3_mk_and(g_context, 2, operands));
 }
 
 Z3_ast _sym_build_bool_or(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   Z3_ast operands[] = {a, b};
   return registerExpression(Z3_mk_or(g_context, 2, operands));
 }
 
 Z3_ast _sym_build_float_ordered_not_equal(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(
       Z3_mk_not(g_context, _sym_build_float_ordered_equal(a, b)));
 }
 
 Z3_ast _sym_build_float_ordered(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   return registerExpression(
       Z3_mk_not(g_context, _sym_build_float_unordered(a, b)));
 }
 
 Z3_ast _sym_build_float_unordered(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   Z3_ast checks[2];
 
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
@@ -407,6 +708,7 @@ Z3_ast _sym_build_float_unordered(Z3_ast a, Z3_ast b) {
 }
 
 Z3_ast _sym_build_float_unordered_greater_than(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   Z3_ast checks[3];
 
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
@@ -428,6 +730,7 @@ Z3_ast _sym_build_float_unordered_greater_than(Z3_ast a, Z3_ast b) {
 }
 
 Z3_ast _sym_build_float_unordered_greater_equal(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   Z3_ast checks[3];
 
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
@@ -449,6 +752,7 @@ Z3_ast _sym_build_float_unordered_greater_equal(Z3_ast a, Z3_ast b) {
 }
 
 Z3_ast _sym_build_float_unordered_less_than(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   Z3_ast checks[3];
 
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
@@ -470,6 +774,7 @@ Z3_ast _sym_build_float_unordered_less_than(Z3_ast a, Z3_ast b) {
 }
 
 Z3_ast _sym_build_float_unordered_less_equal(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   Z3_ast checks[3];
 
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
@@ -491,6 +796,7 @@ Z3_ast _sym_build_float_unordered_less_equal(Z3_ast a, Z3_ast b) {
 }
 
 Z3_ast _sym_build_float_unordered_equal(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   Z3_ast checks[3];
 
   checks[0] = Z3_mk_fpa_is_nan(g_context, a);
@@ -511,6 +817,7 @@ Z3_ast _sym_build_float_unordered_equal(Z3_ast a, Z3_ast b) {
 }
 
 Z3_ast _sym_build_float_unordered_not_equal(Z3_ast a, Z3_ast b) {
+  LOCK_BACKEND();
   
   if (a == NULL || b == NULL) return NULL;
 
@@ -535,18 +842,21 @@ Z3_ast _sym_build_float_unordered_not_equal(Z3_ast a, Z3_ast b) {
 }
 
 Z3_ast _sym_build_sext(Z3_ast expr, uint8_t bits) {
+  LOCK_BACKEND();
   if (expr == nullptr)
     return nullptr;
   return registerExpression(Z3_mk_sign_ext(g_context, bits, expr));
 }
 
 Z3_ast _sym_build_zext(Z3_ast expr, uint8_t bits) {
+  LOCK_BACKEND();
   if (expr == nullptr)
     return nullptr;
   return registerExpression(Z3_mk_zero_ext(g_context, bits, expr));
 }
 
 Z3_ast _sym_build_trunc(Z3_ast expr, uint8_t bits) {
+  LOCK_BACKEND();
   if (expr == nullptr)
     return nullptr;
 
@@ -554,53 +864,50 @@ Z3_ast _sym_build_trunc(Z3_ast expr, uint8_t bits) {
 }
 
 Z3_ast _sym_build_int_to_float(Z3_ast value, int is_double, int is_signed) {
+  LOCK_BACKEND();
   auto *sort = FSORT(is_double);
-  Z3_inc_ref(g_context, (Z3_ast)sort);
-  auto *result = registerExpression(
+  return registerExpression(
       is_signed
           ? Z3_mk_fpa_to_fp_signed(g_context, g_rounding_mode, value, sort)
           : Z3_mk_fpa_to_fp_unsigned(g_context, g_rounding_mode, value, sort));
-  Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
 }
 
 Z3_ast _sym_build_float_to_float(Z3_ast expr, int to_double) {
-  auto *sort = FSORT(to_double);
-  Z3_inc_ref(g_context, (Z3_ast)sort);
-  auto *result = registerExpression(
-      Z3_mk_fpa_to_fp_float(g_context, g_rounding_mode, expr, sort));
-  Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  LOCK_BACKEND();
+  return registerExpression(Z3_mk_fpa_to_fp_float(g_context, g_rounding_mode,
+                                                  expr, FSORT(to_double)));
 }
 
 Z3_ast _sym_build_bits_to_float(Z3_ast expr, int to_double) {
+  LOCK_BACKEND();
   if (expr == nullptr)
     return nullptr;
 
-  auto *sort = FSORT(to_double);
-  Z3_inc_ref(g_context, (Z3_ast)sort);
-  auto *result = registerExpression(Z3_mk_fpa_to_fp_bv(g_context, expr, sort));
-  Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  return registerExpression(
+      Z3_mk_fpa_to_fp_bv(g_context, expr, FSORT(to_double)));
 }
 
 Z3_ast _sym_build_float_to_bits(Z3_ast expr) {
+  LOCK_BACKEND();
   if (expr == nullptr)
     return nullptr;
   return registerExpression(Z3_mk_fpa_to_ieee_bv(g_context, expr));
 }
 
 Z3_ast _sym_build_float_to_signed_integer(Z3_ast expr, uint8_t bits) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_to_sbv(
       g_context, Z3_mk_fpa_round_toward_zero(g_context), expr, bits));
 }
 
 Z3_ast _sym_build_float_to_unsigned_integer(Z3_ast expr, uint8_t bits) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_fpa_to_ubv(
       g_context, Z3_mk_fpa_round_toward_zero(g_context), expr, bits));
 }
 
 Z3_ast _sym_build_bool_to_bit(Z3_ast expr) {
+  LOCK_BACKEND();
   if (expr == nullptr)
     return nullptr;
   return _sym_build_ite(expr, _sym_build_integer(1, 1),
@@ -608,6 +915,7 @@ Z3_ast _sym_build_bool_to_bit(Z3_ast expr) {
 }
 
 Z3_ast _sym_build_bits_to_int(Z3_ast expr, int is_signed) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_bv2int(g_context, expr, is_signed));
 }
 
@@ -673,12 +981,89 @@ uint64_t get_vars_hash(Z3_context ctx, Z3_ast ast) {
   return hash;
 }
 
-void _sym_push_path_constraint_with_loc(Z3_ast constraint, int taken,
-                                        uintptr_t site_id [[maybe_unused]],
-                                        const char *filename, int line,
-                                        int slot_id) {
-  if (constraint == nullptr)
-    return;
+namespace {
+
+/// The site of a path constraint. We only look it up in the site tables when
+/// we need its description, i.e., for the site budget and for writing a
+/// record.
+class ConstraintSite {
+public:
+  /// A site from the tables. A non-negative check kind overrides the one in
+  /// the table.
+  ConstraintSite(uintptr_t id, int checkKind)
+      : id_(id), checkKind_(checkKind) {}
+
+  /// A site whose location the instrumentation passes explicitly.
+  ConstraintSite(uintptr_t id, int checkKind, const char *file, int line)
+      : id_(id), checkKind_(checkKind), file_(file), line_(line),
+        resolved_(true) {}
+
+  uintptr_t id() const { return id_; }
+
+  /// Whether we know the site. The tables don't describe the sites of the
+  /// libc wrappers, and we don't solve for their constraints.
+  bool known() {
+    resolve();
+    return file_ != nullptr;
+  }
+
+  int checkKind() {
+    resolve();
+    return checkKind_;
+  }
+
+  const char *file() {
+    resolve();
+    return file_;
+  }
+
+  int line() {
+    resolve();
+    return line_;
+  }
+
+private:
+  void resolve() {
+    if (resolved_)
+      return;
+    resolved_ = true;
+    if (const auto *site = findSite(id_)) {
+      file_ = site->file;
+      line_ = site->line;
+      if (checkKind_ < 0)
+        checkKind_ = site->checkKind;
+    }
+  }
+
+  uintptr_t id_;
+  int checkKind_;
+  const char *file_ = nullptr;
+  int line_ = -1;
+  bool resolved_ = false;
+};
+
+bool isStringCheck(ConstraintSite &site) {
+  // TODO std::string atomic symbolize
+  char target[] = "symros_string.hpp";
+  return strstr(site.file(), target) != NULL;
+}
+
+void pushPathConstraint(Z3_ast constraint, int taken, ConstraintSite &site) {
+  int string_size_check_line = 13;
+  int strcmp_start_line = 23;
+
+  // String comparisons need all of their constraints, so they don't count
+  // against the site budget. The budget only suppresses the query; the path
+  // prefix needs the constraint anyway.
+  bool admitted = true;
+  if (g_site_budget != nullptr) {
+    if (!site.known())
+      return;
+    admitted = isStringCheck(site) ||
+               g_site_budget->admit(site.id(), site.checkKind(), taken);
+    if (!admitted && !g_config.keepPathPrefix)
+      return;
+  }
 
   constraint = Z3_simplify(g_context, constraint);
   Z3_inc_ref(g_context, constraint);
@@ -698,19 +1083,25 @@ void _sym_push_path_constraint_with_loc(Z3_ast constraint, int taken,
     Z3_dec_ref(g_context, constraint);
     return;
   }
+
+  if (!site.known()) {
+    Z3_dec_ref(g_context, constraint);
+    return;
+  }
+  bool string_check = isStringCheck(site);
+  auto site_id = site.id();
+  auto check_kind = site.checkKind();
+  const char *filename = site.file();
+  int line = site.line();
+
   /* Generate a solution for the alternative */
   Z3_ast not_constraint =
       Z3_simplify(g_context, Z3_mk_not(g_context, constraint));
   Z3_inc_ref(g_context, not_constraint);
 
-  Z3_solver_push(g_context, g_solver);
+  if (string_check) {
+    Z3_solver_push(g_context, g_solver);
 
-  // TODO std::string atomic symbolize
-  int string_size_check_line = 13;
-  int strcmp_start_line = 23;
-  char target[] = "symros_string.hpp";
-
-  if (strstr(filename, target) != NULL) {
     if (line == string_size_check_line) {
       string_eq_constraints.clear();
       string_not_eq_constraints.clear();
@@ -735,13 +1126,7 @@ void _sym_push_path_constraint_with_loc(Z3_ast constraint, int taken,
                         string_eq_constraints.data());
           Z3_inc_ref(g_context, final_constraint);
           Z3_solver_assert(g_context, g_solver, final_constraint);
-          fprintf(
-              g_log,
-              "Trying to solve:\nLocation:%d.%ld.%d.%s.%d\nSMT:%s\n====end of "
-              "smt====\n",
-              slot_id, 0L, string_taken, filename, line,
-              Z3_solver_to_string(g_context, g_solver));
-          fflush(g_log);
+          logQuery(site_id, check_kind, string_taken, filename, line);
           Z3_solver_pop(g_context, g_solver, 1);
           Z3_dec_ref(g_context, final_constraint);
         } else {
@@ -750,130 +1135,156 @@ void _sym_push_path_constraint_with_loc(Z3_ast constraint, int taken,
                        string_not_eq_constraints.data());
           Z3_inc_ref(g_context, final_constraint);
           Z3_solver_assert(g_context, g_solver, final_constraint);
-          fprintf(
-              g_log,
-              "Trying to solve:\nLocation:%d.%ld.%d.%s.%d\nSMT:%s\n====end of "
-              "smt====\n",
-              slot_id, 0L, string_taken, filename, line,
-              Z3_solver_to_string(g_context, g_solver));
-          fflush(g_log);
+          logQuery(site_id, check_kind, string_taken, filename, line);
           Z3_solver_pop(g_context, g_solver, 1);
           Z3_dec_ref(g_context, final_constraint);
         }
       }
     }
-  } else {
+  } else if (admitted) {
+    Z3_solver_push(g_context, g_solver);
     Z3_solver_assert(g_context, g_solver, taken ? constraint : not_constraint);
-
-    fprintf(g_log,
-            "Trying to solve:\nLocation:%d.%ld.%d.%s.%d\nSMT:%s\n====end of "
-            "smt====\n",
-            slot_id, 0L, taken, filename, line,
-            Z3_solver_to_string(g_context, g_solver));
-    fflush(g_log);
+    logQuery(site_id, check_kind, taken, filename, line);
     Z3_solver_pop(g_context, g_solver, 1);
   }
 
+  // The solver keeps a reference to the path constraint.
+  if (g_config.keepPathPrefix && !string_check)
+    Z3_solver_assert(g_context, g_solver, taken ? constraint : not_constraint);
+
   Z3_dec_ref(g_context, constraint);
   Z3_dec_ref(g_context, not_constraint);
 }
 
+} // namespace
+
 void _sym_push_path_constraint(Z3_ast constraint, int taken,
-                               uintptr_t site_id [[maybe_unused]]) {
-  std::cout << "call" << std::endl;
+                               uintptr_t site_id) {
+  LOCK_BACKEND();
+  initializeThread();
   if (constraint == nullptr)
     return;
-  else
-    return;
 
-  constraint = Z3_simplify(g_context, constraint);
-  Z3_inc_ref(g_context, constraint);
+  // The location is in the site tables of the instrumented modules.
+  ConstraintSite site(site_id, -1);
+  pushPathConstraint(constraint, taken, site);
+}
 
-  /* Check the easy cases first: if simplification reduced the constraint to
-     "true" or "false", there is no point in trying to solve the negation or *
-     pushing the constraint to the solver... */
+void _sym_push_check_constraint(Z3_ast constraint, int taken,
+                                uintptr_t site_id, uint8_t check_kind) {
+  LOCK_BACKEND();
+  initializeThread();
 
-  if (Z3_is_eq_ast(g_context, constraint, g_true)) {
-    assert(taken && "We have taken an impossible branch");
-    Z3_dec_ref(g_context, constraint);
-    return;
-  }
+  // The checks of an arithmetic operation share its site.
+  ConstraintSite site(site_id, check_kind);
+  pushPathConstraint(constraint, taken, site);
+}
 
-  if (Z3_is_eq_ast(g_context, constraint, g_false)) {
-    assert(!taken && "We have taken an impossible branch");
-    Z3_dec_ref(g_context, constraint);
+void _sym_push_path_constraint_with_loc(Z3_ast constraint, int taken,
+                                        uintptr_t site_id,
+                                        const char *filename, int line,
+                                        int slot_id) {
+  LOCK_BACKEND();
+  initializeThread();
+  if (constraint == nullptr)
     return;
-  }
 
-  /* Generate a solution for the alternative */
-  Z3_ast not_constraint =
-      Z3_simplify(g_context, Z3_mk_not(g_context, constraint));
-  Z3_inc_ref(g_context, not_constraint);
-
-  Z3_solver_push(g_context, g_solver);
-  Z3_solver_assert(g_context, g_solver, taken ? not_constraint : constraint);
-  fprintf(g_log, "Trying to solve:\n%s\n====end of smt====\n",
-          Z3_solver_to_string(g_context, g_solver));
-
-  //  Z3_lbool feasible = Z3_solver_check(g_context, g_solver);
-  //  if (feasible == Z3_L_TRUE) {
-  //    Z3_model model = Z3_solver_get_model(g_context, g_solver);
-  //    Z3_model_inc_ref(g_context, model);
-  //    fprintf(g_log, "Found diverging input:\n%s\n",
-  //            Z3_model_to_string(g_context, model));
-  //    Z3_model_dec_ref(g_context, model);
-  //  } else {
-  //    fprintf(g_log, "Can't find a diverging input at this point\n");
-  //  }
-  fflush(g_log);
-
-  Z3_solver_pop(g_context, g_solver, 1);
-
-  /* Assert the actual path constraint */
-  Z3_ast newConstraint = (taken ? constraint : not_constraint);
-  Z3_inc_ref(g_context, newConstraint);
-  Z3_solver_assert(g_context, g_solver, newConstraint);
-  //  assert((Z3_solver_check(g_context, g_solver) == Z3_L_TRUE) &&
-  //         "Asserting infeasible path constraint");
-  // Z3_dec_ref(g_context, newConstraint);
-  Z3_dec_ref(g_context, constraint);
-  Z3_dec_ref(g_context, not_constraint);
+  // Such code encodes the check kind in the thousands of the slot ID.
+  ConstraintSite site(site_id, slot_id >= 1000 ? slot_id / 1000 : 0, filename,
+                      line);
+  pushPathConstraint(constraint, taken, site);
 }
 
 void _sym_localize_branch_instruction(const char *filename, int line_number) {
+  LOCK_BACKEND();
 
   fprintf(g_log, "[symcc] Localizing branch instruction at %s:%d\n", filename,
           line_number);
 }
 
 SymExpr _sym_concat_helper(SymExpr a, SymExpr b) {
+  LOCK_BACKEND();
   return registerExpression(Z3_mk_concat(g_context, a, b));
 }
 
 SymExpr _sym_extract_helper(SymExpr expr, size_t first_bit, size_t last_bit) {
+  LOCK_BACKEND();
   return registerExpression(
       Z3_mk_extract(g_context, first_bit, last_bit, expr));
 }
 
+SymExpr _sym_extract_source_helper(SymExpr expr, size_t *first_bit,
+                                   size_t *last_bit) {
+  LOCK_BACKEND();
+  unsigned first, last;
+  auto *source = extractSource(expr, &first, &last);
+  if (source == nullptr)
+    return nullptr;
+
+  *first_bit = first;
+  *last_bit = last;
+  return registerExpression(source);
+}
+
+SymExpr _sym_bswap_helper(SymExpr expr) {
+  LOCK_BACKEND();
+  unsigned bits = Z3_get_bv_sort_size(g_context, Z3_get_sort(g_context, expr));
+  if (bits == 8)
+    return expr;
+
+  // Take the bytes of an extract from its argument, so that we don't nest
+  // extracts.
+  unsigned first, low = 0;
+  auto *source = extractSource(expr, &first, &low);
+  if (source == nullptr)
+    source = expr;
+
+  // Only the result goes to the registry; we hold a reference to each partial
+  // result while we build on it.
+  auto *result = Z3_mk_extract(g_context, low + 7, low, source);
+  Z3_inc_ref(g_context, result);
+  for (unsigned i = 8; i < bits; i += 8) {
+    auto *byte = Z3_mk_extract(g_context, low + i + 7, low + i, source);
+    auto *next = Z3_mk_concat(g_context, result, byte);
+    Z3_inc_ref(g_context, next);
+    Z3_dec_ref(g_context, result);
+    result = next;
+  }
+
+  auto *registered = registerExpression(result);
+  Z3_dec_ref(g_context, result);
+  return registered;
+}
+
 size_t _sym_bits_helper(SymExpr expr) {
-  auto *sort = Z3_get_sort(g_context, expr);
-  Z3_inc_ref(g_context, (Z3_ast)sort);
-  auto result = Z3_get_bv_sort_size(g_context, sort);
-  Z3_dec_ref(g_context, (Z3_ast)sort);
-  return result;
+  LOCK_BACKEND();
+  // The expression keeps its sort alive, so we don't need a reference.
+  return Z3_get_bv_sort_size(g_context, Z3_get_sort(g_context, expr));
+}
+
+/* Call-stack tracing (only for the site budget) */
+// The calling context is per thread, so tracking it doesn't need the lock.
+void _sym_notify_call(uintptr_t site_id) {
+  if (g_site_budget != nullptr && g_site_budget->tracksContext())
+    g_site_budget->notifyCall(site_id);
+}
+
+void _sym_notify_ret(uintptr_t) {
+  if (g_site_budget != nullptr && g_site_budget->tracksContext())
+    g_site_budget->notifyRet();
 }
 
-/* No call-stack tracing */
-void _sym_notify_call(uintptr_t) {}
-void _sym_notify_ret(uintptr_t) {}
 void _sym_notify_basic_block(uintptr_t) {}
 
 /* Debugging */
 const char *_sym_expr_to_string(SymExpr expr) {
+  LOCK_BACKEND();
   return Z3_ast_to_string(g_context, expr);
 }
 
 bool _sym_feasible(SymExpr expr) {
+  LOCK_BACKEND();
+  initializeThread();
   expr = Z3_simplify(g_context, expr);
   Z3_inc_ref(g_context, expr);
 
@@ -888,36 +1299,59 @@ bool _sym_feasible(SymExpr expr) {
 
 /* Garbage collection */
 void _sym_collect_garbage() {
-  if (allocatedExpressions.size() < g_config.garbageCollectionThreshold)
+#ifdef SYMCC_THREAD_SAFE
+  // Other threads may hold expressions that we can't see, e.g., in registers.
+  return;
+#else
+  auto kind = scheduleGarbageCollection(allocatedExpressions.size(),
+                                        youngExpressions.size());
+  if (kind == CollectionKind::None)
     return;
 
-#ifndef NDEBUG
-  auto start = std::chrono::high_resolution_clock::now();
-  auto startSize = allocatedExpressions.size();
-#endif
-
-  auto reachableExpressions = collectReachableExpressions();
-  for (auto expr_it = allocatedExpressions.begin();
-       expr_it != allocatedExpressions.end();) {
-    if (reachableExpressions.count(*expr_it) == 0) {
-      expr_it = allocatedExpressions.erase(expr_it);
-    } else {
-      ++expr_it;
+  auto start = std::chrono::steady_clock::now();
+
+  releaseConcreteShadows();
+  auto reachableExpressions = markReachableExpressions(
+      [](SymExpr expr) -> size_t { return Z3_get_ast_id(g_context, expr); },
+      kind);
+  // Every expression in the set has a reference, so the IDs of the others
+  // remain valid while we release some of them.
+  auto isGarbage = [&](SymExpr expr) {
+    if (reachableExpressions.isMarked(Z3_get_ast_id(g_context, expr)))
+      return false;
+
+    Z3_dec_ref(g_context, expr);
+    return true;
+  };
+
+  size_t reclaimed = 0;
+  if (kind == CollectionKind::Full) {
+    reclaimed = allocatedExpressions.removeIf(isGarbage);
+  } else {
+    for (auto *expr : youngExpressions) {
+      if (isGarbage(expr)) {
+        allocatedExpressions.erase(expr);
+        reclaimed++;
+      }
     }
   }
+  youngExpressions.clear();
 
-#ifndef NDEBUG
-  auto end = std::chrono::high_resolution_clock::now();
-  auto endSize = allocatedExpressions.size();
+  auto pause = std::chrono::steady_clock::now() - start;
+  reportGarbageCollection(kind, allocatedExpressions.size(), reclaimed, pause);
 
-  std::cerr << "After garbage collection: " << endSize
-            << " expressions remain (before: " << startSize << ")" << std::endl
+#ifndef NDEBUG
+  std::cerr << "After "
+            << (kind == CollectionKind::Full ? "full" : "minor")
+            << " garbage collection: " << allocatedExpressions.size()
+            << " expressions remain (released: " << reclaimed << ")"
+            << std::endl
             << "\t(collection took "
-            << std::chrono::duration_cast<std::chrono::milliseconds>(end -
-                                                                     start)
+            << std::chrono::duration_cast<std::chrono::milliseconds>(pause)
                    .count()
             << " milliseconds)" << std::endl;
 #endif
+#endif
 }
 
 /* Test-case handling */
@@ -930,4 +1364,8 @@ void symcc_set_test_case_handler(TestCaseHandler) {
       "Warning: test-case handlers aren't supported in the simple backend\n");
 }
 
-void symcc_reset_constraints() { Z3_solver_reset(g_context, g_solver); }
+void symcc_reset_constraints() {
+  LOCK_BACKEND();
+  initializeThread();
+  Z3_solver_reset(g_context, g_solver);
+}
@@ -0,0 +1,67 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "SiteBudget.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+/// The number of index bits of a new table.
+constexpr unsigned kInitialBits = 12;
+
+} // namespace
+
+SYMCC_THREAD_LOCAL uint64_t SiteBudget::context_ = 0;
+SYMCC_THREAD_LOCAL std::vector<uint64_t> SiteBudget::contextStack_;
+
+SiteBudget::SiteBudget(size_t budget, bool trackContext)
+    : budget_(static_cast<uint32_t>(std::min<size_t>(
+          budget, std::numeric_limits<uint32_t>::max()))),
+      trackContext_(trackContext), entries_(size_t(1) << kInitialBits),
+      shift_(64 - kInitialBits) {}
+
+void SiteBudget::notifyCall(uintptr_t siteId) {
+  contextStack_.push_back(context_);
+  context_ = (context_ ^ siteId) * 0xff51afd7ed558ccdULL;
+  context_ ^= context_ >> 32;
+}
+
+void SiteBudget::notifyRet() {
+  // Returns without a matching call happen, e.g., when uninstrumented code
+  // calls back into instrumented code.
+  if (contextStack_.empty())
+    return;
+
+  context_ = contextStack_.back();
+  contextStack_.pop_back();
+}
+
+void SiteBudget::grow() {
+  std::vector<Entry> old(entries_.size() * 2);
+  old.swap(entries_);
+  shift_--;
+
+  for (const auto &entry : old) {
+    if (!entry.used)
+      continue;
+
+    auto index = hash(entry.siteId, entry.context, entry.checkKind) >> shift_;
+    while (entries_[index].used)
+      index = (index + 1) & (entries_.size() - 1);
+    entries_[index] = entry;
+  }
+}
@@ -0,0 +1,124 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SITEBUDGET_H
+#define SITEBUDGET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Concurrency.h"
+
+//
+// A per-site limit on the number of queries. Programs that execute the same
+// branch over and over (e.g., in a message loop) don't gain anything from
+// emitting a query every time, so we count the executions of each branch site
+// in each direction and stop emitting queries once the count reaches the
+// budget. Optionally, a hash of the call stack becomes part of the site, so
+// that each calling context gets its own budget.
+//
+// This check runs for every symbolic branch, so the counters live in a flat
+// open-addressing table: a lookup is a multiplication, a shift and usually a
+// single probe.
+//
+
+class SiteBudget {
+public:
+  SiteBudget(size_t budget, bool trackContext);
+
+  /// Count an execution of the site's check in the given direction, and
+  /// return whether it is still within the budget. The checks of an
+  /// arithmetic operation share its site, so each of them counts separately.
+  bool admit(uintptr_t siteId, int checkKind, int taken) {
+    for (auto index = hash(siteId, context_, checkKind) >> shift_;;
+         index = (index + 1) & (entries_.size() - 1)) {
+      auto &entry = entries_[index];
+      if (entry.used && entry.siteId == siteId && entry.context == context_ &&
+          entry.checkKind == checkKind)
+        return count(entry, taken);
+
+      if (!entry.used) {
+        if ((used_ + 1) * 2 > entries_.size()) {
+          grow();
+          return admit(siteId, checkKind, taken);
+        }
+
+        entry = {siteId, context_, {0, 0}, static_cast<uint8_t>(checkKind),
+                 true};
+        used_++;
+        return count(entry, taken);
+      }
+    }
+  }
+
+  /// Track calls and returns for the calling context.
+  void notifyCall(uintptr_t siteId);
+  void notifyRet();
+
+  bool tracksContext() const { return trackContext_; }
+
+  /// The number of executions that exceeded the budget.
+  uint64_t suppressed() const { return suppressed_; }
+
+private:
+  /// The counters of a site, check and calling context. We compare all
+  /// three, so distinct sites and checks never share a budget; the calling
+  /// context is a hash of the call stack, though, so two stacks may collide.
+  struct Entry {
+    uint64_t siteId;
+    uint64_t context;
+    uint32_t counts[2];
+    uint8_t checkKind;
+    bool used;
+  };
+
+  /// Mix the parts of an entry; the high bits of the result make a good
+  /// table index.
+  static uint64_t hash(uint64_t siteId, uint64_t context, int checkKind) {
+    return (siteId ^ context ^ (uint64_t(checkKind) << 56)) *
+           0x9e3779b97f4a7c15ULL;
+  }
+
+  bool count(Entry &entry, int taken) {
+    auto &counter = entry.counts[taken != 0];
+    if (counter >= budget_) {
+      suppressed_++;
+      return false;
+    }
+    counter++;
+    return true;
+  }
+
+  void grow();
+
+  uint32_t budget_;
+  bool trackContext_;
+
+  /// The table, with a power-of-two size; we use the top bits of the hash as
+  /// the index, so shift_ is 64 minus the number of index bits.
+  std::vector<Entry> entries_;
+  unsigned shift_;
+  size_t used_ = 0;
+
+  /// The hash of the current call stack, and the hashes of the callers. Each
+  /// thread has its own call stack.
+  static SYMCC_THREAD_LOCAL uint64_t context_;
+  static SYMCC_THREAD_LOCAL std::vector<uint64_t> contextStack_;
+
+  uint64_t suppressed_ = 0;
+};
+
+#endif
@@ -0,0 +1,229 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#include "SolverPool.h"
+
+#include <cassert>
+#include <cstdio>
+#include <utility>
+
+#include <unistd.h>
+
+SolverPool::SolverPool(Z3_context context, std::string outputDir,
+                       unsigned numThreads, size_t queueSize,
+                       bool dropWhenFull)
+    : context_(context), outputDir_(std::move(outputDir)),
+      dropWhenFull_(dropWhenFull) {
+  // Each worker needs a context for the query it's solving, in addition to
+  // the ones waiting in the queue.
+  for (size_t i = 0; i < queueSize + numThreads; i++) {
+    auto *config = Z3_mk_config();
+    Z3_set_param_value(config, "model", "true");
+    Z3_set_param_value(config, "timeout", "10000"); // milliseconds
+    contexts_.push_back(Z3_mk_context_rc(config));
+    Z3_del_config(config);
+  }
+  freeContexts_ = contexts_;
+
+  for (unsigned i = 0; i < numThreads; i++)
+    workers_.emplace_back(&SolverPool::workerLoop, this);
+}
+
+SolverPool::~SolverPool() {
+  shutDown();
+  for (auto *context : contexts_)
+    Z3_del_context(context);
+}
+
+void SolverPool::submit(Z3_solver solver) {
+  if (forkedChild_) {
+    // The child has no workers, so it solves the query in the instrumented
+    // thread's own context.
+    auto query = copyQuery(solver, context_);
+    queries_++;
+    solve(query);
+    return;
+  }
+
+  if (disabled_)
+    return;
+
+  Z3_context target;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (freeContexts_.empty()) {
+      if (dropWhenFull_) {
+        dropped_++;
+        return;
+      }
+      contextAvailable_.wait(lock, [this] { return !freeContexts_.empty(); });
+    }
+    target = freeContexts_.back();
+    freeContexts_.pop_back();
+  }
+
+  auto query = copyQuery(solver, target);
+  queries_++;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(query));
+  }
+  queryAvailable_.notify_one();
+}
+
+SolverPool::Query SolverPool::copyQuery(Z3_solver solver, Z3_context target) {
+  auto *assertions = Z3_solver_get_assertions(context_, solver);
+  Z3_ast_vector_inc_ref(context_, assertions);
+
+  Query query{target, {}};
+  auto numAssertions = Z3_ast_vector_size(context_, assertions);
+  assert(numAssertions > 0 && "Queries must contain the branch condition");
+  for (unsigned i = 0; i < numAssertions; i++) {
+    auto *assertion = Z3_ast_vector_get(context_, assertions, i);
+    if (target != context_)
+      assertion = Z3_translate(context_, assertion, target);
+    if (i == numAssertions - 1)
+      assertion = Z3_mk_not(target, assertion);
+    Z3_inc_ref(target, assertion);
+    query.assertions.push_back(assertion);
+  }
+  Z3_ast_vector_dec_ref(context_, assertions);
+  return query;
+}
+
+void SolverPool::registerInputByte(size_t offset, uint8_t value,
+                                   const std::string &name) {
+  std::lock_guard<std::mutex> lock(inputMutex_);
+  if (input_.size() <= offset)
+    input_.resize(offset + 1);
+  input_[offset] = value;
+  inputOffsets_[name] = offset;
+}
+
+void SolverPool::shutDown() {
+  if (disabled_.exchange(true))
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queryAvailable_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+void SolverPool::prepareFork() { inputMutex_.lock(); }
+
+void SolverPool::resumeAfterFork() { inputMutex_.unlock(); }
+
+void SolverPool::forgetWorkersAfterFork() {
+  inputMutex_.unlock();
+  disabled_ = true;
+  forkedChild_ = true;
+  queries_ = 0;
+  testCases_ = 0;
+  dropped_ = 0;
+}
+
+SolverPool::Stats SolverPool::stats() const {
+  return {queries_.load(), testCases_.load(), dropped_.load()};
+}
+
+void SolverPool::workerLoop() {
+  while (true) {
+    Query query;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queryAvailable_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty())
+        return;
+      query = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    solve(query);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      freeContexts_.push_back(query.context);
+    }
+    contextAvailable_.notify_one();
+  }
+}
+
+void SolverPool::solve(Query &query) {
+  auto *context = query.context;
+  auto *solver = Z3_mk_solver(context);
+  Z3_solver_inc_ref(context, solver);
+
+  for (auto *assertion : query.assertions)
+    Z3_solver_assert(context, solver, assertion);
+
+  if (Z3_solver_check(context, solver) == Z3_L_TRUE) {
+    auto *model = Z3_solver_get_model(context, solver);
+    Z3_model_inc_ref(context, model);
+    writeTestCase(context, model);
+    Z3_model_dec_ref(context, model);
+  }
+
+  for (auto *assertion : query.assertions)
+    Z3_dec_ref(context, assertion);
+  Z3_solver_dec_ref(context, solver);
+}
+
+void SolverPool::writeTestCase(Z3_context context, Z3_model model) {
+  std::vector<uint8_t> testCase;
+  {
+    std::lock_guard<std::mutex> lock(inputMutex_);
+    testCase = input_;
+
+    auto numConsts = Z3_model_get_num_consts(context, model);
+    for (unsigned i = 0; i < numConsts; i++) {
+      auto *decl = Z3_model_get_const_decl(context, model, i);
+      auto symbol = Z3_get_decl_name(context, decl);
+      if (Z3_get_symbol_kind(context, symbol) != Z3_STRING_SYMBOL)
+        continue;
+
+      auto offset = inputOffsets_.find(Z3_get_symbol_string(context, symbol));
+      if (offset == inputOffsets_.end())
+        continue;
+
+      uint64_t value;
+      if (Z3_get_numeral_uint64(context,
+                                Z3_model_get_const_interp(context, model, decl),
+                                &value))
+        testCase[offset->second] = value;
+    }
+  }
+
+  // A forked child numbers its test cases from zero as well, so it adds its
+  // PID to keep them apart from the parent's.
+  char name[48];
+  if (forkedChild_)
+    snprintf(name, sizeof(name), "/%06lu-%ld",
+             static_cast<unsigned long>(testCases_++),
+             static_cast<long>(getpid()));
+  else
+    snprintf(name, sizeof(name), "/%06lu",
+             static_cast<unsigned long>(testCases_++));
+  auto *file = fopen((outputDir_ + name).c_str(), "wb");
+  if (file == nullptr) {
+    perror("Failed to write a test case");
+    return;
+  }
+  fwrite(testCase.data(), 1, testCase.size(), file);
+  fclose(file);
+}
@@ -0,0 +1,123 @@
+// This file is part of the SymCC runtime.
+//
+// The SymCC runtime is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// The SymCC runtime is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SOLVERPOOL_H
+#define SOLVERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <z3.h>
+
+//
+// In-process solving. Instead of logging the query at each branch for an
+// external solver, we copy it into a separate Z3 context and let a pool of
+// worker threads solve it; satisfying models become new test cases in the
+// output directory.
+//
+// Z3 contexts must not be used by two threads at once, so every queued query
+// owns a context: the instrumented thread takes a free context, translates the
+// query into it with Z3_translate, and hands it to a worker, which returns the
+// context to the free list when it's done. The number of contexts bounds the
+// queue; when all of them are in use, the instrumented thread either waits or
+// drops the query.
+//
+
+class SolverPool {
+public:
+  SolverPool(Z3_context context, std::string outputDir, unsigned numThreads,
+             size_t queueSize, bool dropWhenFull);
+  ~SolverPool();
+
+  SolverPool(const SolverPool &) = delete;
+  SolverPool &operator=(const SolverPool &) = delete;
+
+  /// Queue the query that is currently in the solver. The last assertion is
+  /// the branch condition as executed; the workers solve for its negation.
+  void submit(Z3_solver solver);
+
+  /// Record the concrete value of an input byte and the name of its variable,
+  /// so that we can produce complete test cases.
+  void registerInputByte(size_t offset, uint8_t value, const std::string &name);
+
+  /// Solve the remaining queries and stop the workers.
+  void shutDown();
+
+  /// Fork handlers. A forked child doesn't inherit the workers, so it solves
+  /// its queries synchronously and reports only its own statistics.
+  void prepareFork();
+  void resumeAfterFork();
+  void forgetWorkersAfterFork();
+
+  struct Stats {
+    uint64_t queries;
+    uint64_t testCases;
+    uint64_t dropped;
+  };
+
+  Stats stats() const;
+
+private:
+  struct Query {
+    Z3_context context;
+    std::vector<Z3_ast> assertions;
+  };
+
+  /// Copy the query that is currently in the solver into the target context,
+  /// negating the branch condition.
+  Query copyQuery(Z3_solver solver, Z3_context target);
+
+  void workerLoop();
+  void solve(Query &query);
+  void writeTestCase(Z3_context context, Z3_model model);
+
+  Z3_context context_;
+  std::string outputDir_;
+  bool dropWhenFull_;
+
+  std::mutex mutex_;
+  /// Signaled when a query is queued or when we shut down.
+  std::condition_variable queryAvailable_;
+  /// Signaled when a context is returned to the free list.
+  std::condition_variable contextAvailable_;
+  std::vector<Z3_context> contexts_;
+  std::vector<Z3_context> freeContexts_;
+  std::deque<Query> queue_;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+
+  /// Set when the workers are gone (after shutting down or forking).
+  std::atomic<bool> disabled_{false};
+  bool forkedChild_ = false;
+
+  /// The concrete input, and the input offsets by variable name (protected by
+  /// inputMutex_).
+  std::mutex inputMutex_;
+  std::vector<uint8_t> input_;
+  std::unordered_map<std::string, size_t> inputOffsets_;
+
+  std::atomic<uint64_t> queries_{0};
+  std::atomic<uint64_t> testCases_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+#endif
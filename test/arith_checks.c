@@ -0,0 +1,44 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 -g %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_LOG_FILE=%t.log %t 2>&1 | %filecheck --check-prefix=OUTPUT %s
+// RUN: %filecheck %s < %t.log
+//
+// Check that the overflow and bound checks of an integer operation are pushed
+// from its site, with their check kinds and concrete outcomes, and that
+// concrete operations don't produce any.
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  // CHECK: Location:[[SITE:[0-9a-f]{16}]].1.0.0.{{.*}}arith_checks.c.[[@LINE+3]]
+  // CHECK: Location:[[SITE]].3.0.0.{{.*}}arith_checks.c.[[@LINE+2]]
+  // CHECK: Location:[[SITE]].4.0.0.{{.*}}arith_checks.c.[[@LINE+1]]
+  int y = x * 3;
+  // OUTPUT: 15
+  fprintf(stderr, "%d\n", y);
+
+  // CHECK-NOT: arith_checks.c.[[@LINE+1]]
+  int z = argc * 3;
+  fprintf(stderr, "%d\n", z);
+  return 0;
+}
@@ -0,0 +1,46 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_LOG_FILE=%t.sync %t
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_ASYNC_LOG=1 SYMCC_LOG_FILE=%t.async %t
+// RUN: diff %t.sync %t.async
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_ASYNC_LOG=1 SYMCC_LOG_FILE=%t.abort not --crash %t abort
+// RUN: diff %t.sync %t.abort
+//
+// Check that the asynchronous log contains the same records as the synchronous
+// one, even if the program aborts.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  for (int i = 0; i < 100; i++) {
+    if (x == i * 3)
+      fprintf(stderr, "hit %d\n", i);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "abort") == 0)
+    abort();
+
+  return 0;
+}
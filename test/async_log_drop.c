@@ -0,0 +1,66 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" > %t.input
+//
+// The log goes to a pipe that nobody reads for a second, so the writer gets
+// stuck, the small buffer fills up, and queries are dropped.
+// RUN: env SYMCC_LOG_FORMAT=binary SYMCC_LOG_FILE=%t.full.bin %t < %t.input
+// RUN: sh -c "env SYMCC_ASYNC_LOG=1 SYMCC_ASYNC_LOG_DROP=1 SYMCC_ASYNC_LOG_BUFFER=4096 SYMCC_LOG_FORMAT=binary SYMCC_LOG_FILE=/dev/stdout %t < %t.input 2> %t.bin.err | (sleep 1; cat) > %t.bin"
+// RUN: %filecheck --check-prefix=DROPPED %s < %t.bin.err
+// RUN: %logdump %t.full.bin | awk 'BEGIN { RS = "====end of smt====\n" } { gsub("\n", " "); print }' | env LC_ALL=C sort > %t.full.bin.queries
+// RUN: %logdump %t.bin | awk 'BEGIN { RS = "====end of smt====\n" } { gsub("\n", " "); print }' | env LC_ALL=C sort > %t.bin.queries
+// RUN: env LC_ALL=C comm -13 %t.full.bin.queries %t.bin.queries > %t.bin.extra
+// RUN: not grep . %t.bin.extra
+//
+// RUN: env SYMCC_LOG_FORMAT=delta SYMCC_LOG_FILE=%t.full.delta %t < %t.input
+// RUN: sh -c "env SYMCC_ASYNC_LOG=1 SYMCC_ASYNC_LOG_DROP=1 SYMCC_ASYNC_LOG_BUFFER=4096 SYMCC_LOG_FORMAT=delta SYMCC_LOG_FILE=/dev/stdout %t < %t.input 2> %t.delta.err | (sleep 1; cat) > %t.delta"
+// RUN: %filecheck --check-prefix=DROPPED %s < %t.delta.err
+// RUN: python3 %S/../util/rebuild_query.py %t.full.delta all | awk 'BEGIN { RS = "====end of smt====\n" } { gsub("\n", " "); print }' | env LC_ALL=C sort > %t.full.delta.queries
+// RUN: python3 %S/../util/rebuild_query.py %t.delta all | awk 'BEGIN { RS = "====end of smt====\n" } { gsub("\n", " "); print }' | env LC_ALL=C sort > %t.delta.queries
+// RUN: env LC_ALL=C comm -13 %t.full.delta.queries %t.delta.queries > %t.delta.extra
+// RUN: not grep . %t.delta.extra
+//
+// Check that dropping queries from the binary and delta logs keeps the records
+// that later queries refer to: the logs still read back, and each query in
+// them is one of the queries of the complete log.
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  // Each query needs new expressions.
+  int acc = 0;
+  for (int i = 0; i < 32; i++) {
+    acc += x;
+    if (acc == 123456)
+      fprintf(stderr, "acc %d\n", i);
+  }
+
+  // Most queries only refer to expressions that the log defines already.
+  for (int i = 0; i < 1000; i++) {
+    if (x == (i & 3) + 100)
+      fprintf(stderr, "x %d\n", i);
+  }
+
+  // DROPPED: Asynchronous log: {{[1-9][0-9]*}} records dropped
+  return 0;
+}
@@ -0,0 +1,56 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00\x01\x02\x03\x04" | env SYMCC_LOG_FILE=%t.smt %t
+// RUN: echo -ne "\x05\x00\x00\x00\x01\x02\x03\x04" | env SYMCC_LOG_FORMAT=binary SYMCC_LOG_FILE=%t.bin %t
+// RUN: %logdump %t.bin > %t.dump
+// RUN: diff %t.smt %t.dump
+// RUN: FileCheck %s < %t.dump
+//
+// Check that the binary log contains exactly the queries of the text log.
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int32_t x;
+  uint8_t bytes[4];
+  double d;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x) ||
+      read(STDIN_FILENO, bytes, sizeof(bytes)) != sizeof(bytes)) {
+    fprintf(stderr, "Failed to read the input\n");
+    return -1;
+  }
+
+  // CHECK: Trying to solve
+  if (3 * x + 1 < 42)
+    fprintf(stderr, "small\n");
+
+  // CHECK: Trying to solve
+  if (((uint64_t)x << 40) + bytes[3] == 0x500000000ff)
+    fprintf(stderr, "wide\n");
+
+  // CHECK: Trying to solve
+  d = x;
+  if (d * 0.5 > 1e-310)
+    fprintf(stderr, "float\n");
+
+  // CHECK: Trying to solve
+  if (bytes[0] == 'a' || bytes[1] != bytes[2])
+    fprintf(stderr, "bytes\n");
+
+  return 0;
+}
@@ -0,0 +1,63 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 -S -emit-llvm %s -o - | %filecheck --check-prefix=IR %s
+// RUN: %symcc -O2 -g %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00\x01\x00\x00\x00" | env SYMCC_LOG_FILE=%t.log %t 2>&1 | %filecheck --check-prefix=OUTPUT %s
+// RUN: %filecheck %s < %t.log
+//
+// Check that a function called with concrete and with symbolic data gets an
+// uninstrumented clone, and that the calls with symbolic data still run the
+// instrumented version.
+#include <stdio.h>
+#include <unistd.h>
+
+struct point {
+  int x, y;
+};
+
+__attribute__((noinline)) static int weight(int v) { return v * 7 + 3; }
+
+// IR: call i1 @_sym_is_concrete_memory
+// IR: define internal {{.*}} @distance.concrete(
+// IR: call {{.*}} @weight.concrete(
+__attribute__((noinline)) int distance(const struct point *p, int scale) {
+  int d = weight(p->x) - weight(p->y);
+  // CHECK: Location:{{[0-9a-f]{16}}}.{{[0-9]+}}.0.0.{{.*}}concrete_clones.c.[[@LINE+1]]
+  if (d < 0)
+    d = -d;
+  return d * scale;
+}
+
+int main(int argc, char *argv[]) {
+  struct point input;
+  if (read(STDIN_FILENO, &input, sizeof(input)) != sizeof(input)) {
+    fprintf(stderr, "Failed to read the input\n");
+    return -1;
+  }
+
+  struct point fixed = {3, argc + 4};
+  int total = 0;
+  for (int i = 0; i < 3; i++)
+    total += distance(&fixed, i);
+
+  int result = distance(&input, 2);
+  // CHECK: Location:{{[0-9a-f]{16}}}.{{[0-9]+}}.0.0.{{.*}}concrete_clones.c.[[@LINE+1]]
+  if (result == 42)
+    fprintf(stderr, "match\n");
+  // OUTPUT: 42 56
+  fprintf(stderr, "%d %d\n", total, result);
+  return 0;
+}
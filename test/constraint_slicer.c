@@ -0,0 +1,76 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00\x01\x00\x00\x00" | env SYMCC_KEEP_PATH_PREFIX=1 SYMCC_LOG_FILE=%t.log %t 2>&1 | %filecheck --check-prefix=STATS %s
+// RUN: %filecheck %s < %t.log
+// RUN: echo -ne "\x05\x00\x00\x00\x01\x00\x00\x00" | env SYMCC_KEEP_PATH_PREFIX=1 SYMCC_FULL_PATH_PREFIX=1 %t 2>&1 | %filecheck --check-prefix=FULL %s
+//
+// Check that queries only contain the path constraints that they depend on,
+// that the slicer extends its partition of the path prefix from one query to
+// the next, and that it starts over when the path prefix is reset.
+#include <stdio.h>
+#include <unistd.h>
+
+void symcc_reset_constraints(void);
+
+int main(int argc, char *argv[]) {
+  int input[2];
+  if (read(STDIN_FILENO, input, sizeof(input)) != sizeof(input)) {
+    fprintf(stderr, "Failed to read the input\n");
+    return -1;
+  }
+  int x = input[0], y = input[1];
+
+  // CHECK: Trying to solve
+  // CHECK-NOT: stdin4
+  // FULL: Trying to solve
+  // FULL-NOT: stdin4
+  if (x > 10)
+    fprintf(stderr, "x is large\n");
+
+  // CHECK: Trying to solve
+  // CHECK-NOT: stdin0
+  // CHECK: stdin4
+  // CHECK-NOT: stdin0
+  // CHECK: end of smt
+  // FULL: Trying to solve
+  // FULL: stdin0
+  if (y == 3)
+    fprintf(stderr, "y is 3\n");
+
+  // CHECK: Trying to solve
+  // CHECK-NOT: stdin4
+  // CHECK: end of smt
+  if (x == 42)
+    fprintf(stderr, "x is 42\n");
+
+  symcc_reset_constraints();
+
+  // CHECK: Trying to solve
+  // CHECK-NOT: stdin0
+  // CHECK: end of smt
+  if (y == 9)
+    fprintf(stderr, "y is 9\n");
+
+  // CHECK: Trying to solve
+  // CHECK-NOT: stdin4
+  // CHECK: end of smt
+  if (x == 7)
+    fprintf(stderr, "x is 7\n");
+
+  // STATS: [symcc] Constraint slicer: 3 queries, 1 reused the partition, 3 path constraints dropped
+  return 0;
+}
@@ -0,0 +1,52 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_LOG_FORMAT=delta %t 2>&1 | %filecheck %s
+//
+// Check that the delta log names the prefix of each query instead of repeating
+// the whole solver state.
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+
+int foo(int a, int b) {
+    // SIMPLE: Format:delta
+    // SIMPLE: Declare:
+    // SIMPLE: Trying to solve
+    // SIMPLE-NEXT: Location:
+    // SIMPLE-NEXT: Prefix:
+    // SIMPLE-NEXT: SMT:(assert
+    if (2 * a < b)
+        return a;
+    // SIMPLE: Trying to solve
+    // SIMPLE-NEXT: Location:
+    // SIMPLE-NEXT: Prefix:
+    else if (a % b)
+        return b;
+    else
+        return a + b;
+}
+
+int main(int argc, char* argv[]) {
+    int x;
+    if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+        fprintf(stderr, "Failed to read x\n");
+        return -1;
+    }
+    fprintf(stderr, "%d\n", x);
+    fprintf(stderr, "%d\n", foo(x, 7));
+    // ANY: 7
+    return 0;
+}
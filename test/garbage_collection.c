@@ -0,0 +1,81 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_GC_THRESHOLD=100 SYMCC_LOG_FILE=%t.log %t 2>&1 | %filecheck %s
+// RUN: %filecheck --check-prefix=LOG %s < %t.log
+//
+// Check that collecting garbage releases the expressions that the program
+// doesn't use anymore and keeps the ones in memory.
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+typedef struct {
+  uint64_t collections;
+  uint64_t full_collections;
+  uint64_t live;
+  uint64_t reclaimed;
+  uint64_t total_reclaimed;
+  uint64_t pause_ns;
+  uint64_t total_pause_ns;
+} GarbageCollectionStats;
+
+void symcc_set_gc_stats_handler(void (*)(const GarbageCollectionStats *));
+void symcc_collect_garbage(void);
+
+static void print_stats(const GarbageCollectionStats *stats) {
+  fprintf(stderr, "Collection %lu: %lu reclaimed\n",
+          (unsigned long)stats->collections, (unsigned long)stats->reclaimed);
+}
+
+int input;
+int sink[4];
+
+// The collector only finds the expressions in memory, so the callers must not
+// keep symbolic values in local variables across the call.
+__attribute__((noinline)) static void collect(void) {
+  symcc_collect_garbage();
+}
+
+int main(int argc, char *argv[]) {
+  if (read(STDIN_FILENO, &input, sizeof(input)) != sizeof(input)) {
+    fprintf(stderr, "Failed to read the input\n");
+    return -1;
+  }
+  symcc_set_gc_stats_handler(print_stats);
+
+  // Each round overwrites most of the expressions of the previous one.
+  for (int round = 0; round < 3; round++) {
+    collect();
+    int x = input;
+    for (int i = 0; i < 200; i++)
+      sink[i & 3] = x * i + round;
+  }
+
+  // CHECK: Collection 1: {{[1-9][0-9]*}} reclaimed
+  // CHECK: Collection 2: {{[1-9][0-9]*}} reclaimed
+  collect();
+
+  // The expressions in sink are still valid.
+  // LOG: Trying to solve
+  // LOG: stdin0
+  if (sink[3] == 1234)
+    fprintf(stderr, "found\n");
+  // CHECK: done
+  fprintf(stderr, "done\n");
+  return 0;
+}
@@ -0,0 +1,58 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 -g %s -o %t 2>&1 | %filecheck --check-prefix=ANALYSIS %s
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_LOG_FILE=%t.log %t 2>&1 | %filecheck --check-prefix=OUTPUT %s
+// RUN: %filecheck %s < %t.log
+//
+// Check that functions that only ever see concrete data are left
+// uninstrumented, and that symbolic data still flows through helper functions
+// and local variables.
+#include <stdio.h>
+#include <unistd.h>
+
+static int calls;
+
+// ANALYSIS: [SymbolizePass] {{.*}}input_taint.c: instrumented {{[0-9]+}} instructions, skipped {{[1-9][0-9]*}} ({{[1-9][0-9]*}} of {{[0-9]+}} functions left uninstrumented)
+__attribute__((noinline)) static int ticks(int n) {
+  int sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += i;
+  calls++;
+  return sum;
+}
+
+__attribute__((noinline)) static void scale(int *out, int value, int factor) {
+  *out = value * factor;
+}
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  int elapsed = ticks(argc * 10);
+  int y;
+  scale(&y, x, argc + 1);
+
+  // CHECK: Location:{{[0-9a-f]{16}}}.0.0.0.{{.*}}input_taint.c.[[@LINE+1]]
+  if (y == 42)
+    fprintf(stderr, "match\n");
+  // OUTPUT: 45 10
+  fprintf(stderr, "%d %d\n", elapsed, y);
+  return calls - 1;
+}
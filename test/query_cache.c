@@ -0,0 +1,47 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_QUERY_CACHE=1 %t 2>&1 | %filecheck %s
+// RUN: rm -f %t.cache
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_QUERY_CACHE_FILE=%t.cache %t 2>&1 | %filecheck %s
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_QUERY_CACHE_FILE=%t.cache %t 2>&1 | %filecheck --check-prefix=PERSISTENT %s
+//
+// Check that we emit a repeated query only once, and that a cache file
+// remembers the query across executions.
+#include <stdio.h>
+#include <unistd.h>
+
+volatile int hits;
+
+__attribute__((noinline)) void check(int x) {
+  if (x == 7)
+    hits++;
+}
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  for (int i = 0; i < 100; i++)
+    check(x);
+
+  // CHECK: [symcc] Query cache: 99 duplicate queries skipped, 1 new queries
+  // PERSISTENT: [symcc] Query cache: 100 duplicate queries skipped, 0 new queries
+  return 0;
+}
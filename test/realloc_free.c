@@ -0,0 +1,56 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// RUN: %symcc %s -o %t
+// RUN: echo -ne "\x00\x00\x00\x2a" | %t 2>&1 | %filecheck %s
+//
+// Check that symbolic data moves along with memory that realloc moves, and
+// that freed memory doesn't carry symbolic data into later allocations.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+  x = ntohl(x);
+
+  char *buffer = malloc(16);
+  memset(buffer, (char)x, 16);
+  buffer = realloc(buffer, 100000);
+  fprintf(stderr, "%s\n", (buffer[15] < 100) ? "worked" : "error");
+  // SIMPLE: Trying to solve
+  // SIMPLE: Found diverging input
+  // QSYM-COUNT-2: SMT
+  // QSYM: New testcase
+  // ANY: worked
+
+  memset(buffer, (char)x, 100000);
+  free(buffer);
+  char *zeroed = calloc(100000, 1);
+  fprintf(stderr, "%s\n", (zeroed[5000] < 100) ? "worked" : "error");
+  // SIMPLE-NOT: Trying to solve
+  // QSYM-NOT: SMT
+  // ANY: worked
+
+  free(zeroed);
+  return 0;
+}
@@ -0,0 +1,50 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_SITE_BUDGET=5 %t 2>&1 | %filecheck %s
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_SITE_BUDGET=5 SYMCC_KEEP_PATH_PREFIX=1 SYMCC_FULL_PATH_PREFIX=1 %t 2>&1 | %filecheck --check-prefix=PREFIX %s
+//
+// Check that we stop emitting queries for a branch site once it has used up
+// its budget, and that the branches without queries still constrain the path.
+#include <stdio.h>
+#include <unistd.h>
+
+volatile int hits;
+
+__attribute__((noinline)) void check(int x, int i) {
+  if (x == i + 7)
+    hits++;
+}
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  for (int i = 0; i < 100; i++)
+    check(x, i);
+
+  // The constraint of the last call, x != 99 + 7, is part of the path prefix.
+  // PREFIX: Trying to solve
+  // PREFIX: #x6a
+  if (x > 1000)
+    hits++;
+
+  // CHECK: [symcc] Site budget: 95 queries suppressed
+  return 0;
+}
@@ -0,0 +1,40 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 -g %s -o %t
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_LOG_FILE=%t.log %t
+// RUN: python3 %S/../util/site_map.py %t %t.sites
+// RUN: cat %t.log %t.sites | %filecheck %s
+//
+// Check that queries name their site by ID, and that the site map of the
+// program resolves the ID to the location of the branch.
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  // CHECK: Location:[[SITE:[0-9a-f]{16}]].0.0.0.{{.*}}site_map.c.[[@LINE+1]]
+  if (x == 42)
+    fprintf(stderr, "Found the answer\n");
+
+  // CHECK: site{{.*}}check{{.*}}loop
+  // CHECK: [[SITE]]{{.*}}main{{.*}}site_map.c
+  return 0;
+}
@@ -0,0 +1,49 @@
+// This file is part of SymCC.
+//
+// SymCC is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+// REQUIRES: simple-backend
+// RUN: %symcc -O2 %s -o %t
+// RUN: rm -rf %t.out && mkdir %t.out
+// RUN: echo -ne "\x05\x00\x00\x00" | env SYMCC_SOLVER_THREADS=2 SYMCC_OUTPUT_DIR=%t.out %t 2>&1 | %filecheck %s
+// RUN: cat %t.out/000000-* | env SYMCC_NO_SYMBOLIC_INPUT=1 %t 2>&1 | %filecheck --check-prefix=REPLAY %s
+//
+// Check that a forked child, which doesn't inherit the solver threads, still
+// solves its queries.
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int x;
+  if (read(STDIN_FILENO, &x, sizeof(x)) != sizeof(x)) {
+    fprintf(stderr, "Failed to read x\n");
+    return -1;
+  }
+
+  pid_t child = fork();
+  if (child == 0) {
+    // REPLAY: found in the child
+    if (x == 0x2a2a)
+      fprintf(stderr, "found in the child\n");
+    return 0;
+  }
+
+  waitpid(child, NULL, 0);
+  if (x == 0x1234)
+    fprintf(stderr, "found in the parent\n");
+
+  // CHECK: [symcc] Solver pool: 1 queries, 1 test cases, 0 queries dropped
+  // CHECK: [symcc] Solver pool: 1 queries, 1 test cases, 0 queries dropped
+  return 0;
+}
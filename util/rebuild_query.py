@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+#
+# This file is part of SymCC.
+#
+# SymCC is free software: you can redistribute it and/or modify it under the
+# terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+# A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+"""Rebuild full SMT-LIB queries from a log written with SYMCC_LOG_FORMAT=delta.
+
+Usage: rebuild_query.py LOG          (list the queries in the log)
+       rebuild_query.py LOG INDEX    (print query number INDEX as SMT-LIB)
+       rebuild_query.py LOG all      (print all queries as SMT-LIB)
+"""
+
+import sys
+
+END_OF_SMT = "====end of smt===="
+
+
+def read_smt(lines, first):
+    """Collect lines up to the end marker, starting with "first"."""
+    smt = [first]
+    for line in lines:
+        if line == END_OF_SMT:
+            break
+        smt.append(line)
+    return "\n".join(smt)
+
+
+def parse(log):
+    """Return the declarations, assertions, prefixes and queries of the log.
+
+    Each query is a tuple (location, prefix, smt, number of declarations seen
+    so far)."""
+    declarations, assertions, prefixes, queries = [], {}, {0: None}, []
+    lines = (line.rstrip("\n") for line in log)
+    for line in lines:
+        if line.startswith("Declare:"):
+            declarations.append(line[len("Declare:"):])
+        elif line.startswith("Assertion:"):
+            assertions[int(line[len("Assertion:"):])] = read_smt(lines, next(lines))
+        elif line.startswith("PathPrefix:"):
+            prefix, parent, assertion = map(int, line[len("PathPrefix:"):].split("."))
+            prefixes[prefix] = (parent, assertion)
+        elif line == "Trying to solve:":
+            location = next(lines)[len("Location:"):]
+            prefix = int(next(lines)[len("Prefix:"):])
+            smt = read_smt(lines, next(lines)[len("SMT:"):])
+            queries.append((location, prefix, smt, len(declarations)))
+    return declarations, assertions, prefixes, queries
+
+
+def rebuild(declarations, assertions, prefixes, query):
+    _, prefix, smt, num_declarations = query
+    chain = []
+    while prefixes[prefix] is not None:
+        prefix, assertion = prefixes[prefix]
+        chain.append(assertions[assertion])
+    return "\n".join(declarations[:num_declarations] + chain[::-1] + [smt])
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print(__doc__, file=sys.stderr)
+        sys.exit(1)
+
+    with open(sys.argv[1]) as log:
+        declarations, assertions, prefixes, queries = parse(log)
+
+    if len(sys.argv) == 2:
+        for index, (location, prefix, _, _) in enumerate(queries):
+            print(f"{index}: location {location}, prefix {prefix}")
+    elif sys.argv[2] == "all":
+        for query in queries:
+            print(rebuild(declarations, assertions, prefixes, query))
+            print(END_OF_SMT)
+    else:
+        query = queries[int(sys.argv[2])]
+        print(rebuild(declarations, assertions, prefixes, query))
+
+
+if __name__ == "__main__":
+    main()
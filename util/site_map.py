@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+#
+# This file is part of SymCC.
+#
+# SymCC is free software: you can redistribute it and/or modify it under the
+# terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# SymCC is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+# A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# SymCC. If not, see <https://www.gnu.org/licenses/>.
+
+"""Check the site IDs of a program built with SymCC and write its site map.
+
+Usage: site_map.py BINARY [MAP]
+
+The compiler pass puts a table of the path-constraint sites of each module
+into the symcc_sites section, and the linker concatenates them. This script
+reads the tables from the linked program (or library), reports any site ID
+that two different sites share, and writes a tab-separated map from site IDs
+to their location to MAP (by default BINARY.sites). The site ID in the
+"Location:" lines of the query log is the first column of the map.
+
+The exit status is 1 if site IDs collide, and 2 if the binary has no site
+tables.
+"""
+
+import struct
+import sys
+
+SECTION = b"symcc_sites"
+TABLE_VERSION = 2
+HEADER = "IIII"
+SITE = "QIIiIIBB2x"
+LOOP_FLAG = 1
+
+
+def read_section(path):
+    """Return the contents of the site section and the byte order."""
+    with open(path, "rb") as binary:
+        data = binary.read()
+
+    if data[:4] != b"\x7fELF":
+        raise ValueError(f"{path} is not an ELF file")
+    is64 = data[4] == 2
+    order = "<" if data[5] == 1 else ">"
+
+    if is64:
+        shoff, = struct.unpack_from(order + "Q", data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(order + "HHH", data, 0x3A)
+        section = order + "IIQQQQIIQQ"
+    else:
+        shoff, = struct.unpack_from(order + "I", data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(order + "HHH", data, 0x2E)
+        section = order + "IIIIIIIIII"
+
+    headers = [struct.unpack_from(section, data, shoff + i * shentsize)
+               for i in range(shnum)]
+    names = headers[shstrndx]
+    for header in headers:
+        name_start = names[4] + header[0]
+        name = data[name_start:data.index(b"\0", name_start)]
+        if name == SECTION:
+            return data[header[4]:header[4] + header[5]], order
+    return None, order
+
+
+def read_sites(section, order):
+    """Yield a dictionary for each site in the concatenated tables."""
+    header_size = struct.calcsize(order + HEADER)
+    site_size = struct.calcsize(order + SITE)
+    offset = 0
+    while offset + header_size <= len(section):
+        version, num_sites, strings_size, module = struct.unpack_from(
+            order + HEADER, section, offset)
+        if version == 0:
+            # Padding between tables.
+            offset += 8
+            continue
+        if version != TABLE_VERSION:
+            raise ValueError(f"unknown site table version {version}")
+
+        sites = offset + header_size
+        strings = sites + num_sites * site_size
+
+        def string(at):
+            start = strings + at
+            return section[start:section.index(b"\0", start)].decode(
+                errors="replace")
+
+        for i in range(num_sites):
+            (site_id, file, function, line, column, position, check,
+             flags) = struct.unpack_from(order + SITE, section,
+                                         sites + i * site_size)
+            yield {"id": site_id, "check": check,
+                   "loop": int(flags & LOOP_FLAG != 0),
+                   "module": string(module), "function": string(function),
+                   "position": position, "file": string(file), "line": line,
+                   "column": column}
+
+        offset = strings + strings_size
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print(__doc__, file=sys.stderr)
+        sys.exit(1)
+
+    section, order = read_section(sys.argv[1])
+    if section is None:
+        print(f"{sys.argv[1]} doesn't contain any site tables", file=sys.stderr)
+        sys.exit(2)
+
+    sites = {}
+    collisions = 0
+    for site in read_sites(section, order):
+        key = (site["module"], site["function"], site["position"])
+        other = sites.setdefault(site["id"], site)
+        if (other["module"], other["function"], other["position"]) != key:
+            print(f"Collision: site ID {site['id']:016x} describes both "
+                  f"{other['module']}:{other['function']}+{other['position']} "
+                  f"and {site['module']}:{site['function']}+{site['position']}",
+                  file=sys.stderr)
+            collisions += 1
+
+    map_path = sys.argv[2] if len(sys.argv) == 3 else sys.argv[1] + ".sites"
+    with open(map_path, "w") as site_map:
+        print("site\tcheck\tloop\tmodule\tfunction\tposition\tfile\tline\tcolumn",
+              file=site_map)
+        for site_id in sorted(sites):
+            site = sites[site_id]
+            print(f"{site_id:016x}\t{site['check']}\t{site['loop']}\t"
+                  f"{site['module']}\t{site['function']}\t{site['position']}\t"
+                  f"{site['file']}\t{site['line']}\t{site['column']}",
+                  file=site_map)
+
+    sys.exit(1 if collisions else 0)
+
+
+if __name__ == "__main__":
+    main()